@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+// Microbenchmark of the set kernels (membership and intersection)
+// across different ratios of list sizes.
+//
+// usage: simd_set_bench [#elements of the long list] [#rounds]
+// output: one CSV line per (kernel, level, sizes)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+#include <iostream>
+
+using namespace std;
+
+#include "timer.hpp"
+#include "simd_set.hpp"
+
+// a strictly increasing list of @n IDs, where about @density of [0, n / density) is used
+static vector<uint32_t> gen_set(mt19937 &rng, uint64_t n, double density) {
+    vector<uint32_t> v;
+    v.reserve(n);
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    uint32_t id = 0;
+    while (v.size() < n) {
+        if (coin(rng) < density) v.push_back(id);
+        id++;
+    }
+    return v;
+}
+
+template <typename T>
+static void bench_intersect(simd_set::level_t l, const vector<T> &a, const vector<T> &b,
+                            int rounds) {
+    vector<T> out(min(a.size(), b.size()));
+    uint64_t n = 0;
+    uint64_t t = timer::get_usec();
+    for (int r = 0; r < rounds; r++)
+        n += simd_set::intersect(l, a.data(), a.size(), b.data(), b.size(), out.data());
+    t = timer::get_usec() - t;
+
+    printf("intersect,%s,%lu,%lu,%d,%lu,%.3f\n", simd_set::level_str(l),
+           a.size(), b.size(), (int)(sizeof(T) * 8), n / rounds, (double)t / rounds);
+}
+
+template <typename T>
+static void bench_contains(simd_set::level_t l, const vector<T> &a, int rounds) {
+    // half of the keys hit the list
+    uint64_t hits = 0;
+    uint64_t t = timer::get_usec();
+    for (int r = 0; r < rounds; r++)
+        hits += simd_set::contains(l, a.data(), a.size(),
+                                   (r & 1) ? a[(r * 7919) % a.size()] : (T)(-1));
+    t = timer::get_usec() - t;
+
+    printf("contains,%s,%lu,%lu,%d,%lu,%.3f\n", simd_set::level_str(l),
+           a.size(), (uint64_t)1, (int)(sizeof(T) * 8), hits, (double)t * 1000 / rounds);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t nlong = (argc > 1) ? atol(argv[1]) : (1 << 20);
+    int rounds = (argc > 2) ? atoi(argv[2]) : 20;
+
+    mt19937 rng(2016);
+    simd_set::level_t best = simd_set::detect_level();
+    vector<simd_set::level_t> levels;
+    for (int l = simd_set::SCALAR; l <= best; l++)
+        levels.push_back((simd_set::level_t)l);
+
+    // NOTE: the last column is usec/run for intersect and nsec/run for contains
+    printf("kernel,level,size_a,size_b,bits,result,time\n");
+
+    int ratios[] = {1, 2, 4, 8, 16, 32, 64, 256, 1024};
+    for (int ratio : ratios) {
+        vector<uint32_t> b = gen_set(rng, nlong, 0.5);
+        vector<uint32_t> a = gen_set(rng, max(nlong / ratio, (uint64_t)1), 0.5 / ratio);
+        vector<uint64_t> a64(a.begin(), a.end()), b64(b.begin(), b.end());
+
+        for (auto l : levels) {
+            bench_intersect(l, a, b, rounds);
+            bench_intersect(l, a64, b64, rounds);
+        }
+    }
+
+    uint64_t sizes[] = {4, 16, 64, 256, 1024, 4096};
+    for (uint64_t sz : sizes) {
+        vector<uint32_t> a = gen_set(rng, sz, 0.5);
+        vector<uint64_t> a64(a.begin(), a.end());
+        for (auto l : levels) {
+            bench_contains(l, a, rounds * 50000);
+            bench_contains(l, a64, rounds * 50000);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,581 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+// Microbenchmarks of the core structures of Wukong on a single process
+// (w/o MPI, RDMA and a cluster), over a synthetic graph:
+//   gstore:  insert and lookup of GStore at different load factors, and scan of edges
+//   engine:  each pattern operator of Engine on synthetic result tables
+//   bundle:  serialization round-trip of queries (Bundle)
+//   buddy:   alloc and free of Buddy_Malloc
+//   string:  loading and lookup of String_Server
+//   planner: planning time of Planner
+//   logger:  the cost of logs on the logging threads (disabled, sync and async)
+//
+// usage: wukong_bench [#vertices] [#rounds] [bench]
+// output: one CSV line per (bench, case, param)
+
+#include "logger2.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <sstream>
+#include <iostream>
+
+using namespace std;
+
+#include "config.hpp"
+#include "bind.hpp"
+#include "mem.hpp"
+#include "string_server.hpp"
+#include "dgraph.hpp"
+#include "engine.hpp"
+#include "parser.hpp"
+#include "planner.hpp"
+#include "buddy_malloc.hpp"
+#include "timer.hpp"
+#include "unit.hpp"
+
+// the schema of the synthetic graph
+#define NUM_PREDS 4
+#define NUM_TYPES 4
+
+static const char *URI = "http://wukong.bench/";
+static const char *TYPE_URI = "<http://www.w3.org/1999/02/22-rdf-syntax-ns#type>";
+
+static inline sid_t pred_id(int i) { return 2 + i; }
+static inline sid_t type_id(int i) { return 2 + NUM_PREDS + i; }
+static inline sid_t vertex_id(uint64_t i) { return (1 << NBITS_IDX) + i; }
+
+static void print_row(const char *bench, const char *name, uint64_t param,
+                      uint64_t ops, uint64_t usec, uint64_t result) {
+    printf("%s,%s,%lu,%lu,%lu,%.1f,%lu\n", bench, name, param, ops, usec,
+           ops ? (double)usec * 1000 / ops : 0.0, result);
+    fflush(stdout);
+}
+
+/**
+ * Each vertex has a type and @degree out-edges per predicate to random vertices,
+ * and the first vertex (hub) has extra @hub_degree out-edges with the first predicate.
+ */
+static void gen_triples(vector<triple_t> &triples, uint64_t nverts, int degree,
+                        uint64_t hub_degree, mt19937 &rng) {
+    triples.clear();
+    triples.reserve(nverts * (1 + NUM_PREDS * degree) + hub_degree);
+    for (uint64_t i = 0; i < nverts; i++) {
+        triples.push_back(triple_t(vertex_id(i), TYPE_ID, type_id(i % NUM_TYPES)));
+        for (int p = 0; p < NUM_PREDS; p++)
+            for (int d = 0; d < degree; d++)
+                triples.push_back(triple_t(vertex_id(i), pred_id(p), vertex_id(rng() % nverts)));
+    }
+    for (uint64_t d = 0; d < hub_degree; d++)
+        triples.push_back(triple_t(vertex_id(0), pred_id(0), vertex_id(rng() % nverts)));
+}
+
+// ID-mapping files in the format of String_Server (i.e., "str id" per line)
+static void gen_mappings(string dname, uint64_t nverts) {
+    ofstream index((dname + "str_index").c_str());
+    index << TYPE_URI << "\t" << TYPE_ID << endl;
+    for (int i = 0; i < NUM_PREDS; i++)
+        index << "<" << URI << "p" << i << ">\t" << pred_id(i) << endl;
+    for (int i = 0; i < NUM_TYPES; i++)
+        index << "<" << URI << "T" << i << ">\t" << type_id(i) << endl;
+    index.close();
+
+    ofstream normal((dname + "str_normal").c_str());
+    for (uint64_t i = 0; i < nverts; i++)
+        normal << "<" << URI << "v" << i << ">\t" << vertex_id(i) << endl;
+    normal.close();
+}
+
+static void bench_gstore_lookup(DGraph *graph, uint64_t nverts, uint64_t lf,
+                                uint64_t nlookups, mt19937 &rng) {
+    vector<pair<sid_t, sid_t>> keys(nlookups);
+    for (auto &k : keys)
+        k = make_pair(vertex_id(rng() % nverts), pred_id(rng() % NUM_PREDS));
+
+    uint64_t sz, sum = 0;
+    uint64_t t = timer::get_usec();
+    for (auto &k : keys) {
+        graph->gstore.get_edges_global(0, k.first, OUT, k.second, &sz);
+        sum += sz;
+    }
+    t = timer::get_usec() - t;
+    print_row("gstore", "lookup_hit", lf, nlookups, t, sum);
+
+    // an unused predicate
+    sum = 0;
+    t = timer::get_usec();
+    for (auto &k : keys) {
+        graph->gstore.get_edges_global(0, k.first, OUT, type_id(NUM_TYPES), &sz);
+        sum += sz;
+    }
+    t = timer::get_usec() - t;
+    print_row("gstore", "lookup_miss", lf, nlookups, t, sum);
+}
+
+/**
+ * Build graphs of different sizes on the same kvstore to reach the target load factors
+ * of the main-header region, where the load factor (param) is in percent.
+ */
+static void bench_gstore(Mem *mem, String_Server *str_server, uint64_t max_verts,
+                         uint64_t nlookups) {
+    mt19937 rng(2016);
+    vector<triple_t> triples;
+
+    // calibrate #slots and #bytes of edges per vertex by a small graph
+    uint64_t nverts = 10000;
+    gen_triples(triples, nverts, 1, 0, rng);
+    DGraph *graph = new DGraph(0, mem, str_server, triples);
+    uint64_t used_slots, total_slots, used_bytes, total_bytes;
+    graph->gstore.get_header_usage(used_slots, total_slots);
+    graph->get_entry_usage(used_bytes, total_bytes);
+    delete graph;
+
+    double slots_per_vert = (double)used_slots / nverts;
+    double bytes_per_vert = (double)used_bytes / nverts;
+
+    int targets[] = {10, 25, 50, 75, 90};
+    for (int lf : targets) {
+        nverts = total_slots * lf / 100 / slots_per_vert;
+        nverts = min(nverts, (uint64_t)(total_bytes * 0.9 / bytes_per_vert));
+        if (nverts > max_verts) {
+            logstream(LOG_WARNING) << "skip load factor " << lf << "% which needs "
+                                   << nverts << " vertices" << LOG_endl;
+            continue;
+        }
+
+        gen_triples(triples, nverts, 1, 0, rng);
+        uint64_t t = timer::get_usec();
+        graph = new DGraph(0, mem, str_server, triples);
+        t = timer::get_usec() - t;
+
+        graph->gstore.get_header_usage(used_slots, total_slots);
+        uint64_t actual = used_slots * 100 / total_slots;
+        print_row("gstore", "insert", actual, triples.size(), t, used_slots);
+
+        bench_gstore_lookup(graph, nverts, actual, nlookups, rng);
+        delete graph;
+    }
+}
+
+// scan the edges of all vertices with a predicate
+static void bench_gstore_scan(DGraph *graph, uint64_t nverts) {
+    uint64_t sz, nedges = 0, sum = 0;
+    uint64_t t = timer::get_usec();
+    for (uint64_t i = 0; i < nverts; i++) {
+        edge_t *edges = graph->gstore.get_edges_global(0, vertex_id(i), OUT, pred_id(1), &sz);
+        for (uint64_t k = 0; k < sz; k++)
+            sum += edges[k].val;
+        nedges += sz;
+    }
+    t = timer::get_usec() - t;
+    print_row("gstore", "scan", nverts, nedges, t, sum);
+}
+
+/**
+ * Run the pattern operators of an engine directly (w/o runqueues and messages)
+ */
+class Engine_Bench {
+private:
+    Engine *engine;
+    int rounds;
+
+    // time the last pattern of @r, after executing the previous patterns once
+    void run(const char *name, SPARQLQuery &r) {
+        while (r.pattern_step < r.pattern_group.patterns.size() - 1)
+            engine->execute_one_pattern(r);
+
+        vector<SPARQLQuery> reqs(rounds, r);
+        uint64_t t = timer::get_usec();
+        for (int i = 0; i < rounds; i++)
+            engine->execute_one_pattern(reqs[i]);
+        t = timer::get_usec() - t;
+        print_row("engine", name, r.result.get_row_num(), rounds, t,
+                  reqs[0].result.get_row_num());
+    }
+
+    SPARQLQuery make_query(vector<SPARQLQuery::Pattern> patterns, int nvars) {
+        SPARQLQuery::PatternGroup g;
+        g.patterns = patterns;
+        return SPARQLQuery(g, nvars);
+    }
+
+    // bind ?X (-1) to all vertices in advance
+    SPARQLQuery make_bound_query(vector<SPARQLQuery::Pattern> patterns, int nvars,
+                                 uint64_t nverts) {
+        SPARQLQuery r = make_query(patterns, nvars);
+        for (uint64_t i = 0; i < nverts; i++)
+            r.result.result_table.push_back(vertex_id(i));
+        r.result.set_col_num(1);
+        r.result.add_var2col(-1, 0);
+        return r;
+    }
+
+public:
+    Engine_Bench(Engine *engine, int rounds): engine(engine), rounds(rounds) { }
+
+    void run_all(uint64_t nverts) {
+        typedef SPARQLQuery::Pattern P;
+        P index(type_id(0), TYPE_ID, IN, -1);  // ?X rdf:type T0
+        sid_t hub = vertex_id(0);
+
+        SPARQLQuery r = make_query({index}, 1);
+        run("index_to_unknown", r);
+        r = make_bound_query({index}, 1, nverts);
+        run("index_to_known", r);
+
+        r = make_query({P(hub, pred_id(0), OUT, -1)}, 1);
+        run("const_to_unknown", r);
+        r = make_bound_query({P(hub, pred_id(0), OUT, -1)}, 1, nverts);
+        run("const_to_known", r);
+
+        r = make_query({index, P(-1, pred_id(0), OUT, -2)}, 2);
+        run("known_to_unknown", r);
+        r = make_query({index, P(-1, pred_id(0), OUT, -2), P(-2, pred_id(0), IN, -1)}, 2);
+        run("known_to_known", r);
+        r = make_query({index, P(-1, TYPE_ID, OUT, type_id(0))}, 1);
+        run("known_to_const", r);
+
+#ifdef VERSATILE
+        // ?P (-2) is an unknown predicate
+        sid_t ngbr = vertex_id(1);
+        uint64_t sz = 0;
+        edge_t *edges = engine->graph->get_edges_global(0, hub, OUT, pred_id(0), &sz);
+        if (sz > 0) ngbr = edges[0].val;
+
+        r = make_query({P(hub, -2, OUT, -3)}, 3);
+        run("const_unknown_unknown", r);
+        r = make_query({P(hub, -2, OUT, ngbr)}, 2);
+        run("const_unknown_const", r);
+        r = make_query({index, P(-1, -2, OUT, -3)}, 3);
+        run("known_unknown_unknown", r);
+        r = make_query({index, P(-1, -2, OUT, ngbr)}, 2);
+        run("known_unknown_const", r);
+#endif
+    }
+};
+
+static void bench_bundle(int rounds, mt19937 &rng) {
+    uint64_t sizes[] = {0, 1000, 100000};
+    for (uint64_t rows : sizes) {
+        SPARQLQuery::PatternGroup g;
+        g.patterns.push_back(SPARQLQuery::Pattern(type_id(0), TYPE_ID, IN, -1));
+        g.patterns.push_back(SPARQLQuery::Pattern(-1, pred_id(0), OUT, -2));
+        g.patterns.push_back(SPARQLQuery::Pattern(-2, pred_id(1), OUT, -3));
+        SPARQLQuery r(g, 3);
+        for (uint64_t i = 0; i < rows * 3; i++)
+            r.result.result_table.push_back(vertex_id(rng() % 1000000));
+        r.result.set_col_num(3);
+        for (int v = 0; v < 3; v++)
+            r.result.add_var2col(-1 - v, v);
+
+        // as sent and received by adaptors
+        string msg;
+        uint64_t t = timer::get_usec();
+        for (int i = 0; i < rounds; i++) {
+            Bundle b(r);
+            msg = b.get_type() + b.data;
+        }
+        t = timer::get_usec() - t;
+        print_row("bundle", "encode", rows, rounds, t, msg.size());
+
+        uint64_t n = 0;
+        t = timer::get_usec();
+        for (int i = 0; i < rounds; i++) {
+            Bundle b(msg);
+            SPARQLQuery q = b.get_sparql_query();
+            n += q.result.get_row_num();
+        }
+        t = timer::get_usec() - t;
+        print_row("bundle", "decode", rows, rounds, t, n / rounds);
+    }
+}
+
+static void bench_buddy(uint64_t nblocks, mt19937 &rng) {
+    // the smallest heap of Buddy_Malloc, most of which is never touched
+    uint64_t heap_sz = 1ull << 32;
+    char *heap = (char *)malloc(heap_sz);
+    Buddy_Malloc *allocator = new Buddy_Malloc();
+    allocator->init(heap, heap_sz, 1);
+    allocator->merge_freelists();
+
+    // the sizes of edge lists (bytes)
+    vector<uint64_t> sizes(nblocks);
+    for (auto &sz : sizes)
+        sz = sizeof(edge_t) * (1 + rng() % 256);
+
+    vector<uint64_t> blocks(nblocks);
+    uint64_t t = timer::get_usec();
+    for (uint64_t i = 0; i < nblocks; i++)
+        blocks[i] = allocator->malloc(sizes[i]);
+    t = timer::get_usec() - t;
+    print_row("buddy", "alloc", nblocks, nblocks, t, allocator->get_used_size());
+
+    // replace random blocks with new ones
+    t = timer::get_usec();
+    for (uint64_t i = 0; i < nblocks; i++) {
+        uint64_t victim = rng() % nblocks;
+        allocator->free(blocks[victim]);
+        blocks[victim] = allocator->malloc(sizes[i]);
+    }
+    t = timer::get_usec() - t;
+    print_row("buddy", "churn", nblocks, nblocks, t, allocator->get_used_size());
+
+    shuffle(blocks.begin(), blocks.end(), rng);
+    t = timer::get_usec();
+    for (uint64_t i = 0; i < nblocks; i++)
+        allocator->free(blocks[i]);
+    t = timer::get_usec() - t;
+    print_row("buddy", "free", nblocks, nblocks, t, allocator->get_used_size());
+
+    delete allocator;
+    free(heap);
+}
+
+static void bench_string(String_Server *str_server, uint64_t nverts, uint64_t load_usec,
+                         uint64_t nlookups, mt19937 &rng) {
+    print_row("string", "load", nverts, str_server->str2id.size(), load_usec,
+              str_server->id2str.size());
+
+    vector<uint64_t> ids(nlookups);
+    vector<string> strs(nlookups);
+    for (uint64_t i = 0; i < nlookups; i++) {
+        ids[i] = rng() % nverts;
+        strs[i] = "<" + string(URI) + "v" + to_string(ids[i]) + ">";
+    }
+
+    uint64_t sum = 0;
+    uint64_t t = timer::get_usec();
+    for (auto &s : strs)
+        sum += str_server->str2id.find(s)->second;
+    t = timer::get_usec() - t;
+    print_row("string", "str2id", nverts, nlookups, t, sum);
+
+    sum = 0;
+    t = timer::get_usec();
+    for (auto id : ids)
+        sum += str_server->id2str.find(vertex_id(id))->second.size();
+    t = timer::get_usec() - t;
+    print_row("string", "id2str", nverts, nlookups, t, sum);
+
+    for (auto &s : strs)
+        s[1] = 'X'; // not exist
+    sum = 0;
+    t = timer::get_usec();
+    for (auto &s : strs)
+        sum += str_server->exist(s);
+    t = timer::get_usec() - t;
+    print_row("string", "str2id_miss", nverts, nlookups, t, sum);
+}
+
+static void bench_planner(DGraph *graph, String_Server *str_server, int rounds) {
+    // the statistics of a single server are the global statistics
+    data_statistic stat;
+    graph->gstore.generate_statistic(stat);
+    stat.merge_stat(stat);
+    stat.fix_type_stat();
+
+    string p[NUM_PREDS], t[NUM_TYPES];
+    for (int i = 0; i < NUM_PREDS; i++) p[i] = "<" + string(URI) + "p" + to_string(i) + ">";
+    for (int i = 0; i < NUM_TYPES; i++) t[i] = "<" + string(URI) + "T" + to_string(i) + ">";
+
+    vector<pair<string, string>> queries = {
+        {"star", "SELECT ?X ?Y ?Z ?W WHERE { ?X " + string(TYPE_URI) + " " + t[0] + " . ?X "
+         + p[0] + " ?Y . ?X " + p[1] + " ?Z . ?X " + p[2] + " ?W . }"},
+        {"chain", "SELECT ?X ?Y ?Z ?W WHERE { ?X " + p[0] + " ?Y . ?Y " + p[1] + " ?Z . ?Z "
+         + p[2] + " ?W . ?W " + string(TYPE_URI) + " " + t[1] + " . }"},
+        {"triangle", "SELECT ?X ?Y ?Z WHERE { ?X " + p[0] + " ?Y . ?Y " + p[1] + " ?Z . ?Z "
+         + p[2] + " ?X . ?X " + string(TYPE_URI) + " " + t[0] + " . }"}
+    };
+
+    Parser parser(str_server);
+    Planner planner;
+    for (auto &q : queries) {
+        SPARQLQuery r;
+        istringstream is(q.second);
+        if (!parser.parse(is, r)) {
+            logstream(LOG_ERROR) << "failed to parse the query " << q.first << LOG_endl;
+            continue;
+        }
+
+        vector<SPARQLQuery> reqs(rounds, r);
+        uint64_t ok = 0;
+        uint64_t t = timer::get_usec();
+        for (int i = 0; i < rounds; i++)
+            ok += planner.generate_plan(reqs[i], &stat);
+        t = timer::get_usec() - t;
+        print_row("planner", q.first.c_str(), r.pattern_group.patterns.size(), rounds, t, ok);
+    }
+}
+
+struct logger_arg {
+    int tid;
+    uint64_t nlogs;
+    uint64_t cpu_usec;  // the CPU time of the thread
+};
+
+static void *logger_thread(void *arg) {
+    logger_arg *la = (logger_arg *)arg;
+    struct timespec begin, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    // like the log of Engine::execute_patterns
+    for (uint64_t i = 0; i < la->nlogs; i++)
+        logstream(LOG_INFO) << "[" << 0 << "-" << la->tid << "]"
+                            << " id=" << i << " pid=" << i + 1 << LOG_endl;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    la->cpu_usec = (end.tv_sec - begin.tv_sec) * 1000000 + (end.tv_nsec - begin.tv_nsec) / 1000;
+    return NULL;
+}
+
+static void bench_logger(int nthreads, uint64_t nlogs) {
+    char fname[] = "/tmp/wukong_bench_log.XXXXXX";
+    int fd = mkstemp(fname);
+    if (fd < 0) {
+        logstream(LOG_ERROR) << "failed to create a temporary file" << LOG_endl;
+        return;
+    }
+    close(fd);
+
+    file_logger &l = global_logger();
+    const char *cases[] = {"disabled", "sync", "async"};
+    for (const char *c : cases) {
+        string name = c;
+        l.set_log_level(name == "disabled" ? LOG_WARNING : LOG_INFO);
+        l.set_log_to_console(false);
+        l.set_log_file(fname);
+        // the buffer of async logs holds all logs to measure the cost on logging threads
+        l.set_async(name == "async", nlogs * 128);
+
+        vector<pthread_t> threads(nthreads);
+        vector<logger_arg> args(nthreads);
+        for (int i = 0; i < nthreads; i++) {
+            args[i].tid = i;
+            args[i].nlogs = nlogs;
+            pthread_create(&threads[i], NULL, logger_thread, &args[i]);
+        }
+        uint64_t t = 0;
+        for (int i = 0; i < nthreads; i++) {
+            pthread_join(threads[i], NULL);
+            t += args[i].cpu_usec;
+        }
+
+        // NOTE: the time is the CPU time of logging threads (w/o the background thread),
+        // and the result is the time to write the rest of logs
+        uint64_t w = timer::get_usec();
+        l.flush();
+        w = timer::get_usec() - w;
+        print_row("logger", c, nthreads, nlogs * nthreads, t, w);
+
+        l.set_async(false);
+        l.set_log_file("");
+    }
+
+    l.set_log_to_console(true);
+    l.set_log_level(LOG_WARNING);
+    unlink(fname);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t nverts = (argc > 1) ? atol(argv[1]) : 100000;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 100;
+    string bench = (argc > 3) ? argv[3] : "all";
+    uint64_t nlookups = 1000000;
+
+    // a single server w/o RDMA
+    global_num_servers = 1;
+    global_num_proxies = 1;
+    global_num_engines = 1;
+    global_num_threads = global_num_proxies + global_num_engines;
+    global_use_rdma = false;
+    global_logger().set_log_level(LOG_WARNING);
+
+    // about 1KB per vertex is enough for the synthetic graph
+    uint64_t kvs_sz = max((uint64_t)MiB2B(64), nverts * 1024);
+#ifdef DYNAMIC_GSTORE
+    // the entry region (managed by Buddy_Malloc) should be larger than 4GB
+    kvs_sz = max(kvs_sz, (uint64_t)GiB2B(10));
+#endif
+    Mem *mem = new Mem(global_num_servers, global_num_threads, kvs_sz);
+
+    char tmpl[] = "/tmp/wukong_bench.XXXXXX";
+    if (mkdtemp(tmpl) == NULL) {
+        logstream(LOG_ERROR) << "failed to create a temporary directory" << LOG_endl;
+        return -1;
+    }
+    string dname = string(tmpl) + "/";
+    gen_mappings(dname, nverts);
+
+    uint64_t t = timer::get_usec();
+    String_Server *str_server = new String_Server(dname);
+    uint64_t load_usec = timer::get_usec() - t;
+    unlink((dname + "str_index").c_str());
+    unlink((dname + "str_normal").c_str());
+    rmdir(tmpl);
+
+    mt19937 rng(2016);
+
+    // NOTE: time is usec in total and nsec per op
+    printf("bench,case,param,ops,time_usec,time_per_op_nsec,result\n");
+
+    if (bench == "all" || bench == "gstore")
+        bench_gstore(mem, str_server, max(nverts * 4, (uint64_t)4000000), nlookups);
+
+    if (bench == "all" || bench == "bundle")
+        bench_bundle(rounds, rng);
+
+    if (bench == "all" || bench == "buddy")
+        bench_buddy(100000, rng);
+
+    if (bench == "all" || bench == "string")
+        bench_string(str_server, nverts, load_usec, nlookups, rng);
+
+    if (bench == "all" || bench == "logger") {
+        bench_logger(1, nlookups);
+        bench_logger(4, nlookups / 4);
+    }
+
+    if (bench == "all" || bench == "gstore" || bench == "engine" || bench == "planner") {
+        vector<triple_t> triples;
+        gen_triples(triples, nverts, 2, nverts / 10, rng);
+        DGraph *graph = new DGraph(0, mem, str_server, triples);
+
+        if (bench == "all" || bench == "gstore")
+            bench_gstore_scan(graph, nverts);
+
+        if (bench == "all" || bench == "engine") {
+            Engine *engine = new Engine(0, global_num_proxies, str_server, graph, NULL);
+            Engine_Bench(engine, rounds).run_all(nverts);
+            delete engine;
+        }
+
+        if (bench == "all" || bench == "planner")
+            bench_planner(graph, str_server, rounds);
+        delete graph;
+    }
+
+    delete str_server;
+    delete mem;
+    return 0;
+}
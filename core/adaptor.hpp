@@ -35,16 +35,32 @@ public:
     TCP_Adaptor *tcp;   // communicaiton by TCP/IP
     RDMA_Adaptor *rdma; // communicaiton by RDMA
 
+    // traffic counters
+    // the send counters are only updated by the owner thread (w/o atomics), while
+    // the recv counters are atomic since the neighboring engine (work stealing)
+    // and the buddy of a dormant engine also receive by the adaptor
+    uint64_t rdma_send_bytes = 0;
+    uint64_t tcp_send_bytes = 0;
+    uint64_t send_msgs = 0;
+    uint64_t recv_bytes = 0;
+    uint64_t recv_msgs = 0;
+
     Adaptor(int tid, TCP_Adaptor *tcp, RDMA_Adaptor *rdma)
         : tid(tid), tcp(tcp), rdma(rdma) { }
 
     ~Adaptor() { }
 
     bool send(int dst_sid, int dst_tid, Bundle &bundle) {
-        if (global_use_rdma && rdma->init)
-            return rdma->send(tid, dst_sid, dst_tid, bundle.get_type() + bundle.data);
-        else
-            return tcp->send(dst_sid, dst_tid, bundle.get_type() + bundle.data);
+        bool ret;
+        if (global_use_rdma && rdma->init) {
+            ret = rdma->send(tid, dst_sid, dst_tid, bundle.get_type() + bundle.data);
+            if (ret) rdma_send_bytes += bundle.data.size() + 1;
+        } else {
+            ret = tcp->send(dst_sid, dst_tid, bundle.get_type() + bundle.data);
+            if (ret) tcp_send_bytes += bundle.data.size() + 1;
+        }
+        if (ret) send_msgs++;
+        return ret;
     }
 
     Bundle recv() {
@@ -68,6 +84,8 @@ public:
 
         bundle.set_type(str.at(0));
         bundle.data = str.substr(1);
+        __atomic_add_fetch(&recv_bytes, str.size(), __ATOMIC_RELAXED);
+        __atomic_add_fetch(&recv_msgs, 1, __ATOMIC_RELAXED);
         return true;
     }
 };
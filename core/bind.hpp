@@ -22,7 +22,11 @@
 
 #pragma once
 
+#include <unistd.h>
 #include <hwloc.h>
+#include <algorithm>
+#include <functional>
+#include <thread>
 #include <boost/algorithm/string/predicate.hpp>
 
 using namespace std;
@@ -54,12 +58,14 @@ using namespace std;
  *
  */
 
+hwloc_topology_t topology;
 vector<vector<int>> cpu_topo;
+map<int, int> core_nodes; // core -> NUMANODE
 int num_cores = 0;
 
 bool enable_binding = false;
 vector<int> default_bindings; // bind to core one-by-one
-map<int, int> core_bindings; // user-defined core binding
+map<int, int> core_bindings; // user-defined (or NUMA-aware) core binding
 
 
 void dump_node_topo(vector<vector<int>> topo)
@@ -75,8 +81,6 @@ void dump_node_topo(vector<vector<int>> topo)
 
 void load_node_topo(void)
 {
-    hwloc_topology_t topology;
-
     hwloc_topology_init(&topology);
     hwloc_topology_load(topology);
 
@@ -94,6 +98,7 @@ void load_node_topo(void)
             unsigned int core = 0;
             hwloc_bitmap_foreach_begin(core, cpuset);
             cpu_topo[i].push_back(core);
+            core_nodes[core] = i;
             default_bindings.push_back(core);
             hwloc_bitmap_foreach_end();
 
@@ -109,6 +114,7 @@ void load_node_topo(void)
             unsigned int core = 0;
             hwloc_bitmap_foreach_begin(core, cpuset);
             cpu_topo[0].push_back(core);
+            core_nodes[core] = 0;
             default_bindings.push_back(core);
             hwloc_bitmap_foreach_end();
 
@@ -164,6 +170,114 @@ bool load_core_binding(string fname)
 }
 
 
+/*
+ * Generate the NUMA-aware core binding (w/o 'core.bind')
+ *
+ * The proxies and the engines are spread evenly across NUMANODEs (round-robin),
+ * e.g., engine 0, 2, 4, .. on node 0 and engine 1, 3, 5, .. on node 1 (2 nodes),
+ * and the threads on a node take its cores one-by-one.
+ */
+void auto_core_binding(void)
+{
+    int nnodes = cpu_topo.size();
+    vector<int> next(nnodes, 0); // the next core of each node
+
+    auto bind = [&](int tid, int nid) {
+        core_bindings[tid] = cpu_topo[nid][next[nid]++ % cpu_topo[nid].size()];
+    };
+
+    for (int i = 0; i < global_num_proxies; i++)
+        bind(i, i % nnodes);
+    for (int i = 0; i < global_num_engines; i++)
+        bind(global_num_proxies + i, i % nnodes);
+
+    for (int nid = 0; nid < nnodes; nid++)
+        if (next[nid] > cpu_topo[nid].size())
+            logstream(LOG_WARNING) << "#threads on node " << nid << " exceeds its #cores!" << LOG_endl;
+}
+
+// the NUMANODE of the core which thread @tid is bound to
+int get_thread_node(int tid)
+{
+    int core = (enable_binding && core_bindings.count(tid) != 0) ?
+               core_bindings[tid] : default_bindings[tid % num_cores];
+    return core_nodes[core];
+}
+
+/*
+ * The neighbor of engine @eid (from 0) to steal tasks from
+ *
+ * By default, the engines are paired from two ends (i.e., #0 and #N-1).
+ * For NUMA-aware placement, they are paired on the same node if possible,
+ * since stolen tasks access the memory (e.g., ring buffers) of the victim.
+ */
+int get_engine_neighbor(int eid)
+{
+    int mirror = (global_num_engines - 1) - eid;
+    if (!global_enable_numa_placement || cpu_topo.size() <= 1)
+        return mirror;
+
+    int nid = get_thread_node(global_num_proxies + eid);
+    vector<int> peers; // the engines on the same node
+    for (int i = 0; i < global_num_engines; i++)
+        if (get_thread_node(global_num_proxies + i) == nid)
+            peers.push_back(i);
+
+    if (peers.size() == 1)
+        return mirror; // no engine on the same node
+
+    int idx = find(peers.begin(), peers.end(), eid) - peers.begin();
+    return peers[(peers.size() - 1) - idx];
+}
+
+/*
+ * Place the memory [@addr, @addr + @sz) on NUMANODE @nid (or interleave
+ * it over all nodes if @nid < 0), which migrates the touched pages.
+ */
+void bind_mem_to_node(char *addr, uint64_t sz, int nid = -1)
+{
+    int nnodes = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_NUMANODE);
+    if (nnodes <= 1 || sz == 0) return;
+
+    // only the whole pages are placed
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t begin = ((uint64_t)addr + page - 1) / page * page;
+    uint64_t end = ((uint64_t)addr + sz) / page * page;
+    if (begin >= end) return;
+
+    hwloc_nodeset_t nodeset;
+    hwloc_membind_policy_t policy;
+    if (nid >= 0) {
+        nodeset = hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, nid)->nodeset;
+        policy = HWLOC_MEMBIND_BIND;
+    } else {
+        nodeset = hwloc_get_root_obj(topology)->nodeset;
+        policy = HWLOC_MEMBIND_INTERLEAVE;
+    }
+
+    if (hwloc_set_area_membind(topology, (void *)begin, end - begin, nodeset, policy,
+                               HWLOC_MEMBIND_MIGRATE | HWLOC_MEMBIND_BYNODESET) != 0)
+        logstream(LOG_WARNING) << "Failed to place memory on NUMANODE " << nid << LOG_endl;
+}
+
+/*
+ * Run @func by a thread on the cores of NUMANODE @nid, so that the memory
+ * allocated (first touched) by @func is on the node
+ */
+void run_on_node(int nid, std::function<void()> func)
+{
+    std::thread t([&]() {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (auto core : cpu_topo[nid])
+            CPU_SET(core, &mask);
+        if (sched_setaffinity(0, sizeof(mask), &mask) != 0)
+            logstream(LOG_ERROR) << "Fail to set affinity (node: " << nid << ")" << LOG_endl;
+        func();
+    });
+    t.join();
+}
+
 /*
  * Bind the current thread to a special core (core number)
  */
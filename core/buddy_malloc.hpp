@@ -25,6 +25,9 @@ public:
 
     //print out usage of each level's block
     virtual void print_memory_usage() = 0;
+
+    //the size of allocated blocks (bytes)
+    virtual uint64_t get_used_size() = 0;
 };
 
 class Buddy_Malloc : public Malloc_Interface {
@@ -527,15 +530,21 @@ public:
 
     void print_memory_usage() {
         logstream(LOG_INFO) << "graph_storage edge memory status:" << LOG_endl;
-        uint64_t size_count = 0;
 
         for (int i = level_low_bound; i <= level_up_bound; i++) {
             logstream(LOG_INFO) << "level" << setw(2) << i << ": " << setw(10) << usage_counter[i] << "|\t";
             if ((i - level_low_bound + 1) % 4 == 0) logstream(LOG_INFO) << LOG_endl;
-            size_count += (1LL << i) * usage_counter[i];
         }
 
-        logstream(LOG_INFO) << "Size count: " << size_count << LOG_endl << LOG_endl;
+        logstream(LOG_INFO) << "Size count: " << get_used_size() << LOG_endl << LOG_endl;
+    }
+
+    // NOTE: read w/o the lock, which is good enough for statistics
+    uint64_t get_used_size() {
+        uint64_t size_count = 0;
+        for (int i = level_low_bound; i <= level_up_bound; i++)
+            size_count += (1LL << i) * usage_counter[i];
+        return size_count;
     }
 };
 
@@ -33,6 +33,7 @@
 
 #include "rdma.hpp"
 #include "assertion.hpp"
+#include "unit.hpp"
 
 
 using namespace std;
@@ -51,11 +52,17 @@ int global_ctrl_port_base = 9576;
 int global_memstore_size_gb = 20;
 int global_rdma_buf_size_mb = 64;
 int global_rdma_rbf_size_mb = 16;
+int global_result_pool_mb = 64;  // the max size of recycled result buffers per engine
+int global_trace_buffer_size = 65536;  // the max number of trace events per engine
 
 bool global_use_rdma = true;
 bool global_generate_statistics = true;
 bool global_enable_caching = true;
 bool global_enable_workstealing = false;
+bool global_enable_load_routing = false;    // route queries by the loads of engines (see load_board.hpp)
+bool global_enable_elastic_engines = false; // adapt #active engines to the utilization (see elastic.hpp)
+bool global_enable_numa_placement = false;  // place threads and buffers by NUMA nodes (see bind.hpp)
+bool global_enable_numa_replicas = false;   // replicate read-mostly structures per NUMA node
 
 int global_mt_threshold = 16;
 int global_rdma_threshold = 300;
@@ -66,6 +73,46 @@ bool global_enable_planner = true;  // for planner
 
 bool global_enable_vattr = false;  // for attr
 
+bool global_enable_dedup = true;  // drop dead columns and duplicate rows during exploration
+
+bool global_enable_tracing = false;  // record span events of queries on engines
+
+int global_latency_precision = 3;  // #significant digits of latency histograms
+
+int global_stat_dump_interval = 0;  // dump metrics every <sec> (0: disabled)
+string global_stat_dump_file = "wukong_stat.prom";  // suffixed by server ID
+
+int global_log_level = LOG_INFO;          // the logs below the level are skipped
+bool global_enable_async_log = false;     // format and write logs on a background thread
+int global_async_log_buffer_kb = 256;     // the ring buffer of logs per thread
+
+// the two-class (light/heavy) scheduling of queries on engines (see Engine::run)
+bool global_enable_query_class = false;  // run light queries before heavy ones
+int global_heavy_query_cost = 100000;    // the estimated cost of a heavy query (see Planner)
+int global_light_engines = 0;            // #engines per server reserved for light queries
+
+// the cooperative preemption of queries at the boundary of steps (see Engine::should_yield)
+int global_query_quantum_us = 0;   // the time slice of a query (0: unlimited)
+int global_query_row_budget = 0;   // the rows produced by a query per time slice (0: unlimited)
+
+// the partitioning of vertices over servers (see partitioner.hpp)
+string global_partitioner = "hash";  // hash or ldg
+
+// the cache of query results on each proxy (see result_cache.hpp)
+int global_result_cache_mb = 0;                // the memory budget per proxy (0: disabled)
+string global_result_cache_policy = "lru";     // the eviction policy (lru or lfu)
+
+// the cache of materialized prefixes of queries on each server (see prefix_cache.hpp)
+int global_prefix_cache_mb = 0;    // the memory budget per server (0: disabled)
+
+// the replication of hot vertices on other servers (see hot_vertex.hpp)
+int global_hot_vertex_threshold = 0;  // #sampled accesses per epoch of a hot vertex (0: disabled)
+int global_hot_replica_mb = 64;       // the memory budget of replicas per server
+
+// the injected network of the single-process simulation (see sim.hpp)
+int global_sim_latency_us = 2;      // one-way latency of a message or a one-sided operation
+int global_sim_bandwidth_mbps = 0;  // bandwidth of the NIC of each server (0: unlimited)
+
 static bool set_immutable_config(string cfg_name, string value)
 {
     if (cfg_name == "global_num_proxies") {
@@ -102,8 +149,29 @@ static bool set_immutable_config(string cfg_name, string value)
     } else if (cfg_name == "global_rdma_rbf_size_mb") {
         global_rdma_rbf_size_mb = atoi(value.c_str());
         ASSERT(global_rdma_rbf_size_mb > 0);
+    } else if (cfg_name == "global_result_pool_mb") {
+        global_result_pool_mb = atoi(value.c_str());
+        ASSERT(global_result_pool_mb >= 0);
+    } else if (cfg_name == "global_trace_buffer_size") {
+        global_trace_buffer_size = atoi(value.c_str());
+        ASSERT(global_trace_buffer_size > 0);
+    } else if (cfg_name == "global_stat_dump_file") {
+        global_stat_dump_file = value;
     } else if (cfg_name == "global_generate_statistics") {
         global_generate_statistics = atoi(value.c_str());
+    } else if (cfg_name == "global_async_log_buffer_kb") {
+        global_async_log_buffer_kb = atoi(value.c_str());
+        ASSERT(global_async_log_buffer_kb > 0);
+    } else if (cfg_name == "global_light_engines") {
+        global_light_engines = atoi(value.c_str());
+        ASSERT(global_light_engines >= 0);
+    } else if (cfg_name == "global_enable_numa_placement") {
+        global_enable_numa_placement = atoi(value.c_str());
+    } else if (cfg_name == "global_enable_numa_replicas") {
+        global_enable_numa_replicas = atoi(value.c_str());
+    } else if (cfg_name == "global_partitioner") {
+        ASSERT(value == "hash" || value == "ldg");
+        global_partitioner = value;
     }
     else {
         return false;
@@ -136,12 +204,63 @@ static bool set_mutable_config(string cfg_name, string value)
         global_enable_caching = atoi(value.c_str());
     } else if (cfg_name == "global_enable_workstealing") {
         global_enable_workstealing = atoi(value.c_str());
+    } else if (cfg_name == "global_enable_load_routing") {
+        global_enable_load_routing = atoi(value.c_str());
+    } else if (cfg_name == "global_enable_elastic_engines") {
+        global_enable_elastic_engines = atoi(value.c_str());
     } else if (cfg_name == "global_silent") {
         global_silent = atoi(value.c_str());
     } else if (cfg_name == "global_enable_planner") {
         global_enable_planner = atoi(value.c_str());
     } else if (cfg_name == "global_enable_vattr") {
         global_enable_vattr = atoi(value.c_str());
+    } else if (cfg_name == "global_enable_dedup") {
+        global_enable_dedup = atoi(value.c_str());
+    } else if (cfg_name == "global_enable_tracing") {
+        global_enable_tracing = atoi(value.c_str());
+    } else if (cfg_name == "global_stat_dump_interval") {
+        global_stat_dump_interval = atoi(value.c_str());
+        ASSERT(global_stat_dump_interval >= 0);
+    } else if (cfg_name == "global_latency_precision") {
+        global_latency_precision = atoi(value.c_str());
+        ASSERT(global_latency_precision >= 1 && global_latency_precision <= 5);
+    } else if (cfg_name == "global_sim_latency_us") {
+        global_sim_latency_us = atoi(value.c_str());
+        ASSERT(global_sim_latency_us >= 0);
+    } else if (cfg_name == "global_sim_bandwidth_mbps") {
+        global_sim_bandwidth_mbps = atoi(value.c_str());
+        ASSERT(global_sim_bandwidth_mbps >= 0);
+    } else if (cfg_name == "global_log_level") {
+        global_log_level = atoi(value.c_str());
+        ASSERT(global_log_level >= LOG_EVERYTHING && global_log_level <= LOG_NONE);
+    } else if (cfg_name == "global_enable_async_log") {
+        global_enable_async_log = atoi(value.c_str());
+    } else if (cfg_name == "global_enable_query_class") {
+        global_enable_query_class = atoi(value.c_str());
+    } else if (cfg_name == "global_heavy_query_cost") {
+        global_heavy_query_cost = atoi(value.c_str());
+        ASSERT(global_heavy_query_cost >= 0);
+    } else if (cfg_name == "global_query_quantum_us") {
+        global_query_quantum_us = atoi(value.c_str());
+        ASSERT(global_query_quantum_us >= 0);
+    } else if (cfg_name == "global_query_row_budget") {
+        global_query_row_budget = atoi(value.c_str());
+        ASSERT(global_query_row_budget >= 0);
+    } else if (cfg_name == "global_result_cache_mb") {
+        global_result_cache_mb = atoi(value.c_str());
+        ASSERT(global_result_cache_mb >= 0);
+    } else if (cfg_name == "global_result_cache_policy") {
+        ASSERT(value == "lru" || value == "lfu");
+        global_result_cache_policy = value;
+    } else if (cfg_name == "global_prefix_cache_mb") {
+        global_prefix_cache_mb = atoi(value.c_str());
+        ASSERT(global_prefix_cache_mb >= 0);
+    } else if (cfg_name == "global_hot_vertex_threshold") {
+        global_hot_vertex_threshold = atoi(value.c_str());
+        ASSERT(global_hot_vertex_threshold >= 0);
+    } else if (cfg_name == "global_hot_replica_mb") {
+        global_hot_replica_mb = atoi(value.c_str());
+        ASSERT(global_hot_replica_mb >= 0);
     } else {
         return false;
     }
@@ -176,6 +295,13 @@ static void file2items(string fname, map<string, string> &items)
     }
 }
 
+// apply the configurations of logging
+static void config_logger()
+{
+    global_logger().set_log_level(global_log_level);
+    global_logger().set_async(global_enable_async_log, KiB2B(global_async_log_buffer_kb));
+}
+
 /**
  * reload config
  */
@@ -193,6 +319,8 @@ void reload_config(string str)
     // limited the number of engines
     global_mt_threshold = max(1, min(global_mt_threshold, global_num_engines));
 
+    config_logger();
+
     return;
 }
 
@@ -219,9 +347,14 @@ void load_config(string fname, int num_servers)
     // set the total number of threads
     global_num_threads = global_num_engines + global_num_proxies;
 
+    // leave at least one engine for heavy queries
+    global_light_engines = min(global_light_engines, global_num_engines - 1);
+
     // limited the number of engines
     global_mt_threshold = max(1, min(global_mt_threshold, global_num_engines));
 
+    config_logger();
+
     return;
 }
 
@@ -241,15 +374,42 @@ void print_config(void)
     logstream(LOG_INFO) << "global_memstore_size_gb: "  << global_memstore_size_gb      << LOG_endl;
     logstream(LOG_INFO) << "global_rdma_buf_size_mb: "  << global_rdma_buf_size_mb      << LOG_endl;
     logstream(LOG_INFO) << "global_rdma_rbf_size_mb: "  << global_rdma_rbf_size_mb      << LOG_endl;
+    logstream(LOG_INFO) << "global_result_pool_mb: "    << global_result_pool_mb        << LOG_endl;
+    logstream(LOG_INFO) << "global_trace_buffer_size: " << global_trace_buffer_size     << LOG_endl;
     logstream(LOG_INFO) << "global_use_rdma: "          << global_use_rdma              << LOG_endl;
     logstream(LOG_INFO) << "global_enable_caching: "        << global_enable_caching        << LOG_endl;
     logstream(LOG_INFO) << "global_enable_workstealing: "   << global_enable_workstealing   << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_load_routing: "   << global_enable_load_routing   << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_elastic_engines: " << global_enable_elastic_engines << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_numa_placement: " << global_enable_numa_placement << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_numa_replicas: "  << global_enable_numa_replicas  << LOG_endl;
+    logstream(LOG_INFO) << "global_partitioner: "       << global_partitioner           << LOG_endl;
     logstream(LOG_INFO) << "global_rdma_threshold: "        << global_rdma_threshold        << LOG_endl;
     logstream(LOG_INFO) << "global_mt_threshold: "      << global_mt_threshold          << LOG_endl;
     logstream(LOG_INFO) << "global_silent: "                << global_silent                << LOG_endl;
     logstream(LOG_INFO) << "global_enable_planner: "        << global_enable_planner        << LOG_endl;
     logstream(LOG_INFO) << "global_generate_statistics: "   << global_generate_statistics   << LOG_endl;
     logstream(LOG_INFO) << "global_enable_vattr: "      << global_enable_vattr          << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_dedup: "      << global_enable_dedup          << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_tracing: "    << global_enable_tracing        << LOG_endl;
+    logstream(LOG_INFO) << "global_latency_precision: " << global_latency_precision     << LOG_endl;
+    logstream(LOG_INFO) << "global_stat_dump_interval: " << global_stat_dump_interval   << LOG_endl;
+    logstream(LOG_INFO) << "global_stat_dump_file: "    << global_stat_dump_file        << LOG_endl;
+    logstream(LOG_INFO) << "global_sim_latency_us: "    << global_sim_latency_us        << LOG_endl;
+    logstream(LOG_INFO) << "global_sim_bandwidth_mbps: " << global_sim_bandwidth_mbps   << LOG_endl;
+    logstream(LOG_INFO) << "global_log_level: "         << global_log_level             << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_async_log: "  << global_enable_async_log      << LOG_endl;
+    logstream(LOG_INFO) << "global_async_log_buffer_kb: " << global_async_log_buffer_kb << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_query_class: " << global_enable_query_class   << LOG_endl;
+    logstream(LOG_INFO) << "global_heavy_query_cost: "  << global_heavy_query_cost      << LOG_endl;
+    logstream(LOG_INFO) << "global_light_engines: "     << global_light_engines         << LOG_endl;
+    logstream(LOG_INFO) << "global_query_quantum_us: "  << global_query_quantum_us      << LOG_endl;
+    logstream(LOG_INFO) << "global_query_row_budget: "  << global_query_row_budget      << LOG_endl;
+    logstream(LOG_INFO) << "global_result_cache_mb: "   << global_result_cache_mb       << LOG_endl;
+    logstream(LOG_INFO) << "global_result_cache_policy: " << global_result_cache_policy << LOG_endl;
+    logstream(LOG_INFO) << "global_prefix_cache_mb: "   << global_prefix_cache_mb       << LOG_endl;
+    logstream(LOG_INFO) << "global_hot_vertex_threshold: " << global_hot_vertex_threshold << LOG_endl;
+    logstream(LOG_INFO) << "global_hot_replica_mb: "    << global_hot_replica_mb        << LOG_endl;
 
     logstream(LOG_INFO) << "--" << LOG_endl;
 
@@ -25,6 +25,7 @@
 #include <iostream>
 #include <string>
 #include <set>
+#include <functional>
 
 #include <boost/unordered_map.hpp>
 #include <boost/archive/binary_oarchive.hpp>
@@ -35,6 +36,7 @@
 #include "config.hpp"
 #include "proxy.hpp"
 #include "monitor.hpp"
+#include "sim.hpp"
 
 using namespace std;
 using namespace boost;
@@ -42,7 +44,8 @@ using namespace boost::program_options;
 
 
 // communicate between proxy threads
-TCP_Adaptor *con_adaptor;
+vector<TCP_Adaptor *> con_adaptors;  // indexed by server ID
+static __thread TCP_Adaptor *con_adaptor = NULL;  // the one of the server of current proxy
 
 bool enable_oneshot = false;
 string oneshot_cmd = "";
@@ -71,17 +74,21 @@ static T console_recv(int tid)
 static void console_barrier(int tid)
 {
     static int _curr = 0;
-    static __thread int _next = 1;
+    static __thread int _next = 0;
+
+    // all proxies in the process, which are of all servers under simulation
+    bool sim = Sim_Network::get().is_enabled();
+    int nproxies = sim ? global_num_servers * global_num_proxies : global_num_proxies;
 
     // inter-server barrier (by the leader proxy)
-    if (tid == 0)
+    if (tid == 0 && !sim)
         MPI_Barrier(MPI_COMM_WORLD);
 
-    // intra-server barrier
+    // intra-process barrier
+    _next += nproxies; // this barrier
     __sync_fetch_and_add(&_curr, 1);
     while (_curr < _next)
         usleep(1); // wait
-    _next += global_num_proxies; // next barrier
 }
 
 // the master proxy is the 1st proxy of the 1st server (i.e., sid == 0 and tid == 0)
@@ -103,6 +110,10 @@ options_description       load_desc("load <args>         load RDF data into dyna
 options_description       gsck_desc("gsck <args>         check the integrity of (in-memmory) graph storage");
 options_description  load_stat_desc("load-stat           load statistics of SPARQL query optimizer");
 options_description store_stat_desc("store-stat          store statistics of SPARQL query optimizer");
+options_description      trace_desc("trace <args>        trace queries on engines of all servers");
+options_description       stat_desc("stat <args>         show runtime metrics of engines on all servers");
+options_description        mem_desc("mem <args>          show memory usage of subsystems on all servers");
+options_description     engine_desc("engine <args>       show or set the active engines on all servers");
 
 
 /*
@@ -134,6 +145,9 @@ void init_options_desc()
     (",n", value<int>()->default_value(1)->value_name("<num>"), "run <num> times")
     (",v", value<int>()->default_value(0)->value_name("<lines>"), "print at most <lines> of results")
     (",o", value<string>()->value_name("<fname>"), "output results into <fname>")
+    ("explain", "print the query plan with estimated #results (w/o execution)")
+    ("profile", "print the query plan and the cost of each step (of the last run)")
+    ("class", value<string>()->value_name("<light|heavy>"), "declare the class of the query (default: estimated)")
     (",b", value<string>()->value_name("<fname>"), "run a batch of queries configured by <fname>")
     ("help,h", "help message about sparql")
     ;
@@ -145,6 +159,9 @@ void init_options_desc()
     (",d", value<int>()->default_value(10)->value_name("<sec>"), "eval <sec> seconds (default: 10)")
     (",w", value<int>()->default_value(5)->value_name("<sec>"), "warmup <sec> seconds (default: 5)")
     (",p", value<int>()->default_value(20)->value_name("<num>"), "send <num> queries in parallel (default: 20)")
+    (",r", value<int>()->value_name("<qps>"), "correct coordinated omission for the target rate of <qps> queries/sec")
+    ("open", value<int>()->value_name("<qps>"), "open-loop: send <qps> queries/sec per proxy regardless of replies")
+    ("constant", "send queries at a constant interval instead of Poisson arrivals (open-loop)")
     ("help,h", "help message about sparql-emu")
     ;
     all_desc.add(sparql_emu_desc);
@@ -178,6 +195,38 @@ void init_options_desc()
     ("help,h", "help message about store-stat")
     ;
     all_desc.add(store_stat_desc);
+
+    // e.g., wukong> trace <args>
+    trace_desc.add_options()
+    (",s", "start tracing (drop the events recorded before)")
+    (",t", "stop tracing")
+    (",o", value<string>()->value_name("<fname>"), "collect events from all servers and write a Chrome trace (JSON) into <fname>")
+    ("help,h", "help message about trace")
+    ;
+    all_desc.add(trace_desc);
+
+    // e.g., wukong> stat <args>
+    stat_desc.add_options()
+    (",e", "show the metrics of each engine in Prometheus text format (default: the sum of each server)")
+    (",o", value<string>()->value_name("<fname>"), "write the metrics in Prometheus text format into <fname>")
+    ("help,h", "help message about stat")
+    ;
+    all_desc.add(stat_desc);
+
+    // e.g., wukong> mem <args>
+    mem_desc.add_options()
+    (",e", "show the memory usage of each engine in Prometheus text format (default: the sum of each server)")
+    (",o", value<string>()->value_name("<fname>"), "write the memory usage in Prometheus text format into <fname>")
+    ("help,h", "help message about mem")
+    ;
+    all_desc.add(mem_desc);
+
+    // e.g., wukong> engine <args>
+    engine_desc.add_options()
+    (",a", value<int>()->value_name("<num>"), "set <num> active engines on each server (the rest are dormant)")
+    ("help,h", "help message about engine")
+    ;
+    all_desc.add(engine_desc);
 }
 
 
@@ -330,6 +379,8 @@ static void run_config(Proxy *proxy, int argc, char **argv)
  *   -n <num>     run <num> times
  *   -v <lines>   print at most <lines> of results
  *   -o <fname>   output results into <fname>
+ *   --explain    print the query plan with estimated #results (w/o execution)
+ *   --profile    print the query plan and the cost of each step (of the last run)
  *
  * sparql -b <fname>
  */
@@ -377,6 +428,21 @@ static void run_sparql(Proxy * proxy, int argc, char **argv)
         int mfactor = sparql_vm["-m"].as<int>(); // the number of multithreading
         int cnt = sparql_vm["-n"].as<int>();
         int nlines = sparql_vm["-v"].as<int>();
+        bool explain = sparql_vm.count("explain");
+        bool profile = sparql_vm.count("profile");
+
+        int qclass = -1; // estimated by the proxy
+        if (sparql_vm.count("class")) {
+            string cname = sparql_vm["class"].as<string>();
+            if (cname == "light") {
+                qclass = SPARQLQuery::SQ_LIGHT;
+            } else if (cname == "heavy") {
+                qclass = SPARQLQuery::SQ_HEAVY;
+            } else {
+                fail_to_parse(proxy, argc, argv); // invalid cmd
+                return;
+            }
+        }
 
         string ofname;
         if (sparql_vm.count("-o"))
@@ -395,14 +461,19 @@ static void run_sparql(Proxy * proxy, int argc, char **argv)
         SPARQLQuery reply;
         SPARQLQuery::Result &result = reply.result;
         Monitor monitor;
-        int ret = proxy->run_single_query(ifs, mfactor, cnt, reply, monitor);
+        int ret = proxy->run_single_query(ifs, mfactor, cnt, reply, monitor,
+                                          explain, profile, qclass);
         if (ret != 0) {
             logstream(LOG_ERROR) << "Failed to run the query (ERRNO: " << ret << ")!" << LOG_endl;
             fail_to_parse(proxy, argc, argv); // invalid cmd
             return;
         }
+        if (explain) return; // not executed
         monitor.print_latency(cnt);
+        monitor.print_cache();
         logstream(LOG_INFO) << "(last) result size: " << result.row_num << LOG_endl;
+        logstream(LOG_INFO) << "(last) peak intermediate result: "
+                            << reply.peak_bytes << " bytes" << LOG_endl;
 
         // print or dump results
         if (!global_silent && !result.blind) {
@@ -456,6 +527,9 @@ static void run_sparql(Proxy * proxy, int argc, char **argv)
  *   -d <sec>   eval <sec> seconds (default: 10)
  *   -w <sec>   warmup <sec> seconds (default: 5)
  *   -p <num>   send <num> queries in parallel (default: 20)
+ *   -r <qps>   correct coordinated omission for the target rate of <qps> queries/sec
+ *   --open <qps>   open-loop: send <qps> queries/sec per proxy regardless of replies
+ *   --constant     send queries at a constant interval instead of Poisson arrivals
  */
 static void run_sparql_emu(Proxy * proxy, int argc, char **argv)
 {
@@ -517,9 +591,31 @@ static void run_sparql_emu(Proxy * proxy, int argc, char **argv)
     }
 
 
+    // open-loop mode (the latency is measured from the intended send time)
+    int rate = 0;
+    if (sparql_emu_vm.count("open")) {
+        rate = sparql_emu_vm["open"].as<int>();
+        if (rate <= 0) {
+            fail_to_parse(proxy, argc, argv); // invalid cmd
+            return;
+        }
+    }
+    bool poisson = !sparql_emu_vm.count("constant");
+
     /// do sparql-emu
     Monitor monitor;
-    proxy->run_query_emu(ifs, duration, warmup, pfactor, monitor);
+    if (rate == 0 && sparql_emu_vm.count("-r")) {
+        int target = sparql_emu_vm["-r"].as<int>(); // the target rate of all proxies
+        if (target <= 0) {
+            fail_to_parse(proxy, argc, argv); // invalid cmd
+            return;
+        }
+
+        // each of <pfactor> in-flight queries on a proxy is a closed-loop client
+        int nclients = global_num_servers * global_num_proxies * pfactor;
+        monitor.set_expected_interval(SEC(1) * nclients / target);
+    }
+    proxy->run_query_emu(ifs, duration, warmup, pfactor, monitor, rate, poisson);
 
     // FIXME: maybe hang in here if the input file misses in some machines
     //        or inconsistent global variables (e.g., global_enable_planner)
@@ -534,6 +630,7 @@ static void run_sparql_emu(Proxy * proxy, int argc, char **argv)
         monitor.aggregate();
         monitor.print_cdf();
         monitor.print_thpt();
+        monitor.print_cache();
     } else {
         // send logs to the master proxy
         console_send<Monitor>(0, 0, monitor);
@@ -690,7 +787,12 @@ static void run_load_stat(Proxy *proxy, int argc, char **argv)
         fname = load_stat_vm["-f"].as<string>();
     }
 
-    proxy->statistic->load_stat_from_file(fname);
+    // each NUMANODE has its own copy of the statistics (see numa_replica.hpp)
+    int sid = proxy->sid;
+    if (sid < node_replicas.size() && node_replicas[sid] != NULL)
+        node_replicas[sid]->load_stat(fname);
+    else
+        proxy->statistic->load_stat_from_file(fname);
 }
 
 /**
@@ -736,14 +838,247 @@ static void run_store_stat(Proxy *proxy, int argc, char **argv)
     proxy->statistic->store_stat_to_file(fname);
 }
 
+/**
+ * run the 'trace' command
+ * usage:
+ * trace [options]
+ *   -s            start tracing (drop the events recorded before)
+ *   -t            stop tracing
+ *   -o <fname>    collect events from all servers and write a Chrome trace (JSON) into <fname>
+ *                 (only the events recorded since the last collection)
+ */
+static void run_trace(Proxy *proxy, int argc, char **argv)
+{
+    // use the leader proxy thread on each server to trace local engines
+    if (!LEADER(proxy))
+        return;
+
+    // parse command
+    variables_map trace_vm;
+    try {
+        store(parse_command_line(argc, argv, trace_desc), trace_vm);
+    } catch (...) {
+        fail_to_parse(proxy, argc, argv);
+        return;
+    }
+    notify(trace_vm);
+
+    // parse options
+    if (trace_vm.count("help")) {
+        if (MASTER(proxy))
+            cout << trace_desc;
+        return;
+    }
+
+    if (!trace_vm.count("-s") && !trace_vm.count("-t") && !trace_vm.count("-o")) {
+        if (MASTER(proxy))
+            fail_to_parse(proxy, argc, argv); // invalid cmd
+        return;
+    }
+
+    /// do trace (stop, collect and then start)
+    if (trace_vm.count("-t"))
+        global_enable_tracing = false;
+
+    if (trace_vm.count("-o")) {
+        vector<Trace_Event> events;
+        for (auto e : engines[proxy->sid])
+            e->collect_trace(events);
+
+        if (MASTER(proxy)) {
+            for (int i = 1; i < global_num_servers; i++) {
+                vector<Trace_Event> other = console_recv<vector<Trace_Event>>(proxy->tid);
+                events.insert(events.end(), other.begin(), other.end());
+            }
+
+            string fname = trace_vm["-o"].as<string>();
+            write_chrome_trace(events, fname);
+            logstream(LOG_INFO) << "Write " << events.size() << " trace events into "
+                                << fname << LOG_endl;
+        } else {
+            // send events to the master proxy
+            console_send<vector<Trace_Event>>(0, 0, events);
+        }
+    }
+
+    if (trace_vm.count("-s")) {
+        for (auto e : engines[proxy->sid])
+            e->clear_trace();
+        global_enable_tracing = true;
+    }
+}
+
+/**
+ * collect the metrics kept by @keep on the leader proxy of each server, and show them
+ * on the master proxy (see the options -e and -o of 'stat' in @vm), which is shared by
+ * the 'stat', 'mem' and 'engine' commands
+ */
+static void show_metrics(Proxy *proxy, variables_map &vm,
+                         std::function<bool(const Metrics::Sample &)> keep)
+{
+    Metrics all, metrics;
+    collect_server_metrics(proxy->sid, all);
+    collect_proxy_metrics(proxy->sid, all);
+    for (auto &s : all.samples)
+        if (keep(s))
+            metrics.samples.push_back(s);
+
+    if (!MASTER(proxy)) {
+        // send metrics to the master proxy
+        console_send<Metrics>(0, 0, metrics);
+        return;
+    }
+
+    for (int i = 1; i < global_num_servers; i++) {
+        Metrics other = console_recv<Metrics>(proxy->tid);
+        metrics.merge(other);
+    }
+
+    if (vm.count("-o")) {
+        string fname = vm["-o"].as<string>();
+        if (!metrics.dump_prometheus(fname))
+            logstream(LOG_ERROR) << "Can't write metrics into " << fname << LOG_endl;
+    }
+
+    if (vm.count("-e"))
+        cout << metrics.to_prometheus();
+    else
+        metrics.print();
+}
+
+/**
+ * run the 'stat' command
+ * usage:
+ * stat [options]
+ *   -e            show the metrics of each engine in Prometheus text format
+ *                 (default: the sum of each server)
+ *   -o <fname>    write the metrics in Prometheus text format into <fname>
+ */
+static void run_stat(Proxy *proxy, int argc, char **argv)
+{
+    // use the leader proxy thread on each server to collect local metrics
+    if (!LEADER(proxy))
+        return;
+
+    // parse command
+    variables_map stat_vm;
+    try {
+        store(parse_command_line(argc, argv, stat_desc), stat_vm);
+    } catch (...) {
+        fail_to_parse(proxy, argc, argv);
+        return;
+    }
+    notify(stat_vm);
+
+    // parse options
+    if (stat_vm.count("help")) {
+        if (MASTER(proxy))
+            cout << stat_desc;
+        return;
+    }
+
+    /// do stat
+    show_metrics(proxy, stat_vm, [](const Metrics::Sample &s) { return true; });
+}
+
+/**
+ * run the 'mem' command
+ * usage:
+ * mem [options]
+ *   -e            show the memory usage of each engine in Prometheus text format
+ *                 (default: the sum of each server)
+ *   -o <fname>    write the memory usage in Prometheus text format into <fname>
+ */
+static void run_mem(Proxy *proxy, int argc, char **argv)
+{
+    // use the leader proxy thread on each server to collect local metrics
+    if (!LEADER(proxy))
+        return;
+
+    // parse command
+    variables_map mem_vm;
+    try {
+        store(parse_command_line(argc, argv, mem_desc), mem_vm);
+    } catch (...) {
+        fail_to_parse(proxy, argc, argv);
+        return;
+    }
+    notify(mem_vm);
+
+    // parse options
+    if (mem_vm.count("help")) {
+        if (MASTER(proxy))
+            cout << mem_desc;
+        return;
+    }
+
+    /// do mem
+    // only keep the memory gauges (in bytes)
+    show_metrics(proxy, mem_vm, [](const Metrics::Sample &s) {
+        return s.type == Metrics::GAUGE && boost::ends_with(s.name, "_bytes");
+    });
+}
+
+/**
+ * run the 'engine' command
+ * usage:
+ * engine [options]
+ *   -a <num>      set <num> active engines on each server (the rest are dormant)
+ *
+ * It shows the active engines of each server, and the busy and dormant time
+ * of engines against the latency of queries (see elastic.hpp).
+ */
+static void run_engine(Proxy *proxy, int argc, char **argv)
+{
+    // use the leader proxy thread on each server to set local engines
+    if (!LEADER(proxy))
+        return;
+
+    // parse command
+    variables_map engine_vm;
+    try {
+        store(parse_command_line(argc, argv, engine_desc), engine_vm);
+    } catch (...) {
+        fail_to_parse(proxy, argc, argv);
+        return;
+    }
+    notify(engine_vm);
+
+    // parse options
+    if (engine_vm.count("help")) {
+        if (MASTER(proxy))
+            cout << engine_desc;
+        return;
+    }
+
+    /// do engine
+    if (engine_vm.count("-a")) {
+        int n = elastic_engines[proxy->sid].set_active(engine_vm["-a"].as<int>());
+        if (MASTER(proxy))
+            logstream(LOG_INFO) << "Set " << n << " active engines on each server" << LOG_endl;
+    }
+
+    static const char *names[] = {
+        "active_engines", "engine_scale_ups_total", "engine_scale_downs_total",
+        "busy_usec_total", "dormant_usec_total", "dormant_total", "dormant_drains_total",
+        "query_answers_total", "query_latency_usec_total"
+    };
+    show_metrics(proxy, engine_vm, [](const Metrics::Sample &s) {
+        return find(begin(names), end(names), s.name) != end(names);
+    });
+}
+
 /**
  * The Wukong's console is co-located with the main proxy (the 1st proxy thread on the 1st server)
  * and provide a simple interactive cmdline to tester
  */
 void run_console(Proxy *proxy)
 {
-    // init option descriptions once on each server (by the leader proxy)
-    if (LEADER(proxy))
+    con_adaptor = con_adaptors[proxy->sid];
+
+    // init option descriptions once on each server (by the leader proxy),
+    // and simulated servers share them (by the master proxy)
+    if (LEADER(proxy) && (MASTER(proxy) || !Sim_Network::get().is_enabled()))
         init_options_desc();
 
     console_barrier(proxy->tid);
@@ -753,18 +1088,27 @@ void run_console(Proxy *proxy)
              << endl
              << endl;
 
-    bool once = true;
+    // one-shot commands are separated by ';' (e.g., "sparql -f q1; stat")
+    vector<string> oneshot_cmds;
+    if (MASTER(proxy) && enable_oneshot) {
+        vector<string> cmds;
+        boost::split(cmds, oneshot_cmd, boost::is_any_of(";"));
+        for (auto &c : cmds) {
+            boost::trim(c);
+            if (!c.empty()) oneshot_cmds.push_back(c);
+        }
+    }
+
+    int next_oneshot = 0;
     while (true) {
         console_barrier(proxy->tid);
         string cmd;
         if (MASTER(proxy)) {
             if (enable_oneshot) {
-                // one-shot command mode: run the command once and then quit
-                if (once) {
-                    logstream(LOG_INFO) << "Run one-shot command: " << oneshot_cmd << LOG_endl;
-                    cmd = oneshot_cmd;
-
-                    once = false;
+                // one-shot command mode: run the commands one by one and then quit
+                if (next_oneshot < oneshot_cmds.size()) {
+                    cmd = oneshot_cmds[next_oneshot++];
+                    logstream(LOG_INFO) << "Run one-shot command: " << cmd << LOG_endl;
                 } else {
                     logstream(LOG_INFO) << "Done" << LOG_endl;
                     cmd = "quit";
@@ -773,6 +1117,7 @@ void run_console(Proxy *proxy)
                 // interactive mode: print a prompt and retrieve the command
                 // skip input with blank
                 size_t pos;
+                global_logger().flush(); // the prompt follows the logs
                 do {
                     cout << "wukong> ";
                     getline(cin, cmd);
@@ -826,6 +1171,14 @@ void run_console(Proxy *proxy)
             run_load_stat(proxy, argc, argv);
         } else if (cmd_type == "store-stat") {
             run_store_stat(proxy, argc, argv);
+        } else if (cmd_type == "trace") {
+            run_trace(proxy, argc, argv);
+        } else if (cmd_type == "stat") {
+            run_stat(proxy, argc, argv);
+        } else if (cmd_type == "mem") {
+            run_mem(proxy, argc, argv);
+        } else if (cmd_type == "engine") {
+            run_engine(proxy, argc, argv);
         } else {
             // the same invalid command dispatch to all proxies, print error msg once
             if (MASTER(proxy))
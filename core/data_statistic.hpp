@@ -51,6 +51,18 @@ public:
     unordered_map<ssid_t, int> global_tyscount;
     unordered_map<pair<ssid_t, ssid_t>, four_num, boost::hash<pair<int, int>>> global_ppcount;
 
+private:
+    uint64_t idp_size = 0;  // #entries of id_to_predicate when idp_bytes was computed
+    uint64_t idp_bytes = 0;
+
+    // a node holds the key-value pair and the link of the bucket list
+    template <typename Map>
+    static uint64_t map_bytes(Map &m) {
+        return m.size() * (sizeof(typename Map::value_type) + sizeof(void *))
+               + m.bucket_count() * sizeof(void *);
+    }
+
+public:
     TCP_Adaptor* tcp_adaptor;
     int sid;
 
@@ -58,6 +70,97 @@ public:
 
     data_statistic() { }
 
+    // accumulate the local statistics of a server into the global statistics
+    void merge_stat(data_statistic &other) {
+        for (unordered_map<ssid_t, int>::iterator it = other.predicate_to_triple.begin();
+                it != other.predicate_to_triple.end(); it++ ) {
+            ssid_t key = it->first;
+            int triple = it->second;
+            if (global_ptcount.find(key) == global_ptcount.end()) {
+                global_ptcount[key] = triple;
+            } else {
+                global_ptcount[key] += triple;
+            }
+        }
+
+        for (unordered_map<ssid_t, int>::iterator it = other.predicate_to_subject.begin();
+                it != other.predicate_to_subject.end(); it++ ) {
+            ssid_t key = it->first;
+            int subject = it->second;
+            if (global_pscount.find(key) == global_pscount.end()) {
+                global_pscount[key] = subject;
+            } else {
+                global_pscount[key] += subject;
+            }
+        }
+
+        for (unordered_map<ssid_t, int>::iterator it = other.predicate_to_object.begin();
+                it != other.predicate_to_object.end(); it++ ) {
+            ssid_t key = it->first;
+            int object = it->second;
+            if (global_pocount.find(key) == global_pocount.end()) {
+                global_pocount[key] = object;
+            } else {
+                global_pocount[key] += object;
+            }
+        }
+
+        for (unordered_map<pair<ssid_t, ssid_t>, four_num, boost::hash<pair<int, int>>>::iterator it = other.correlation.begin();
+                it != other.correlation.end(); it++ ) {
+            pair<ssid_t, ssid_t> key = it->first;
+            four_num value = it->second;
+            if (global_ppcount.find(it->first) == global_ppcount.end()) {
+                global_ppcount[key] = value;
+            } else {
+                global_ppcount[key].out_out += value.out_out;
+                global_ppcount[key].out_in += value.out_in;
+                global_ppcount[key].in_in += value.in_in;
+                global_ppcount[key].in_out += value.in_out;
+            }
+        }
+
+        //for type predicate
+        for (unordered_map<ssid_t, int>::iterator it = other.type_to_subject.begin();
+                it != other.type_to_subject.end(); it++ ) {
+            ssid_t key = it->first;
+            int subject = it->second;
+            if (global_tyscount.find(key) == global_tyscount.end()) {
+                global_tyscount[key] = subject;
+            } else {
+                global_tyscount[key] += subject;
+            }
+        }
+    }
+
+    // the statistics of type predicate are derived from the merged type statistics
+    void fix_type_stat() {
+        global_pocount[1] = global_tyscount.size();
+        int triple = 0;
+        for (unordered_map<ssid_t, int>::iterator it = global_tyscount.begin();
+                it != global_tyscount.end(); it++ ) {
+            triple += it->second;
+        }
+        global_ptcount[1] = triple;
+    }
+
+    // the estimated memory footprint of the statistics (in bytes)
+    uint64_t memory_usage() {
+        // the per-vertex predicates are only scanned when they have changed
+        if (id_to_predicate.size() != idp_size) {
+            idp_size = id_to_predicate.size();
+            idp_bytes = map_bytes(id_to_predicate);
+            for (auto &e : id_to_predicate)
+                idp_bytes += e.second.capacity() * sizeof(direct_p);
+        }
+
+        return map_bytes(predicate_to_triple) + map_bytes(predicate_to_subject)
+               + map_bytes(predicate_to_object) + map_bytes(type_to_subject)
+               + map_bytes(correlation) + idp_bytes
+               + map_bytes(global_ptcount) + map_bytes(global_pscount)
+               + map_bytes(global_pocount) + map_bytes(global_tyscount)
+               + map_bytes(global_ppcount);
+    }
+
     void gather_stat() {
         std::stringstream ss;
         boost::archive::binary_oarchive oa(ss);
@@ -77,67 +180,8 @@ public:
                 all_gather.push_back(tmp_data);
             }
 
-            for (int i = 0; i < all_gather.size(); i++) {
-                for (unordered_map<ssid_t, int>::iterator it = all_gather[i].predicate_to_triple.begin();
-                        it != all_gather[i].predicate_to_triple.end(); it++ ) {
-                    ssid_t key = it->first;
-                    int triple = it->second;
-                    if (global_ptcount.find(key) == global_ptcount.end()) {
-                        global_ptcount[key] = triple;
-                    } else {
-                        global_ptcount[key] += triple;
-                    }
-                }
-
-                for (unordered_map<ssid_t, int>::iterator it = all_gather[i].predicate_to_subject.begin();
-                        it != all_gather[i].predicate_to_subject.end(); it++ ) {
-                    ssid_t key = it->first;
-                    int subject = it->second;
-                    if (global_pscount.find(key) == global_pscount.end()) {
-                        global_pscount[key] = subject;
-                    } else {
-                        global_pscount[key] += subject;
-                    }
-                }
-
-                for (unordered_map<ssid_t, int>::iterator it = all_gather[i].predicate_to_object.begin();
-                        it != all_gather[i].predicate_to_object.end(); it++ ) {
-                    ssid_t key = it->first;
-                    int object = it->second;
-                    if (global_pocount.find(key) == global_pocount.end()) {
-                        global_pocount[key] = object;
-                    } else {
-                        global_pocount[key] += object;
-                    }
-                }
-
-                for (unordered_map<pair<ssid_t, ssid_t>, four_num, boost::hash<pair<int, int>>>::iterator it = all_gather[i].correlation.begin();
-                        it != all_gather[i].correlation.end(); it++ ) {
-                    pair<ssid_t, ssid_t> key = it->first;
-                    four_num value = it->second;
-                    if (global_ppcount.find(it->first) == global_ppcount.end()) {
-                        global_ppcount[key] = value;
-                    } else {
-                        global_ppcount[key].out_out += value.out_out;
-                        global_ppcount[key].out_in += value.out_in;
-                        global_ppcount[key].in_in += value.in_in;
-                        global_ppcount[key].in_out += value.in_out;
-                    }
-                }
-
-                //for type predicate
-                for (unordered_map<ssid_t, int>::iterator it = all_gather[i].type_to_subject.begin();
-                        it != all_gather[i].type_to_subject.end(); it++ ) {
-                    ssid_t key = it->first;
-                    int subject = it->second;
-                    if (global_tyscount.find(key) == global_tyscount.end()) {
-                        global_tyscount[key] = subject;
-                    } else {
-                        global_tyscount[key] += subject;
-                    }
-                }
-
-            }
+            for (int i = 0; i < all_gather.size(); i++)
+                merge_stat(all_gather[i]);
 
             logstream(LOG_INFO) << "global_ptcount size: " << global_ptcount.size() << LOG_endl;
             logstream(LOG_INFO) << "global_pscount size: " << global_pscount.size() << LOG_endl;
@@ -145,15 +189,7 @@ public:
             logstream(LOG_INFO) << "global_ppcount size: " << global_ppcount.size() << LOG_endl;
             logstream(LOG_INFO) << "global_tyscount size: " << global_tyscount.size() << LOG_endl;
 
-            // for type predicate
-            global_pocount[1] = global_tyscount.size();
-            int triple = 0;
-            for (unordered_map<ssid_t, int>::iterator it = global_tyscount.begin();
-                    it != global_tyscount.end(); it++ ) {
-                triple += it->second;
-            }
-            global_ptcount[1] = triple;
-
+            fix_type_stat();
         }
 
         send_stat_to_all_machines();
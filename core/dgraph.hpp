@@ -39,6 +39,7 @@
 #include "config.hpp"
 #include "type.hpp"
 #include "rdma.hpp"
+#include "sim.hpp"
 #include "gstore.hpp"
 #include "timer.hpp"
 #include "assertion.hpp"
@@ -133,8 +134,7 @@ class DGraph {
                             id2id[id] = str_server->next_index_id ++;
                         else
                             id2id[id] = str_server->next_normal_id ++;
-                        str_server->str2id[str] = id2id[id];
-                        str_server->id2str[id2id[id]] = str;
+                        str_server->add(str, id2id[id]);
                     }
                 }
                 file.close();
@@ -241,8 +241,8 @@ class DGraph {
             auto lambda = [&](istream & file) {
                 sid_t s, p, o;
                 while (file >> s >> p >> o) {
-                    int s_sid = mymath::hash_mod(s, global_num_servers);
-                    int o_sid = mymath::hash_mod(o, global_num_servers);
+                    int s_sid = vid2sid(s);
+                    int o_sid = vid2sid(o);
                     if (s_sid == o_sid) {
                         send_triple(localtid, s_sid, s, p, o);
                     } else {
@@ -285,7 +285,7 @@ class DGraph {
                 memcpy(mem->kvstore() + offset, (char*)buf, sizeof(uint64_t));
             }
         }
-        MPI_Barrier(MPI_COMM_WORLD);
+        server_barrier();
 
         return global_num_servers;
     }
@@ -308,8 +308,8 @@ class DGraph {
             auto lambda = [&](istream & file) {
                 sid_t s, p, o;
                 while (file >> s >> p >> o) {
-                    int s_sid = mymath::hash_mod(s, global_num_servers);
-                    int o_sid = mymath::hash_mod(o, global_num_servers);
+                    int s_sid = vid2sid(s);
+                    int o_sid = vid2sid(o);
                     if ((s_sid == sid) || (o_sid == sid)) {
                         ASSERT((n * 3 + 3) * sizeof(sid_t) <= kvs_sz);
                         // buffer the triple and update the counter
@@ -375,7 +375,7 @@ class DGraph {
                         logstream(LOG_ERROR) << "Unsupported value type" << LOG_endl;
                         break;
                     }
-                    if (sid == mymath::hash_mod(s, global_num_servers))
+                    if (sid == vid2sid(s))
                         triple_sav[localtid].push_back(triple_attr_t(s, a, v));
                 }
             };
@@ -429,12 +429,12 @@ class DGraph {
                     sid_t o = kvs[i * 3 + 2];
 
                     // out-edges
-                    if (mymath::hash_mod(s, global_num_servers) == sid)
+                    if (vid2sid(s) == sid)
                         if ((s % global_num_engines) == tid)
                             triple_spo[tid].push_back(triple_t(s, p, o));
 
                     // in-edges
-                    if (mymath::hash_mod(o, global_num_servers) == sid)
+                    if (vid2sid(o) == sid)
                         if ((o % global_num_engines) == tid)
                             triple_ops[tid].push_back(triple_t(s, p, o));
 
@@ -506,6 +506,45 @@ class DGraph {
         return original - original % n + n;
     }
 
+    // insert the aggregated triples and attributes into gstore (kvstore)
+    void init_gstore() {
+        uint64_t start, end;
+
+        gstore.refresh();
+
+        start = timer::get_usec();
+        #pragma omp parallel for num_threads(global_num_engines)
+        for (int t = 0; t < global_num_engines; t++) {
+            gstore.insert_normal(triple_spo[t], triple_ops[t], t);
+
+            // release memory
+            vector<triple_t>().swap(triple_spo[t]);
+            vector<triple_t>().swap(triple_ops[t]);
+        }
+        end = timer::get_usec();
+        logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << "ms "
+                            << "for inserting normal data into gstore" << LOG_endl;
+
+        start = timer::get_usec();
+        #pragma omp parallel for num_threads(global_num_engines)
+        for (int t = 0; t < global_num_engines; t++) {
+            gstore.insert_vertex_attr(triple_sav[t], t);
+            // release memory
+            vector<triple_attr_t>().swap(triple_sav[t]);
+        }
+        end = timer::get_usec();
+        logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << "ms "
+                            << "for inserting attributes into gstore" << LOG_endl;
+
+        start = timer::get_usec();
+        gstore.insert_index();
+        end = timer::get_usec();
+        logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << "ms "
+                            << "for inserting index data into gstore" << LOG_endl;
+
+        gstore.print_mem_usage();
+    }
+
 public:
     GStore gstore;
 
@@ -531,6 +570,9 @@ public:
                                 << ") at server " << sid << LOG_endl;
         }
 
+        // partition vertices over servers (see Partitioner)
+        Partitioner::get().init(dfiles, str_server->id2str.size());
+
         // load_data: load partial input files by each server and exchanges triples
         //            according to graph partitioning
         // load_data_from_allfiles: load all files by each server and select triples
@@ -569,41 +611,36 @@ public:
                             << "for loading attribute files" << LOG_endl;
 
         // initiate gstore (kvstore) after loading and exchanging triples (memory reused)
-        gstore.refresh();
+        init_gstore();
 
+        logstream(LOG_INFO) << "#" << sid << ": loading DGraph is finished" << LOG_endl;
+    }
 
-        start = timer::get_usec();
-        #pragma omp parallel for num_threads(global_num_engines)
-        for (int t = 0; t < global_num_engines; t++) {
-            gstore.insert_normal(triple_spo[t], triple_ops[t], t);
+    /**
+     * Build the graph from in-memory triples (e.g., synthetic data of benchmarks)
+     * w/o any files or communication. Only the triples belonging to this server are kept.
+     */
+    DGraph(int sid, Mem *mem, String_Server *str_server, vector<triple_t> &triples)
+        : sid(sid), str_server(str_server), mem(mem), gstore(sid, mem) {
+        num_triples.resize(global_num_servers);
 
-            // release memory
-            vector<triple_t>().swap(triple_spo[t]);
-            vector<triple_t>().swap(triple_ops[t]);
-        }
-        end = timer::get_usec();
-        logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << "ms "
-                            << "for inserting normal data into gstore" << LOG_endl;
+        triple_spo.resize(global_num_engines);
+        triple_ops.resize(global_num_engines);
+        triple_sav.resize(global_num_engines);
 
-        start = timer::get_usec();
-        #pragma omp parallel for num_threads(global_num_engines)
-        for (int t = 0; t < global_num_engines; t++) {
-            gstore.insert_vertex_attr(triple_sav[t], t);
-            // release memory
-            vector<triple_attr_t>().swap(triple_sav[t]);
+        // stage all triples as a single partition of the kvstore like loading files
+        ASSERT(sizeof(uint64_t) + triples.size() * 3 * sizeof(sid_t) <= mem->kvstore_size());
+        uint64_t *pn = (uint64_t *)mem->kvstore();
+        sid_t *kvs = (sid_t *)(pn + 1);
+        for (uint64_t i = 0; i < triples.size(); i++) {
+            kvs[i * 3 + 0] = triples[i].s;
+            kvs[i * 3 + 1] = triples[i].p;
+            kvs[i * 3 + 2] = triples[i].o;
         }
-        end = timer::get_usec();
-        logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << "ms "
-                            << "for inserting attributes into gstore" << LOG_endl;
-
-        start = timer::get_usec();
-        gstore.insert_index();
-        end = timer::get_usec();
-        logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << "ms "
-                            << "for inserting index data into gstore" << LOG_endl;
+        *pn = triples.size();
 
-        logstream(LOG_INFO) << "#" << sid << ": loading DGraph is finished" << LOG_endl;
-        gstore.print_mem_usage();
+        aggregate_data(1);
+        init_gstore();
     }
 
 
@@ -641,12 +678,12 @@ public:
                 /// FIXME: just check and print warning
                 check_sid(s); check_sid(p); check_sid(o);
 
-                if (sid == mymath::hash_mod(s, global_num_servers)) {
+                if (sid == vid2sid(s)) {
                     gstore.insert_triple_out(triple_t(s, p, o), check_dup);
                     cnt ++;
                 }
 
-                if (sid == mymath::hash_mod(o, global_num_servers)) {
+                if (sid == vid2sid(o)) {
                     gstore.insert_triple_in(triple_t(s, p, o), check_dup);
                     cnt ++;
                 }
@@ -698,7 +735,7 @@ public:
                     break;
                 }
 
-                if (sid == mymath::hash_mod(s, global_num_servers)) {
+                if (sid == vid2sid(s)) {
                     /// Support attribute files
                     // gstore.insert_triple_attribute(triple_sav_t(s, a, v));
                     cnt ++;
@@ -734,4 +771,22 @@ public:
     attr_t  get_vertex_attr_global(int tid, sid_t vid, dir_t d, sid_t pid, bool& has_value) {
         return gstore.get_vertex_attr_global(tid, vid, d, pid, has_value);
     }
+
+    void get_entry_usage(uint64_t &used, uint64_t &total) {
+        gstore.get_entry_usage(used, total);
+    }
+
+    Access_Stat &get_access_stat(int tid) {
+        return gstore.get_access_stat(tid);
+    }
+
+    void get_indirect_usage(uint64_t &used, uint64_t &total) {
+        gstore.get_indirect_usage(used, total);
+    }
+
+    uint64_t get_main_header_size() { return gstore.get_main_header_size(); }
+
+    uint64_t get_rdma_cache_size() { return gstore.get_rdma_cache_size(); }
+
+    Mem *get_mem() { return mem; }
 };
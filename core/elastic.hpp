@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "config.hpp"
+#include "timer.hpp"
+#include "unit.hpp"
+
+using namespace std;
+
+#define ELASTIC_EPOCH_MSEC 100   // the interval to adapt the number of active engines
+#define ELASTIC_HIGH_UTIL 800    // add an engine above 80% utilization (permille)
+#define ELASTIC_LOW_UTIL 500     // remove an engine if the rest stay below 50% utilization
+#define ELASTIC_DOWN_EPOCHS 10   // remove an engine after 10 epochs of low utilization
+#define ELASTIC_DORMANT_USEC 1000  // the interval of a dormant engine to check for wakeup
+
+/**
+ * The elastic engines of a server
+ *
+ * All engine threads are created at startup (so the RDMA buffers and rings in Mem
+ * are still valid for any engine), but only the first @nactive engines run queries.
+ * The rest become dormant once they are idle (no queued queries, pending messages
+ * or fork-join parents, see Engine::go_dormant), and sleep instead of busy polling.
+ *
+ * The mailbox of a dormant engine is drained by a buddy among the active engines
+ * (see buddy_of), which moves the drained queries into its runqueues every polling
+ * round and runs them as its own (see Engine::drain_dormant). The engines reserved
+ * for light queries (global_light_engines) are never dormant, and at least one
+ * engine is left for heavy queries.
+ *
+ * The number of active engines is set by the console ('engine -a'), or adapted to
+ * the utilization of the engines by the first engine of the server if
+ * global_enable_elastic_engines is set (see adapt).
+ */
+class Elastic_Engines {
+private:
+    uint64_t next_epoch = 0;  // the time (usec) to adapt
+    uint64_t last_busy = 0;   // the busy time of all engines at the last epoch
+    int nlow_epochs = 0;      // #epochs in a row with low utilization
+
+public:
+    volatile int nactive = 0;  // #active engines (0: all)
+
+    uint64_t nscale_ups = 0;    // #engines woken up by adapt
+    uint64_t nscale_downs = 0;  // #engines put to dormant by adapt
+
+    static int min_active() {
+        int light = global_enable_query_class ? global_light_engines : 0;
+        return min(light + 1, global_num_engines);
+    }
+
+    int active() { return nactive ? nactive : global_num_engines; }
+
+    // set the number of active engines, and return the actual one
+    int set_active(int n) {
+        nactive = max(min_active(), min(n, global_num_engines));
+        nlow_epochs = 0;
+        return nactive;
+    }
+
+    // whether the engine (index) @eid should be dormant
+    inline bool is_dormant(int eid) { return eid >= active(); }
+
+    // the active engine (index) to serve the mailbox of the dormant engine @eid
+    // (heavy queries may go to the mailbox, so the buddy is not a light engine)
+    int buddy_of(int eid) {
+        int n = active();
+        int lo = global_enable_query_class ? min(global_light_engines, n - 1) : 0;
+        return lo + (eid - lo) % (n - lo);
+    }
+
+    // adapt the number of active engines to @busy, the total busy time (usec) of
+    // all engines of the server, and @qlen, the total #queries waiting on them
+    // NOTE: only called by the first engine, which is never dormant
+    void adapt(uint64_t busy, uint64_t qlen) {
+        uint64_t now = timer::get_usec();
+        if (next_epoch == 0) {
+            next_epoch = now + MSEC(ELASTIC_EPOCH_MSEC);
+            last_busy = busy;
+            return;
+        }
+        if (now < next_epoch) return;
+
+        uint64_t period = now - next_epoch + MSEC(ELASTIC_EPOCH_MSEC);
+        uint64_t used = busy - last_busy;
+        next_epoch = now + MSEC(ELASTIC_EPOCH_MSEC);
+        last_busy = busy;
+
+        int n = active();
+        if (used * 1000 > ELASTIC_HIGH_UTIL * period * n || qlen > (uint64_t)n) {
+            // overloaded or queries are waiting
+            nlow_epochs = 0;
+            if (n < global_num_engines) {
+                nactive = n + 1;
+                nscale_ups++;
+            }
+        } else if (n > min_active()
+                   && used * 1000 < ELASTIC_LOW_UTIL * period * (n - 1)) {
+            // the rest engines can take over the load
+            if (++nlow_epochs >= ELASTIC_DOWN_EPOCHS) {
+                nlow_epochs = 0;
+                nactive = n - 1;
+                nscale_downs++;
+            }
+        } else {
+            nlow_epochs = 0;
+        }
+    }
+};
+
+// the elastic engines of each server (indexed by server ID)
+std::vector<Elastic_Engines> elastic_engines;
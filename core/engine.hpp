@@ -26,6 +26,8 @@
 #include <boost/unordered_map.hpp>
 #include <algorithm>//sort
 #include <regex>
+#include <new>
+#include <stdlib.h> // posix_memalign
 
 #include "config.hpp"
 #include "type.hpp"
@@ -33,10 +35,21 @@
 #include "adaptor.hpp"
 #include "dgraph.hpp"
 #include "query.hpp"
+#include "vector_pool.hpp"
 #include "assertion.hpp"
 
 #include "mymath.hpp"
+#include "simd_set.hpp"
 #include "timer.hpp"
+#include "unit.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "result_cache.hpp"
+#include "prefix_cache.hpp"
+#include "numa_replica.hpp"
+#include "hot_vertex.hpp"
+#include "load_board.hpp"
+#include "elastic.hpp"
 
 using namespace std;
 
@@ -46,6 +59,42 @@ using namespace std;
 
 #define QUERY_FROM_PROXY(tid) ((tid) < global_num_proxies)
 
+// at least one of HEAVY_QUERY_SHARE queries taken from the runqueues is heavy (if any)
+// to avoid starving heavy queries under a flood of light ones
+#define HEAVY_QUERY_SHARE 8
+
+// The runtime counters of an engine, which are only updated by the engine itself (w/o atomics)
+struct Engine_Stat {
+    uint64_t nqueries = 0;      // #(sub-)queries started
+    uint64_t nreplies = 0;      // #replies sent to parents
+    uint64_t nsteps = 0;        // #pattern steps
+    uint64_t nrows = 0;         // #rows produced by pattern steps
+    uint64_t nsteals = 0;       // #tasks stolen from the neighboring engine
+    uint64_t nforks = 0;        // #fork-join (incl. union, optional and bidirectional)
+    uint64_t nsubqueries = 0;   // #sub-queries forked
+    uint64_t nheavies = 0;      // #heavy (sub-)queries started
+    uint64_t nyields = 0;       // #times queries are parked (see Engine::should_yield)
+    uint64_t nresumes = 0;      // #parked queries resumed by the engine itself
+    uint64_t nparked_steals = 0;  // #parked queries resumed by the neighboring engine
+    uint64_t ndormants = 0;     // #times the engine becomes dormant (see elastic.hpp)
+    uint64_t ndrains = 0;       // #messages drained from the mailboxes of dormant engines
+
+    // the time (usec) of polling rounds with some work, and of sleeping as a dormant engine
+    uint64_t busy_usec = 0;
+    uint64_t dormant_usec = 0;
+
+    // gauges (sampled by the engine once per polling round)
+    uint64_t runqueue_len = 0;
+    uint64_t heavy_runqueue_len = 0;
+    uint64_t fastpath_len = 0;
+    uint64_t pending_msgs = 0;
+
+    // memory gauges (in bytes)
+    uint64_t runqueue_bytes = 0;  // results carried by the queries in the runqueue
+    uint64_t inflight_bytes = 0;  // results of the query being executed
+    uint64_t peak_bytes = 0;      // the maximum of inflight_bytes
+} __attribute__ ((aligned (WK_CLINE))); // avoid false sharing
+
 // The map is used to colloect the replies of sub-queries in fork-join execution
 class Reply_Map {
 private:
@@ -54,11 +103,18 @@ private:
         int cnt; // #sub-queries
         SPARQLQuery parent;
         SPARQLQuery reply;
+        uint64_t start_time; // for profiling the wait of fork-join
     };
 
     boost::unordered_map<int, Item> internal_map;
 
+    uint64_t bytes = 0; // the results held by pending parents and merged replies
+
 public:
+    uint64_t get_bytes() { return bytes; }
+
+    bool empty() { return internal_map.empty(); }
+
     void put_parent_request(SPARQLQuery &r, int cnt) {
         logstream(LOG_DEBUG) << "add pid=" << r.id << " and cnt=" << cnt << LOG_endl;
 
@@ -68,8 +124,10 @@ public:
         Item d;
         d.cnt = cnt;
         d.parent = r;
+        d.start_time = timer::get_usec();
 
         internal_map[r.id] = d;
+        bytes += r.result.get_bytes();
     }
 
     void put_reply(SPARQLQuery &r) {
@@ -81,6 +139,27 @@ public:
         SPARQLQuery::Result &part = r.result;
         d.cnt--;
 
+        d.reply.peak_bytes = max(d.reply.peak_bytes, r.peak_bytes);
+        bytes -= whole.get_bytes(); // re-counted after merging
+
+        // the steps of profiles are already in the whole query (see SPARQLQuery::step_base)
+        if (d.parent.profile)
+            d.reply.profiles.insert(d.reply.profiles.end(), r.profiles.begin(), r.profiles.end());
+
+        if (d.parent.state == SPARQLQuery::SQState::SQ_PATTERN && d.parent.meet_step > 0) {
+            // join two halves of a bidirectional query
+            if (d.cnt == 1) {
+                whole.nvars = part.nvars;
+                whole.append_result(part);
+            } else {
+                whole.merge_join(part);
+                whole.blind = d.parent.result.blind;
+            }
+            d.reply.pattern_step = d.parent.pattern_group.patterns.size();
+            bytes += whole.get_bytes();
+            return;
+        }
+
         if (d.parent.has_union())
             whole.merge_union(part);
         else
@@ -89,6 +168,7 @@ public:
         // keep inprogress
         if (d.parent.state == SPARQLQuery::SQState::SQ_PATTERN)
             d.reply.pattern_step = r.pattern_step;
+        bytes += whole.get_bytes();
     }
 
     bool is_ready(int pid) {
@@ -98,6 +178,8 @@ public:
     SPARQLQuery get_merged_reply(int pid) {
         SPARQLQuery r = internal_map[pid].parent;
         SPARQLQuery &reply = internal_map[pid].reply;
+        bytes -= r.result.get_bytes() + reply.result.get_bytes();
+        r.peak_bytes = max(r.peak_bytes, reply.peak_bytes);
 
         // copy the result
         // FIXME: implement copy construct of SPARQLQuery::Result
@@ -109,6 +191,18 @@ public:
         r.result.result_table.swap(reply.result.result_table);
         r.result.attr_res_table.swap(reply.result.attr_res_table);
 
+        if (r.profile) {
+            SPARQLQuery::Profile p;
+            p.qid = r.id;
+            p.pg_type = r.pg_type;
+            p.kind = SPARQLQuery::Profile::WAIT;
+            p.step = r.step_base + r.pattern_step;
+            p.time = timer::get_usec() - internal_map[pid].start_time;
+            p.out_rows = reply.result.row_num;
+            r.profiles.push_back(p);
+            r.profiles.insert(r.profiles.end(), reply.profiles.begin(), reply.profiles.end());
+        }
+
         // FIXME: need sync other fields or not
         if (r.state == SPARQLQuery::SQState::SQ_PATTERN)
             r.pattern_step = reply.pattern_step;
@@ -129,13 +223,16 @@ int64_t hash_pair(const int64_pair &x) {
     return hash<int64_t>()(r);
 }
 
-// a vector of pointers of all local engines
+// vectors of pointers of all local engines (indexed by server ID)
+// NOTE: a process only runs the engines of its own server, except for the simulation (see sim.hpp)
 class Engine;
-std::vector<Engine *> engines;
+std::vector<std::vector<Engine *>> engines;
 
 
 class Engine {
 private:
+    friend class Engine_Bench; // microbenchmarks of pattern operators (bench/wukong_bench.cpp)
+
     class Message {
     public:
         int sid;
@@ -150,11 +247,45 @@ private:
     std::vector<SPARQLQuery> msg_fast_path;
     std::vector<SPARQLQuery> runqueue;
 
+    // the two-class scheduling (global_enable_query_class): light queries are kept in
+    // runqueue, and heavy queries (incl. the parked ones) are kept in heavy_runqueue
+    std::vector<SPARQLQuery> heavy_runqueue;
+    pthread_spinlock_t runqueue_lock;  // protect both runqueues (stolen by the neighbor)
+    int nlight_picks = 0;  // #light queries taken in a row while heavy ones are waiting
+
+    // the messages (except queries) received while polling the queries (see poll_queries)
+    std::vector<Bundle> deferred_bundles;
+
     Reply_Map rmap; // a map of replies for pending (fork-join) queries
     pthread_spinlock_t rmap_lock;
 
     vector<Message> pending_msgs;
 
+    Trace_Buffer trace_buf; // span events of queries (only recorded by the engine itself)
+
+    Engine_Stat stat; // runtime counters
+
+    // recyclable buffers of intermediate results (only used by the engine itself)
+    Vector_Pool<sid_t> table_pool;
+    Vector_Pool<attr_t> attr_pool;
+    Vector_Pool<bool> rows_pool;
+
+    // replace @table with @updated, and put the old buffer back to the pool
+    inline void recycle_swap(vector<sid_t> &table, vector<sid_t> &updated) {
+        table.swap(updated);
+        table_pool.recycle(updated);
+    }
+
+    inline void recycle_swap(vector<attr_t> &table, vector<attr_t> &updated) {
+        table.swap(updated);
+        attr_pool.recycle(updated);
+    }
+
+    inline void recycle_swap(vector<bool> &rows, vector<bool> &updated) {
+        rows.swap(updated);
+        rows_pool.recycle(updated);
+    }
+
     inline void sweep_msgs() {
         if (!pending_msgs.size()) return;
 
@@ -176,6 +307,244 @@ private:
         return false;
     }
 
+    inline void count_fork(int nsubs) {
+        stat.nforks++;
+        stat.nsubqueries += nsubs;
+    }
+
+    /// TRACE: a span of query @r started at @begin (TSC, 0 if tracing was disabled)
+    inline void trace_span(int kind, SPARQLQuery &r, uint64_t begin, int step = -1) {
+        if (!global_enable_tracing || begin == 0) return;
+
+        Trace_Event e;
+        e.kind = kind;
+        e.qid = r.id;
+        e.pid = r.pid;
+        e.sid = sid;
+        e.tid = tid;
+        e.step = step;
+        // NOTE: only row_num is kept in blind mode or count-only execution
+        e.rows = max(r.result.row_num, (uint64_t)r.result.get_row_num());
+        e.ts = begin;
+        e.dur = timer::get_tsc() - begin;
+        trace_buf.push(e);
+    }
+
+    /// TRACE: query @r is put into the runqueue or sent to the engine (@dst_sid, @dst_tid)
+    inline void trace_send(int kind, SPARQLQuery &r, int dst_sid, int dst_tid) {
+        if (!global_enable_tracing) return;
+
+        Trace_Event e;
+        e.kind = kind;
+        e.qid = r.id;
+        e.pid = r.pid;
+        e.sid = sid;
+        e.tid = tid;
+        e.dst_sid = dst_sid;
+        e.dst_tid = dst_tid;
+        e.rows = max(r.result.row_num, (uint64_t)r.result.get_row_num());
+        e.ts = timer::get_tsc();
+        trace_buf.push(e);
+    }
+
+    // whether the engine is reserved for light queries (see global_light_engines)
+    inline bool is_light_engine() {
+        return global_enable_query_class && (tid - global_num_proxies) < global_light_engines;
+    }
+
+    // put a query into the runqueue of its class
+    void enqueue(SPARQLQuery &r) {
+        pthread_spin_lock(&runqueue_lock);
+        stat.runqueue_bytes += r.result.get_bytes();
+        if (global_enable_query_class && r.qclass == SPARQLQuery::SQ_HEAVY)
+            heavy_runqueue.push_back(std::move(r));
+        else
+            runqueue.push_back(std::move(r));
+        pthread_spin_unlock(&runqueue_lock);
+    }
+
+    // take a query from the runqueues, light queries first (see HEAVY_QUERY_SHARE)
+    bool dequeue(SPARQLQuery &r) {
+        pthread_spin_lock(&runqueue_lock);
+        bool heavy = !heavy_runqueue.empty()
+                     && (runqueue.empty() || nlight_picks >= HEAVY_QUERY_SHARE - 1);
+        std::vector<SPARQLQuery> &q = heavy ? heavy_runqueue : runqueue;
+        if (q.empty()) {
+            pthread_spin_unlock(&runqueue_lock);
+            return false;
+        }
+
+        nlight_picks = (heavy || heavy_runqueue.empty()) ? 0 : nlight_picks + 1;
+        r = std::move(q[0]);
+        q.erase(q.begin());
+        stat.runqueue_bytes -= r.result.get_bytes();
+        pthread_spin_unlock(&runqueue_lock);
+
+        if (r.id != -1 && r.state == SPARQLQuery::SQState::SQ_PATTERN)
+            stat.nresumes++; // a parked query
+        return true;
+    }
+
+    // whether any work is waiting for the engine (except heavy queries if @light_only)
+    bool has_waiting_work(bool light_only) {
+        if (!deferred_bundles.empty()) return true; // only used by the engine itself
+
+        pthread_spin_lock(&runqueue_lock);
+        bool waiting = !runqueue.empty() || (!light_only && !heavy_runqueue.empty());
+        pthread_spin_unlock(&runqueue_lock);
+        if (waiting) return true;
+
+        pthread_spin_lock(&recv_lock);
+        waiting = !msg_fast_path.empty();
+        pthread_spin_unlock(&recv_lock);
+        return waiting;
+    }
+
+    // whether the engine has nothing to resume (e.g., the replies to its pending parents)
+    bool is_idle() {
+        if (has_waiting_work(false) || !pending_msgs.empty())
+            return false;
+
+        pthread_spin_lock(&rmap_lock);
+        bool idle = rmap.empty();
+        pthread_spin_unlock(&rmap_lock);
+        return idle;
+    }
+
+    // sleep until the engine (index @own_id) is active again (see elastic.hpp),
+    // while its mailbox is drained by the buddy engine
+    void go_dormant(int own_id) {
+        engine_load_t *l = (engine_load_t *)graph->get_mem()->load_board(tid);
+        uint64_t last = timer::get_usec();
+
+        at_work = false; // no stealing from the dormant engine
+        l->dormant = 1;
+        pthread_spin_lock(&dormant_lock);
+        dormant = true;
+        pthread_spin_unlock(&dormant_lock);
+        stat.ndormants++;
+
+        while (elastic_engines[sid].is_dormant(own_id)) {
+            usleep(ELASTIC_DORMANT_USEC);
+            uint64_t now = timer::get_usec();
+            stat.dormant_usec += now - last;
+            last = now;
+        }
+
+        // the buddy may be taking a message from the mailbox
+        pthread_spin_lock(&dormant_lock);
+        dormant = false;
+        pthread_spin_unlock(&dormant_lock);
+        l->dormant = 0;
+
+        last_time = timer::get_usec();
+    }
+
+    // move the messages in the mailbox of the dormant engine @e into the runqueues of
+    // the engine, as poll_queries does, except that the replies to the parents on @e
+    // (see Reply_Map) are merged at once. Return true if any reply has been merged.
+    bool drain_dormant(Engine *e) {
+        if (!e->dormant || pthread_spin_trylock(&e->dormant_lock) != 0)
+            return false;
+
+        // take the messages w/o blocking the wakeup of @e for long
+        vector<Bundle> bundles;
+        Bundle bundle;
+        while (e->dormant && e->adaptor->tryrecv(bundle))
+            bundles.push_back(bundle);
+        pthread_spin_unlock(&e->dormant_lock);
+        stat.ndrains += bundles.size();
+
+        bool merged = false;
+        for (auto &b : bundles) {
+            if (b.type != SPARQL_QUERY) {
+                deferred_bundles.push_back(b);
+                continue;
+            }
+
+            SPARQLQuery r = b.get_sparql_query();
+            if (r.state == SPARQLQuery::SQState::SQ_REPLY) {
+                execute_sparql_query(r, e);
+                merged = true;
+            } else {
+                trace_send(Trace_Event::ENQUEUE, r, sid, tid);
+                enqueue(r);
+            }
+        }
+        return merged;
+    }
+
+    // move the queries arrived at the engine into the runqueues (w/o running them)
+    void poll_queries() {
+        Bundle bundle;
+        while (adaptor->tryrecv(bundle)) {
+            if (bundle.type == SPARQL_QUERY) {
+                SPARQLQuery r = bundle.get_sparql_query();
+                trace_send(Trace_Event::ENQUEUE, r, sid, tid);
+                enqueue(r);
+            } else {
+                deferred_bundles.push_back(bundle);
+            }
+        }
+    }
+
+    // whether the query should yield the engine at the boundary of its steps (cooperative preemption):
+    // 1) a heavy query yields if any other work (except heavy queries) is waiting;
+    // 2) a query yields if any work is waiting and it has run out of its time quantum
+    //    (global_query_quantum_us) or row budget (global_query_row_budget) since
+    //    @slice_begin (usec), where @slice_rows is the number of rows produced
+    bool should_yield(SPARQLQuery &r, uint64_t slice_begin, uint64_t slice_rows) {
+        bool heavy = global_enable_query_class && r.qclass == SPARQLQuery::SQ_HEAVY;
+        bool expired = (global_query_row_budget > 0 && slice_rows >= (uint64_t)global_query_row_budget)
+                       || (global_query_quantum_us > 0
+                           && timer::get_usec() - slice_begin >= global_query_quantum_us);
+        if (!heavy && !expired)
+            return false;
+
+        poll_queries();
+        return has_waiting_work(!expired);
+    }
+
+    // park a partially executed query (pattern_step and results) back into the runqueue
+    void park(SPARQLQuery &r) {
+        stat.nyields++;
+        trace_send(Trace_Event::YIELD, r, sid, tid);
+        enqueue(r);
+    }
+
+    // (neighbor) take a query waiting in the runqueues except the replies to be merged,
+    // and the heavy ones (e.g., parked) are preferred
+    bool steal_query(SPARQLQuery &r) {
+        bool success = false;
+        pthread_spin_lock(&runqueue_lock);
+        std::vector<SPARQLQuery> *queues[] = {&heavy_runqueue, &runqueue};
+        for (auto q : queues) {
+            for (auto it = q->begin(); it != q->end(); ++it) {
+                if (it->state == SPARQLQuery::SQState::SQ_REPLY)
+                    continue;
+                r = std::move(*it);
+                q->erase(it);
+                stat.runqueue_bytes -= r.result.get_bytes();
+                success = true;
+                break;
+            }
+            if (success) break;
+        }
+        pthread_spin_unlock(&runqueue_lock);
+        return success;
+    }
+
+    // the edges of index vertex @tpid, from the replica on the NUMANODE of the engine if any
+    // (@replica keeps the copy alive during the step, see Node_Replicas)
+    edge_t *get_index_edges(sid_t tpid, dir_t d, uint64_t *sz, std::shared_ptr<vector<edge_t>> &replica) {
+        if (sid < node_replicas.size() && node_replicas[sid] != NULL) {
+            replica = node_replicas[sid]->get_index_edges(tid, graph, tpid, d);
+            *sz = replica->size();
+            return replica->data();
+        }
+        return graph->get_index_edges_local(tid, tpid, d, sz);
+    }
+
     /// A query whose parent's PGType is UNION may call this pattern
     void index_to_known(SPARQLQuery &req) {
         SPARQLQuery::Pattern &pattern = req.get_pattern();
@@ -190,9 +559,12 @@ private:
         ASSERT(id01 == PREDICATE_ID || id01 == TYPE_ID); // predicate or type index
 
         vector<sid_t> updated_result_table;
+        if (req.pg_type != SPARQLQuery::PGType::OPTIONAL)
+            updated_result_table = table_pool.alloc(res.result_table.size());
 
         uint64_t sz = 0;
-        edge_t *edges = graph->get_index_edges_local(tid, tpid, d, &sz);
+        std::shared_ptr<vector<edge_t>> replica;
+        edge_t *edges = get_index_edges(tpid, d, &sz, replica);
         int start = req.tid % req.mt_factor;
         int length = sz / req.mt_factor;
 
@@ -222,7 +594,7 @@ private:
             }
         }
         if (req.pg_type != SPARQLQuery::PGType::OPTIONAL)
-            res.result_table.swap(updated_result_table);
+            recycle_swap(res.result_table, updated_result_table);
         req.pattern_step++;
     }
 
@@ -237,13 +609,14 @@ private:
         ASSERT(id01 == PREDICATE_ID || id01 == TYPE_ID); // predicate or type index
         ASSERT(res.get_col_num() == 0);
 
-        vector<sid_t> updated_result_table;
-
         uint64_t sz = 0;
-        edge_t *edges = graph->get_index_edges_local(tid, tpid, d, &sz);
+        std::shared_ptr<vector<edge_t>> replica;
+        edge_t *edges = get_index_edges(tpid, d, &sz, replica);
         int start = req.tid % req.mt_factor;
         int length = sz / req.mt_factor;
 
+        vector<sid_t> updated_result_table = table_pool.alloc(length + sz % req.mt_factor);
+
         // every thread takes a part of consecutive edges
         for (uint64_t k = start * length; k < (start + 1) * length; k++)
             updated_result_table.push_back(edges[k].val);
@@ -253,7 +626,7 @@ private:
             for (uint64_t k = (start + 1) * length; k < sz; k++)
                 updated_result_table.push_back(edges[k].val);
 
-        res.result_table.swap(updated_result_table);
+        recycle_swap(res.result_table, updated_result_table);
         res.set_col_num(1);
         res.add_var2col(var, 0);
         req.pattern_step++;
@@ -276,6 +649,9 @@ private:
         uint64_t sz = 0;
         edge_t *edges = graph->get_edges_global(tid, start, d, pid, &sz);
 
+        if (req.pg_type != SPARQLQuery::PGType::OPTIONAL)
+            updated_result_table = table_pool.alloc(res.result_table.size());
+
         boost::unordered_set<sid_t> unique_set;
         for (uint64_t k = 0; k < sz; k++)
             unique_set.insert(edges[k].val);
@@ -298,7 +674,7 @@ private:
                 if (unique_set.find(res.get_row_col(i, col)) != unique_set.end())
                     res.append_row_to(i, updated_result_table);
             }
-            res.result_table.swap(updated_result_table);
+            recycle_swap(res.result_table, updated_result_table);
         }
         req.pattern_step++;
     }
@@ -315,10 +691,11 @@ private:
         ASSERT(res.get_col_num() == 0);
         uint64_t sz = 0;
         edge_t *edges = graph->get_edges_global(tid, start, d, pid, &sz);
+        updated_result_table = table_pool.alloc(sz);
         for (uint64_t k = 0; k < sz; k++)
             updated_result_table.push_back(edges[k].val);
 
-        res.result_table.swap(updated_result_table);
+        recycle_swap(res.result_table, updated_result_table);
         res.add_var2col(end, res.get_col_num());
         res.set_col_num(res.get_col_num() + 1);
         req.pattern_step++;
@@ -350,12 +727,24 @@ private:
         }
 
         // update the result table and metadata
-        res.attr_res_table.swap(updated_attr_table);
+        recycle_swap(res.attr_res_table, updated_attr_table);
         res.add_var2col(end, 0, type);   //update the unknown_attr to known
         res.set_attr_col_num(1);
         req.pattern_step++;
     }
 
+    /// The new variable of the current step is never used afterwards, and the results
+    /// of the query are insensitive to its multiplicity (DISTINCT). Thus the step only
+    /// needs to check the existence of neighbors instead of expanding rows.
+    bool exists_only(SPARQLQuery &req, ssid_t var) {
+        int idx = - (var + 1);
+        return global_enable_dedup
+               && req.distinct
+               && req.pg_type != SPARQLQuery::PGType::OPTIONAL
+               && var < 0 && idx < req.var_last_step.size()
+               && req.var_last_step[idx] == req.pattern_step;
+    }
+
     void known_to_unknown(SPARQLQuery &req) {
         SPARQLQuery::Pattern &pattern = req.get_pattern();
         ssid_t start = pattern.subject;
@@ -363,15 +752,16 @@ private:
         dir_t d      = pattern.direction;
         ssid_t end   = pattern.object;
         SPARQLQuery::Result &res = req.result;
+        bool exists = exists_only(req, end);
 
-        std::vector<sid_t> updated_result_table;
-        updated_result_table.reserve(res.result_table.size());
+        std::vector<sid_t> updated_result_table = table_pool.alloc(res.result_table.size());
         vector<bool> updated_optional_matched_rows;
         if (req.pg_type == SPARQLQuery::PGType::OPTIONAL) {
-            updated_optional_matched_rows.reserve(res.optional_matched_rows.size());
+            updated_optional_matched_rows = rows_pool.alloc(res.optional_matched_rows.size());
         }
         std::vector<attr_t> updated_attr_table;
-        updated_attr_table.reserve(res.result_table.size());
+        if (global_enable_vattr)
+            updated_attr_table = attr_pool.alloc(res.attr_res_table.size());
 
         // simple dedup for consecutive same vertices
         sid_t cached = BLANK_ID;
@@ -404,6 +794,13 @@ private:
                     updated_result_table.push_back(BLANK_ID);
                     updated_optional_matched_rows.push_back(true);
                 }
+            } else if (exists) {
+                // keep the row once w/o the column of the dead variable
+                if (sz > 0) {
+                    res.append_row_to(i, updated_result_table);
+                    if (global_enable_vattr)
+                        res.append_attr_row_to(i, updated_attr_table);
+                }
             } else {
                 for (uint64_t k = 0; k < sz; k++) {
                     res.append_row_to(i, updated_result_table);
@@ -414,13 +811,15 @@ private:
                 }
             }
         }
-        res.result_table.swap(updated_result_table);
+        recycle_swap(res.result_table, updated_result_table);
         if (req.pg_type == SPARQLQuery::PGType::OPTIONAL)
-            res.optional_matched_rows.swap(updated_optional_matched_rows);
+            recycle_swap(res.optional_matched_rows, updated_optional_matched_rows);
         if (global_enable_vattr)
-            res.attr_res_table.swap(updated_attr_table);
-        res.add_var2col(end, res.get_col_num());
-        res.set_col_num(res.get_col_num() + 1);
+            recycle_swap(res.attr_res_table, updated_attr_table);
+        if (!exists) {
+            res.add_var2col(end, res.get_col_num());
+            res.set_col_num(res.get_col_num() + 1);
+        }
         req.pattern_step++;
     }
 
@@ -437,12 +836,12 @@ private:
 
         ASSERT(d == OUT); // attribute always uses OUT
 
-        std::vector<sid_t> updated_result_table;
+        std::vector<sid_t> updated_result_table = table_pool.alloc(res.result_table.size());
         std::vector<attr_t> updated_attr_table;
 
         // In most time, the size of attr_res_table table is equal to the size of result_table
         // reserve size of updated_result_table to the size of result_table
-        updated_attr_table.reserve(res.result_table.size());
+        updated_attr_table = attr_pool.alloc(res.result_table.size());
         int type = req.get_pattern(req.pattern_step).pred_type ;
         for (int i = 0; i < res.get_row_num(); i++) {
             sid_t prev_id = res.get_row_col(i, res.var2col(start));
@@ -457,8 +856,8 @@ private:
         }
 
         // update the result table, attr_res_table and metadata
-        res.result_table.swap(updated_result_table);
-        res.attr_res_table.swap(updated_attr_table);
+        recycle_swap(res.result_table, updated_result_table);
+        recycle_swap(res.attr_res_table, updated_attr_table);
         res.add_var2col(end, res.get_attr_col_num(), type); // update the unknown_attr to known
         res.set_attr_col_num(res.get_attr_col_num() + 1);
         req.pattern_step++;
@@ -479,6 +878,11 @@ private:
 
         vector<sid_t> updated_result_table;
         vector<attr_t> updated_attr_table;
+        if (req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
+            updated_result_table = table_pool.alloc(res.result_table.size());
+            if (global_enable_vattr)
+                updated_attr_table = attr_pool.alloc(res.attr_res_table.size());
+        }
 
         // simple dedup for consecutive same vertices
         sid_t cached = BLANK_ID;
@@ -492,32 +896,21 @@ private:
             }
 
             sid_t known = res.get_row_col(i, res.var2col(end));
+            bool matched = simd_set::contains((sid_t *)edges, sz, known);
             if (req.pg_type == SPARQLQuery::PGType::OPTIONAL) {
-                bool matched = false;
-                for (uint64_t k = 0; k < sz; k++) {
-                    if (edges[k].val == known) {
-                        matched = true;
-                        break;
-                    }
-                }
                 if (res.optional_matched_rows[i] && (!matched)) req.correct_optional_result(i);
                 res.optional_matched_rows[i] = (matched && res.optional_matched_rows[i]);
-            } else {
-                for (uint64_t k = 0; k < sz; k++) {
-                    if (edges[k].val == known) {
-                        // append a matched intermediate result
-                        res.append_row_to(i, updated_result_table);
-                        if (global_enable_vattr)
-                            res.append_attr_row_to(i, updated_attr_table);
-                        break;
-                    }
-                }
+            } else if (matched) {
+                // append a matched intermediate result
+                res.append_row_to(i, updated_result_table);
+                if (global_enable_vattr)
+                    res.append_attr_row_to(i, updated_attr_table);
             }
         }
         if (req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
-            res.result_table.swap(updated_result_table);
+            recycle_swap(res.result_table, updated_result_table);
             if (global_enable_vattr)
-                res.attr_res_table.swap(updated_attr_table);
+                recycle_swap(res.attr_res_table, updated_attr_table);
         }
         req.pattern_step++;
     }
@@ -537,6 +930,11 @@ private:
 
         vector<sid_t> updated_result_table;
         vector<attr_t> updated_attr_table;
+        if (req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
+            updated_result_table = table_pool.alloc(res.result_table.size());
+            if (global_enable_vattr)
+                updated_attr_table = attr_pool.alloc(res.attr_res_table.size());
+        }
 
         // simple dedup for consecutive same vertices
         sid_t cached = BLANK_ID;
@@ -550,17 +948,12 @@ private:
                 cached = cur;
                 edges = graph->get_edges_global(tid, cur, d, pid, &sz);
 
-                for (uint64_t k = 0; k < sz; k++) {
-                    if (edges[k].val == end) {
-                        // append a matched intermediate result
-                        exist = true;
-                        if (req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
-                            res.append_row_to(i, updated_result_table);
-                            if (global_enable_vattr)
-                                res.append_attr_row_to(i, updated_attr_table);
-                        }
-                        break;
-                    }
+                exist = simd_set::contains((sid_t *)edges, sz, (sid_t)end);
+                if (exist && req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
+                    // append a matched intermediate result
+                    res.append_row_to(i, updated_result_table);
+                    if (global_enable_vattr)
+                        res.append_attr_row_to(i, updated_attr_table);
                 }
                 if (req.pg_type == SPARQLQuery::PGType::OPTIONAL) {
                     if (res.optional_matched_rows[i] && (!exist)) req.correct_optional_result(i);
@@ -580,13 +973,38 @@ private:
 
         }
         if (req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
-            res.result_table.swap(updated_result_table);
+            recycle_swap(res.result_table, updated_result_table);
             if (global_enable_vattr)
-                res.attr_res_table.swap(updated_attr_table);
+                recycle_swap(res.attr_res_table, updated_attr_table);
         }
         req.pattern_step++;
     }
 
+    /// Copy the predicates of @vid (w/ direction @d) into a local buffer as a sorted set,
+    /// since the edges of a remote vertex will be overwritten by the next RDMA read.
+    void get_predicates(sid_t vid, dir_t d, vector<sid_t> &pids) {
+        uint64_t npids = 0;
+        edge_t *edges = graph->get_edges_global(tid, vid, d, PREDICATE_ID, &npids);
+        pids.resize(npids);
+        memcpy((char *)pids.data(), (char *)edges, npids * sizeof(edge_t));
+        pids.resize(simd_set::make_set(pids.data(), npids));
+    }
+
+    /// Candidates of ?P in "S ?P O" are the predicates of S that are also predicates of O
+    /// (w/ the opposite direction), so intersect both sets rather than enumerate all lists of S.
+    /// NOTE: type triples are not stored at the object side (i.e., type-index),
+    ///       so TYPE_ID is a candidate as long as S has it.
+    void match_predicates(vector<sid_t> &spids, vector<sid_t> &opids, vector<sid_t> &pids) {
+        pids.resize(min(spids.size(), opids.size()) + 1);
+        uint64_t n = simd_set::intersect(spids.data(), spids.size(),
+                                         opids.data(), opids.size(), pids.data());
+        pids.resize(n);
+
+        if (binary_search(spids.begin(), spids.end(), (sid_t)TYPE_ID)
+                && !binary_search(pids.begin(), pids.end(), (sid_t)TYPE_ID))
+            pids.insert(pids.begin(), (sid_t)TYPE_ID);
+    }
+
     /// C ?P ?X . (?P and ?X are UNKNOWN)
     /// e.g.,
     ///
@@ -600,25 +1018,20 @@ private:
 
         vector<sid_t> updated_result_table;
 
-        uint64_t npids = 0;
-        edge_t *pids = graph->get_edges_global(tid, start, d, PREDICATE_ID, &npids);
-
         // use a local buffer to store "known" predicates
-        edge_t *tpids = (edge_t *)malloc(npids * sizeof(edge_t));
-        memcpy((char *)tpids, (char *)pids, npids * sizeof(edge_t));
+        vector<sid_t> tpids;
+        get_predicates(start, d, tpids);
 
-        for (uint64_t p = 0; p < npids; p++) {
+        for (uint64_t p = 0; p < tpids.size(); p++) {
             uint64_t sz = 0;
-            edge_t *res = graph->get_edges_global(tid, start, d, tpids[p].val, &sz);
+            edge_t *res = graph->get_edges_global(tid, start, d, tpids[p], &sz);
             for (uint64_t k = 0; k < sz; k++) {
-                updated_result_table.push_back(tpids[p].val);
+                updated_result_table.push_back(tpids[p]);
                 updated_result_table.push_back(res[k].val);
             }
         }
 
-        free(tpids);
-
-        res.result_table.swap(updated_result_table);
+        recycle_swap(res.result_table, updated_result_table);
         res.set_col_num(2);
         res.add_var2col(pid, 0);
         res.add_var2col(end, 1);
@@ -636,31 +1049,26 @@ private:
         ssid_t end   = pattern.object;
         SPARQLQuery::Result &res = req.result;
 
-        vector<sid_t> updated_result_table;
+        vector<sid_t> updated_result_table = table_pool.alloc(res.result_table.size());
 
+        // use a local buffer (reused by all rows) to store "known" predicates
+        vector<sid_t> tpids;
         for (int i = 0; i < res.get_row_num(); i++) {
             sid_t cur = res.get_row_col(i, res.var2col(start));
-            uint64_t npids = 0;
-            edge_t *pids = graph->get_edges_global(tid, cur, d, PREDICATE_ID, &npids);
-
-            // use a local buffer to store "known" predicates
-            edge_t *tpids = (edge_t *)malloc(npids * sizeof(edge_t));
-            memcpy((char *)tpids, (char *)pids, npids * sizeof(edge_t));
+            get_predicates(cur, d, tpids);
 
-            for (uint64_t p = 0; p < npids; p++) {
+            for (uint64_t p = 0; p < tpids.size(); p++) {
                 uint64_t sz = 0;
-                edge_t *edges = graph->get_edges_global(tid, cur, d, tpids[p].val, &sz);
+                edge_t *edges = graph->get_edges_global(tid, cur, d, tpids[p], &sz);
                 for (uint64_t k = 0; k < sz; k++) {
                     res.append_row_to(i, updated_result_table);
-                    updated_result_table.push_back(tpids[p].val);
+                    updated_result_table.push_back(tpids[p]);
                     updated_result_table.push_back(edges[k].val);
                 }
             }
-
-            free(tpids);
         }
 
-        res.result_table.swap(updated_result_table);
+        recycle_swap(res.result_table, updated_result_table);
         res.add_var2col(pid, res.get_col_num());
         res.add_var2col(end, res.get_col_num() + 1);
         res.set_col_num(res.get_col_num() + 2);
@@ -679,33 +1087,28 @@ private:
         ssid_t end   = pattern.object;
         SPARQLQuery::Result &result = req.result;
 
-        vector<sid_t> updated_result_table;
+        vector<sid_t> updated_result_table = table_pool.alloc(result.result_table.size());
+
+        // the predicates of the constant are shared by all rows
+        vector<sid_t> epids, tpids, cpids;
+        get_predicates(end, (d == OUT) ? IN : OUT, epids);
 
         for (int i = 0; i < result.get_row_num(); i++) {
             sid_t prev_id = result.get_row_col(i, result.var2col(start));
-            uint64_t npids = 0;
-            edge_t *pids = graph->get_edges_global(tid, prev_id, d, PREDICATE_ID, &npids);
+            get_predicates(prev_id, d, tpids);
+            match_predicates(tpids, epids, cpids);
 
-            // use a local buffer to store "known" predicates
-            edge_t *tpids = (edge_t *)malloc(npids * sizeof(edge_t));
-            memcpy((char *)tpids, (char *)pids, npids * sizeof(edge_t));
-
-            for (uint64_t p = 0; p < npids; p++) {
+            for (uint64_t p = 0; p < cpids.size(); p++) {
                 uint64_t sz = 0;
-                edge_t *res = graph->get_edges_global(tid, prev_id, d, tpids[p].val, &sz);
-                for (uint64_t k = 0; k < sz; k++) {
-                    if (res[k].val == end) {
-                        result.append_row_to(i, updated_result_table);
-                        updated_result_table.push_back(tpids[p].val);
-                        break;
-                    }
+                edge_t *res = graph->get_edges_global(tid, prev_id, d, cpids[p], &sz);
+                if (simd_set::contains((sid_t *)res, sz, (sid_t)end)) {
+                    result.append_row_to(i, updated_result_table);
+                    updated_result_table.push_back(cpids[p]);
                 }
             }
-
-            free(tpids);
         }
 
-        result.result_table.swap(updated_result_table);
+        recycle_swap(result.result_table, updated_result_table);
         result.add_var2col(pid, result.get_col_num());
         result.set_col_num(result.get_col_num() + 1);
         req.pattern_step++;
@@ -726,27 +1129,19 @@ private:
         // the query plan is wrong
         ASSERT(result.get_col_num() == 0);
 
-        uint64_t npids = 0;
-        edge_t *pids = graph->get_edges_global(tid, start, d, PREDICATE_ID, &npids);
+        vector<sid_t> spids, epids, cpids;
+        get_predicates(start, d, spids);
+        get_predicates(end, (d == OUT) ? IN : OUT, epids);
+        match_predicates(spids, epids, cpids);
 
-        // use a local buffer to store "known" predicates
-        edge_t *tpids = (edge_t *)malloc(npids * sizeof(edge_t));
-        memcpy((char *)tpids, (char *)pids, npids * sizeof(edge_t));
-
-        for (uint64_t p = 0; p < npids; p++) {
+        for (uint64_t p = 0; p < cpids.size(); p++) {
             uint64_t sz = 0;
-            edge_t *res = graph->get_edges_global(tid, start, d, tpids[p].val, &sz);
-            for (uint64_t k = 0; k < sz; k++) {
-                if (res[k].val == end) {
-                    updated_result_table.push_back(tpids[p].val);
-                    break;
-                }
-            }
+            edge_t *res = graph->get_edges_global(tid, start, d, cpids[p], &sz);
+            if (simd_set::contains((sid_t *)res, sz, (sid_t)end))
+                updated_result_table.push_back(cpids[p]);
         }
 
-        free(tpids);
-
-        result.result_table.swap(updated_result_table);
+        recycle_swap(result.result_table, updated_result_table);
         result.set_col_num(1);
         result.add_var2col(pid, 0);
         req.pattern_step++;
@@ -769,6 +1164,12 @@ private:
             sub_reqs[i].fetch_step = req.fetch_step;
             sub_reqs[i].local_var = start;
             sub_reqs[i].priority = req.priority + 1;
+            sub_reqs[i].qclass = req.qclass;
+            sub_reqs[i].distinct = req.distinct;
+            sub_reqs[i].var_last_step = req.var_last_step;
+            sub_reqs[i].count_step = req.count_step;
+            sub_reqs[i].profile = req.profile;
+            sub_reqs[i].step_base = req.step_base;
 
             sub_reqs[i].result.col_num = req.result.col_num;
             sub_reqs[i].result.attr_col_num = req.result.attr_col_num;
@@ -778,9 +1179,20 @@ private:
         }
 
         // group intermediate results to servers
+        // (the rows of hot vertices replicated on this server stay here)
+        Hot_Vertices &hv = hot_vertices[sid];
+        bool has_replicas = hv.num_replicas() > 0;
+        uint64_t now = has_replicas ? timer::get_usec() : 0;
+        unordered_map<sid_t, bool> replicated; // looked up once per vertex
         for (int i = 0; i < req.result.get_row_num(); i++) {
-            int dst_sid = mymath::hash_mod(req.result.get_row_col(i, req.result.var2col(start)),
-                                           global_num_servers);
+            sid_t vid = req.result.get_row_col(i, req.result.var2col(start));
+            int dst_sid = vid2sid(vid);
+            if (dst_sid != sid && has_replicas) {
+                auto it = replicated.find(vid);
+                if (it == replicated.end())
+                    it = replicated.insert(make_pair(vid, hv.is_replica(vid, now))).first;
+                if (it->second) dst_sid = sid;
+            }
             req.result.append_row_to(i, sub_reqs[dst_sid].result.result_table);
             if (req.pg_type == SPARQLQuery::PGType::OPTIONAL)
                 sub_reqs[dst_sid].result.optional_matched_rows.push_back(req.result.optional_matched_rows[i]);
@@ -790,6 +1202,37 @@ private:
         return sub_reqs;
     }
 
+    // Forward a new query from a proxy, which starts from a hot vertex on this server,
+    // to a random server. Return true if the query has been forwarded.
+    // NOTE: a new query that starts from a remote vertex was forwarded by the owner
+    //       (or sent to the local replica by a proxy), so it (re)admits the replica.
+    bool forward_hot_query(SPARQLQuery &r) {
+        if (!Hot_Vertices::enabled()
+                || !QUERY_FROM_PROXY(coder.tid_of(r.pid))
+                || !r.has_pattern() || r.pattern_step != 0
+                || r.start_from_index())
+            return false;
+
+        ssid_t start = r.pattern_group.get_start();
+        if (!is_vid(start)) return false;
+
+        Hot_Vertices &hv = hot_vertices[sid];
+        if (vid2sid(start) != sid) {
+            hv.admit(start);
+            return false;
+        }
+
+        if (!hv.is_hot(start)) return false;
+
+        int dst_sid = coder.get_random() % global_num_servers;
+        if (dst_sid == sid) return false;
+
+        hv.count_forward();
+        Bundle bundle(r);
+        send_request(bundle, dst_sid, tid);
+        return true;
+    }
+
     // fork-join or in-place execution
     bool need_fork_join(SPARQLQuery &req) {
         // always need NOT fork-join when executing on single machine
@@ -880,7 +1323,7 @@ private:
         uint64_t t2 = timer::get_usec(); // time to run the sub-request
 
         uint64_t t3, t4;
-        vector<sid_t> updated_result_table;
+        vector<sid_t> updated_result_table = table_pool.alloc(req_result.result_table.size());
 
         if (sub_result.get_col_num() > 2) { // qsort
             mytuple::qsort_tuple(sub_result.get_col_num(), sub_result.result_table);
@@ -924,7 +1367,7 @@ private:
             logstream(LOG_DEBUG) << "Lookup " << (t4 - t3) << " us" << LOG_endl;
         }
 
-        req_result.result_table.swap(updated_result_table);
+        recycle_swap(req_result.result_table, updated_result_table);
         req.pattern_step = fetch_step;
     }
 
@@ -1281,13 +1724,13 @@ private:
             general_filter(filter, r.result, is_satisfy);
         }
 
-        vector<sid_t> new_table;
+        vector<sid_t> new_table = table_pool.alloc(r.result.result_table.size());
         for (int row = 0; row < r.result.get_row_num(); row ++) {
             if (is_satisfy[row]) {
                 r.result.append_row_to(row, new_table);
             }
         }
-        r.result.result_table.swap(new_table);
+        recycle_swap(r.result.result_table, new_table);
         r.result.row_num = r.result.get_row_num();
     }
 
@@ -1432,7 +1875,8 @@ out:
         int new_attr_col_num = attr_var.size();
 
         //update result table
-        vector<sid_t> new_result_table(new_row_num * new_col_num);
+        vector<sid_t> new_result_table = table_pool.alloc(new_row_num * new_col_num);
+        new_result_table.resize(new_row_num * new_col_num);
         for (int i = 0; i < new_row_num; i ++) {
             for (int j = 0; j < new_col_num; j++) {
                 int col = r.result.var2col(normal_var[j]);
@@ -1440,26 +1884,284 @@ out:
             }
         }
 
-        r.result.result_table.swap(new_result_table);
+        recycle_swap(r.result.result_table, new_result_table);
         r.result.col_num = new_col_num;
         r.result.row_num = r.result.get_row_num();
 
         //update attribute result table
-        vector<attr_t> new_attr_result_table(new_row_num * new_attr_col_num);
+        vector<attr_t> new_attr_result_table = attr_pool.alloc(new_row_num * new_attr_col_num);
+        new_attr_result_table.resize(new_row_num * new_attr_col_num);
         for (int i = 0; i < new_row_num; i ++) {
             for (int j = 0; j < new_attr_col_num; j++) {
                 int col = r.result.var2col(attr_var[j]);
                 new_attr_result_table[i * new_attr_col_num + j] = r.result.get_attr_row_col(i, col);
             }
         }
-        r.result.attr_res_table.swap(new_attr_result_table);
+        recycle_swap(r.result.attr_res_table, new_attr_result_table);
         r.result.attr_col_num = new_attr_col_num;
     }
 
+    /// Drop the columns of variables that are dead after the current step
+    /// (planned by SPARQLQuery::plan_var_lifetime), and then remove duplicate rows
+    /// on the live columns for DISTINCT queries, since later steps only see the live columns.
+    void prune_result(SPARQLQuery &r) {
+        SPARQLQuery::Result &res = r.result;
+        if (!global_enable_dedup
+                || r.var_last_step.empty()
+                || r.pg_type == SPARQLQuery::PGType::OPTIONAL
+                || res.get_col_num() <= 1)
+            return;
+
+        int col_num = res.get_col_num();
+        vector<bool> live(col_num, true);
+        vector<int> dead_idxs;
+        for (int idx = 0; idx < r.var_last_step.size() && idx < res.v2c_map.size(); idx++) {
+            if (res.v2c_map[idx] == NO_RESULT
+                    || ext2type(res.v2c_map[idx]) != SID_t
+                    || r.var_last_step[idx] >= r.pattern_step)
+                continue;
+
+            live[ext2col(res.v2c_map[idx])] = false;
+            dead_idxs.push_back(idx);
+        }
+        if (dead_idxs.empty()) return;
+
+        // keep (at least) one column to retain the number of rows
+        bool all_dead = (dead_idxs.size() == col_num);
+        if (all_dead) {
+            live[ext2col(res.v2c_map[dead_idxs.back()])] = true;
+            dead_idxs.pop_back();
+        }
+
+        // remap columns
+        vector<int> col_map(col_num, NO_RESULT); // idx: old col, value: new col
+        vector<int> live_cols;                   // old cols of live variables
+        for (int c = 0; c < col_num; c++) {
+            if (!live[c]) continue;
+            col_map[c] = live_cols.size();
+            live_cols.push_back(c);
+        }
+        int new_col_num = live_cols.size();
+
+        for (auto idx : dead_idxs)
+            res.v2c_map[idx] = NO_RESULT;
+        for (int idx = 0; idx < res.v2c_map.size(); idx++)
+            if (res.v2c_map[idx] != NO_RESULT && ext2type(res.v2c_map[idx]) == SID_t)
+                res.v2c_map[idx] = col2ext(col_map[ext2col(res.v2c_map[idx])], SID_t);
+
+        // compact the live columns of each row to the front of the table (in place),
+        // which never overwrites an unread cell since new_col_num < col_num
+        int row_num = res.get_row_num();
+        sid_t *table = res.result_table.data();
+        uint64_t k = 0;
+        for (int i = 0; i < row_num; i++) {
+            sid_t *row = table + (uint64_t)i * col_num;
+            for (auto c : live_cols)
+                table[k++] = row[c];
+        }
+        res.result_table.resize(k);
+        res.set_col_num(new_col_num);
+
+        // early deduplication (the attribute table is not deduplicated yet)
+        // NOTE: in blind mode, the final DISTINCT is skipped and each server only
+        //       deduplicates its own rows, so the #rows of a DISTINCT query is an
+        //       upper bound of the exact one and depends on the partitioning
+        if (r.distinct && !all_dead && res.get_attr_col_num() == 0) {
+            mytuple::sort_tuple(new_col_num, res.result_table);
+            mytuple::unique_tuple(new_col_num, res.result_table);
+        }
+    }
+
+    // the number of results expanded from @vid by the trailing patterns
+    uint64_t count_neighbors(SPARQLQuery &req, sid_t vid) {
+        uint64_t n = 1;
+        for (int step = req.count_step; step < req.pattern_group.patterns.size() && n > 0; step++) {
+            SPARQLQuery::Pattern &pattern = req.get_pattern(step);
+            uint64_t sz = 0;
+            graph->get_edges_global(tid, vid, pattern.direction, pattern.predicate, &sz);
+            n *= sz;
+        }
+        return n;
+    }
+
+    /// Count-only execution of the trailing patterns (planned by SPARQLQuery::plan_count_step)
+    /// in blind mode, which sums the sizes of neighbor lists instead of writing rows.
+    /// In fork-join mode, each sub-query counts its own partition and the counts are summed
+    /// by Reply_Map.
+    void count_patterns(SPARQLQuery &req) {
+        SPARQLQuery::Result &res = req.result;
+        ssid_t start = req.get_pattern().subject;
+
+        uint64_t count = 0;
+        if (start >= 0) {
+            ASSERT(res.get_col_num() == 0);
+            count = count_neighbors(req, start);
+        } else {
+            // simple dedup for consecutive same vertices
+            sid_t cached = BLANK_ID;
+            uint64_t n = 0;
+            int col = res.var2col(start);
+            for (int i = 0; i < res.get_row_num(); i++) {
+                sid_t cur = res.get_row_col(i, col);
+                if (cur != cached) {  // a new vertex
+                    cached = cur;
+                    n = count_neighbors(req, cur);
+                }
+                count += n;
+            }
+        }
+
+        res.row_num = count;
+        table_pool.recycle(res.result_table);
+        attr_pool.recycle(res.attr_res_table);
+        req.pattern_step = req.pattern_group.patterns.size();
+    }
+
+    /// Bidirectional exploration (planned by Planner::plan_meet)
+    /// Both halves of the chain are explored concurrently from their own constants
+    /// (on the servers owning the constants), and joined by Reply_Map on the shared variable.
+    void execute_meet(SPARQLQuery &r) {
+        count_fork(2);
+        rmap.put_parent_request(r, 2);
+        for (int i = 0; i < 2; i++) {
+            SPARQLQuery half;
+            half.inherit_meet(r, i);
+            int dst_sid = vid2sid(half.pattern_group.get_start());
+            trace_send(Trace_Event::SEND, r, dst_sid, tid);
+            if (dst_sid != sid) {
+                Bundle bundle(half);
+                send_request(bundle, dst_sid, tid);
+            } else {
+                pthread_spin_lock(&recv_lock);
+                msg_fast_path.push_back(half);
+                pthread_spin_unlock(&recv_lock);
+            }
+        }
+    }
+
+    /// PROFILE: the cost of a pattern step
+    void profile_begin(SPARQLQuery &r, SPARQLQuery::Profile &p) {
+        Access_Stat &stat = graph->get_access_stat(tid);
+        p.qid = r.id;
+        p.pg_type = r.pg_type;
+        p.step = r.step_base + r.pattern_step;
+        p.in_rows = r.result.get_row_num();
+        // take a snapshot of counters
+        p.local_fetches = stat.local_fetches;
+        p.remote_fetches = stat.remote_fetches;
+        p.cache_hits = stat.cache_hits;
+        p.remote_bytes = stat.remote_bytes;
+        p.time = timer::get_usec();
+    }
+
+    void profile_end(SPARQLQuery &r, SPARQLQuery::Profile &p) {
+        Access_Stat &stat = graph->get_access_stat(tid);
+        p.time = timer::get_usec() - p.time;
+        p.out_rows = r.result.get_row_num();
+        p.local_fetches = stat.local_fetches - p.local_fetches;
+        p.remote_fetches = stat.remote_fetches - p.remote_fetches;
+        p.cache_hits = stat.cache_hits - p.cache_hits;
+        p.remote_bytes = stat.remote_bytes - p.remote_bytes;
+        r.profiles.push_back(p);
+    }
+
+    uint64_t result_bytes(SPARQLQuery::Result &res) { return res.get_bytes(); }
+
+    // MEMORY: sample the footprint of the intermediate results of query @r
+    void account_result(SPARQLQuery &r) {
+        stat.inflight_bytes = r.result.get_bytes();
+        stat.peak_bytes = max(stat.peak_bytes, stat.inflight_bytes);
+        r.peak_bytes = max(r.peak_bytes, stat.inflight_bytes);
+    }
+
+    /// PREFIX: reuse the materialized prefix of queries (see Prefix_Cache)
+
+    // the number of patterns in the cacheable prefix of query @r, which starts from
+    // an index or a constant (e.g., ?X rdf:type ub:GraduateStudent), and is followed by
+    // the patterns only filtering the start variable (e.g., ?X ub:takesCourse <Course1>)
+    int prefix_length(SPARQLQuery &r) {
+        if (!Prefix_Cache::enabled() || sid >= prefix_caches.size()
+                || r.profile || r.pattern_step != 0
+                || r.pg_type != SPARQLQuery::PGType::BASIC
+                || r.result.get_col_num() != 0 || r.result.get_attr_col_num() != 0)
+            return 0;
+
+        // the steps which can't be skipped (see plan_count_step and do_corun)
+        int limit = r.pattern_group.patterns.size();
+        if (r.result.blind && r.count_step >= 0) limit = min(limit, r.count_step);
+        if (r.corun_enabled) limit = min(limit, r.corun_step - 1);
+        if (limit < 1) return 0;
+
+        SPARQLQuery::Pattern &first = r.get_pattern(0);
+        ssid_t var = first.object;
+        if (var >= 0 || first.predicate < 0 || first.pred_type > 0) return 0;
+        if (!r.start_from_index() && first.subject < 0) return 0;
+
+        // the filters fork the query w/o RDMA (see need_fork_join)
+        if (global_num_servers > 1 && !global_use_rdma) return 1;
+
+        int len = 1;
+        while (len < limit) {
+            SPARQLQuery::Pattern &p = r.get_pattern(len);
+            if (p.subject != var || p.predicate < 0 || p.object < 0 || p.pred_type > 0)
+                break;
+            len++;
+        }
+        return len;
+    }
+
+    // the key of the first @len patterns of query @r (w/o the name of the variable)
+    string prefix_key(SPARQLQuery &r, int len) {
+        string key;
+        auto append = [&key](int64_t v) { key.append((const char *)&v, sizeof(v)); };
+
+        // every sub-query of an index start only takes a part of the index
+        if (r.start_from_index()) {
+            append(r.mt_factor);
+            append(r.tid % r.mt_factor);
+        }
+        for (int i = 0; i < len; i++) {
+            SPARQLQuery::Pattern &p = r.get_pattern(i);
+            append(p.subject < 0 ? -1 : p.subject);
+            append(p.predicate);
+            append(p.direction);
+            append(p.object < 0 ? -1 : p.object);
+        }
+        return key;
+    }
+
+    // start query @r from the longest cached prefix (up to @len patterns),
+    // and return the number of skipped patterns
+    int lookup_prefix(SPARQLQuery &r, int len, uint64_t version) {
+        vector<sid_t> ids;
+        for (int l = len; l > 0; l--) {
+            if (!prefix_caches[sid].lookup(prefix_key(r, l), version, ids))
+                continue;
+
+            SPARQLQuery::Result &res = r.result;
+            recycle_swap(res.result_table, ids);
+            res.set_col_num(1);
+            res.add_var2col(r.get_pattern(0).object, 0);
+            if (r.start_from_index()) r.local_var = -1; // see index_to_unknown
+            r.pattern_step = l;
+            return l;
+        }
+        return 0;
+    }
+
     bool execute_patterns(SPARQLQuery &r) {
         logstream(LOG_DEBUG) << "[" << sid << "-" << tid << "]"
                              << " id=" << r.id << " pid=" << r.pid << LOG_endl;
 
+        // the time slice of the query (see should_yield)
+        uint64_t slice_begin = (global_query_quantum_us > 0) ? timer::get_usec() : 0;
+        uint64_t slice_rows = 0;
+
+        if (r.pattern_step == 0 && r.meet_step > 0) {
+            execute_meet(r);
+            return false;
+        }
+
         if (r.pattern_step == 0
                 && r.pattern_group.parallel == false
                 && r.start_from_index()
@@ -1467,7 +2169,17 @@ out:
             // The mt_factor can be set on proxy side before sending to engine,
             // but must smaller than global_mt_threshold (Default: mt_factor == 1)
             // Normally, we will NOT let global_mt_threshold == #engines, which will cause HANG
+            // heavy queries only run on the engines not reserved for light queries
+            int base = 0, nengines = global_num_engines;
+            if (global_enable_query_class && global_light_engines > 0
+                    && r.qclass == SPARQLQuery::SQ_HEAVY && !is_light_engine()) {
+                base = global_light_engines;
+                nengines = global_num_engines - global_light_engines;
+                r.mt_factor = min(r.mt_factor, nengines);
+            }
+
             int sub_reqs_size = global_num_servers * r.mt_factor;
+            count_fork(sub_reqs_size);
             rmap.put_parent_request(r, sub_reqs_size);
             SPARQLQuery sub_query = r;
             for (int i = 0; i < global_num_servers; i++) {
@@ -1476,11 +2188,13 @@ out:
                     sub_query.id = -1;
                     sub_query.pid = r.id;
                     // start from the next engine thread
-                    sub_query.tid = (tid + j + 1 - global_num_proxies) % global_num_engines
-                                    + global_num_proxies;
+                    sub_query.tid = (tid + j + 1 - global_num_proxies - base) % nengines
+                                    + global_num_proxies + base;
                     sub_query.mt_factor = r.mt_factor;
                     sub_query.pattern_group.parallel = true;
+                    sub_query.profiles.clear();
 
+                    trace_send(Trace_Event::SEND, r, i, sub_query.tid);
                     Bundle bundle(sub_query);
                     send_request(bundle, i, sub_query.tid);
                 }
@@ -1489,23 +2203,84 @@ out:
             return false;
         }
 
+        // the prefix (step 0 to prefix_len) to materialize if not cached
+        int prefix_len = prefix_length(r);
+        uint64_t version = 0;
+        if (prefix_len > 0) {
+            version = get_data_version(sid);
+            if (lookup_prefix(r, prefix_len, version) > 0) {
+                // still materialize the rest of the prefix (if any)
+                if (r.pattern_step == prefix_len) prefix_len = 0;
+                account_result(r);
+                if (r.done(SPARQLQuery::SQState::SQ_PATTERN)) {
+                    r.result.row_num = r.result.get_row_num();
+                    return true;
+                }
+            }
+        }
+
         do {
+            SPARQLQuery::Profile prof;
+            if (r.profile) profile_begin(r, prof);
+            int step = r.pattern_step;
+            uint64_t begin = global_enable_tracing ? timer::get_tsc() : 0;
+
+            // only count the results of the trailing patterns in blind mode
+            if (r.result.blind && r.pattern_step == r.count_step) {
+                count_patterns(r);
+                stat.nsteps++;
+                if (r.profile) {
+                    profile_end(r, prof);
+                    r.profiles.back().out_rows = r.result.row_num;
+                }
+                trace_span(Trace_Event::STEP, r, begin, step);
+                return true;
+            }
+
             execute_one_pattern(r);
 
             // co-run optimization
             if (r.corun_enabled && (r.pattern_step == r.corun_step))
                 do_corun(r);
 
-            if (r.done(SPARQLQuery::SQState::SQ_PATTERN)) {
+            // dead-column elimination and early deduplication
+            prune_result(r);
+            account_result(r);
+
+            if (r.profile) profile_end(r, prof);
+            trace_span(Trace_Event::STEP, r, begin, step);
+            stat.nsteps++;
+            stat.nrows += r.result.get_row_num();
+            slice_rows += r.result.get_row_num();
+
+            bool done = r.done(SPARQLQuery::SQState::SQ_PATTERN);
+            bool fork = !done && need_fork_join(r);
+            bool yield = !done && !fork && should_yield(r, slice_begin, slice_rows);
+
+            // materialize the prefix once it ends (or the query leaves the engine)
+            if (prefix_len > 0 && (r.pattern_step == prefix_len || done || fork || yield)) {
+                prefix_caches[sid].insert(prefix_key(r, r.pattern_step), version,
+                                          r.result.result_table);
+                prefix_len = 0;
+            }
+
+            if (done) {
                 // only send back row_num in blind mode
                 r.result.row_num = r.result.get_row_num();
                 return true;
             }
 
-            if (need_fork_join(r)) {
+            if (fork) {
                 vector<SPARQLQuery> sub_reqs = generate_sub_query(r);
+                if (r.profile) {
+                    for (int i = 0; i < sub_reqs.size(); i++)
+                        if (i != sid)
+                            r.profiles.back().shipped_bytes += result_bytes(sub_reqs[i].result);
+                }
+                count_fork(sub_reqs.size());
                 rmap.put_parent_request(r, sub_reqs.size());
                 for (int i = 0; i < sub_reqs.size(); i++) {
+                    trace_send(Trace_Event::SEND, r, i, tid);
                     if (i != sid) {
                         Bundle bundle(sub_reqs[i]);
                         send_request(bundle, i, tid);
@@ -1517,25 +2292,43 @@ out:
                 }
                 return false;
             }
+
+            // park the query at the boundary of steps, and resume it later
+            if (yield) {
+                park(r);
+                return false;
+            }
         } while (true);
     }
 
-    void execute_sparql_query(SPARQLQuery &r, Engine *engine) {
+    void run_sparql_query(SPARQLQuery &r, Engine *engine) {
+        // spread the queries on a hot vertex over its replicas (see hot_vertex.hpp)
+        if (r.id == -1 && forward_hot_query(r))
+            return;
+
         // encode the lineage of the query (server & thread)
-        if (r.id == -1) r.id = coder.get_and_inc_qid();
+        if (r.id == -1) {
+            r.id = coder.get_and_inc_qid();
+            stat.nqueries++;
+            if (r.qclass == SPARQLQuery::SQ_HEAVY) stat.nheavies++;
+        }
 
         if (r.state == SPARQLQuery::SQState::SQ_REPLY) {
+            uint64_t begin = global_enable_tracing ? timer::get_tsc() : 0;
             pthread_spin_lock(&engine->rmap_lock);
             engine->rmap.put_reply(r);
 
             if (!engine->rmap.is_ready(r.pid)) {
                 pthread_spin_unlock(&engine->rmap_lock);
+                trace_span(Trace_Event::MERGE, r, begin);
                 return; // not ready (waiting for the rest)
             }
 
             // all sub-queries have done, continue to execute
             r = engine->rmap.get_merged_reply(r.pid);
             pthread_spin_unlock(&engine->rmap_lock);
+            trace_span(Trace_Event::MERGE, r, begin);
+            account_result(r);
         }
 
         // 1. Pattern
@@ -1549,12 +2342,13 @@ out:
             r.state = SPARQLQuery::SQState::SQ_UNION;
             int size = r.pattern_group.unions.size();
             r.union_done = true;
+            count_fork(size);
             engine->rmap.put_parent_request(r, size);
             for (int i = 0; i < size; i++) {
                 SPARQLQuery union_req;
                 union_req.inherit_union(r, i);
-                int dst_sid = mymath::hash_mod(union_req.pattern_group.get_start(),
-                                               global_num_servers);
+                int dst_sid = vid2sid(union_req.pattern_group.get_start());
+                trace_send(Trace_Event::SEND, r, dst_sid, tid);
                 if (dst_sid != sid) {
                     Bundle bundle(union_req);
                     send_request(bundle, dst_sid, tid);
@@ -1576,8 +2370,10 @@ out:
             if (need_fork_join(optional_req)) {
                 optional_req.id = r.id;
                 vector<SPARQLQuery> sub_reqs = generate_sub_query(optional_req);
+                count_fork(sub_reqs.size());
                 rmap.put_parent_request(r, sub_reqs.size());
                 for (int i = 0; i < sub_reqs.size(); i++) {
+                    trace_send(Trace_Event::SEND, r, i, tid);
                     if (i != sid) {
                         Bundle bundle(sub_reqs[i]);
                         send_request(bundle, i, tid);
@@ -1588,9 +2384,10 @@ out:
                     }
                 }
             } else {
+                count_fork(1);
                 engine->rmap.put_parent_request(r, 1);
-                int dst_sid = mymath::hash_mod(optional_req.pattern_group.get_start(),
-                                               global_num_servers);
+                int dst_sid = vid2sid(optional_req.pattern_group.get_start());
+                trace_send(Trace_Event::SEND, r, dst_sid, tid);
                 if (dst_sid != sid) {
                     Bundle bundle(optional_req);
                     send_request(bundle, dst_sid, tid);
@@ -1618,16 +2415,42 @@ out:
         // 6. Reply
         r.shrink_query();
         r.state = SPARQLQuery::SQState::SQ_REPLY;
+        if (r.profile && !r.profiles.empty() && coder.sid_of(r.pid) != sid)
+            r.profiles.back().shipped_bytes += result_bytes(r.result);
+        trace_send(Trace_Event::REPLY, r, coder.sid_of(r.pid), coder.tid_of(r.pid));
+        stat.nreplies++;
         Bundle bundle(r);
         send_request(bundle, coder.sid_of(r.pid), coder.tid_of(r.pid));
+
+        // the results have been serialized into the bundle
+        table_pool.recycle(r.result.result_table);
+        attr_pool.recycle(r.result.attr_res_table);
+    }
+
+    void execute_sparql_query(SPARQLQuery &r, Engine *engine) {
+        uint64_t begin = global_enable_tracing ? timer::get_tsc() : 0;
+        run_sparql_query(r, engine);
+        trace_span(Trace_Event::START, r, begin);
+        stat.inflight_bytes = 0; // the results have been sent or parked
     }
 
 #ifdef DYNAMIC_GSTORE
     void execute_load_data(RDFLoad & r) {
+        if (r.publish) {
+            // invalidate the results (or replicas) read during the loading of any server
+            bump_data_version(sid);
+            Bundle bundle(r);
+            send_request(bundle, coder.sid_of(r.pid), coder.tid_of(r.pid));
+            return;
+        }
+
         // unbind the core from the thread in order to use openmpi to run multithreads
         cpu_set_t mask = unbind_to_core();
 
+        // invalidate the cached results of queries (incl. the ones running during loading)
+        bump_data_version(sid);
         r.load_ret = graph->dynamic_load_data(r.load_dname, r.check_dup);
+        bump_data_version(sid);
 
         //rebind the thread with the core
         bind_to_core(mask);
@@ -1675,19 +2498,137 @@ public:
     bool at_work; // whether engine is at work or not
     uint64_t last_time; // busy or not (work-oblige)
 
+    uint64_t round_start = 0; // the start time of the current polling round
+
+    // the engine is dormant (see elastic.hpp), and its mailbox is drained by another
+    // engine while holding dormant_lock
+    volatile bool dormant = false;
+    pthread_spinlock_t dormant_lock;
+
+    // the load published to proxies (see load_board.hpp)
+    uint64_t load_stamp = 0;  // the time of the last publish
+    uint64_t load_busy = 0;   // the busy time (stat.busy_usec) at the last publish
+
+    // publish the load of the engine every LOAD_PUBLISH_USEC
+    void publish_load() {
+        uint64_t now = timer::get_usec();
+        if (now - load_stamp < LOAD_PUBLISH_USEC) return;
+
+        engine_load_t *l = (engine_load_t *)graph->get_mem()->load_board(tid);
+        l->qlen = stat.runqueue_len + stat.heavy_runqueue_len + stat.fastpath_len
+                  + deferred_bundles.size();
+        l->busy = load_stamp ? ((stat.busy_usec - load_busy) * 1000 / (now - load_stamp)) : 0;
+        l->stamp = now;
+        load_stamp = now;
+        load_busy = stat.busy_usec;
+    }
+
+    // NOTE: new ignores the alignment of over-aligned members (e.g., stat) before C++17
+    static void *operator new(size_t sz) {
+        void *ptr = NULL;
+        if (posix_memalign(&ptr, WK_CLINE, sz) != 0)
+            throw std::bad_alloc();
+        return ptr;
+    }
+
+    static void operator delete(void *ptr) { free(ptr); }
+
     Engine(int sid, int tid, String_Server * str_server, DGraph * graph, Adaptor * adaptor)
-        : sid(sid), tid(tid), str_server(str_server), graph(graph), adaptor(adaptor),
-          coder(sid, tid), last_time(timer::get_usec()) {
+        : trace_buf(global_trace_buffer_size),
+          sid(sid), tid(tid), str_server(str_server), graph(graph), adaptor(adaptor),
+          coder(sid, tid), at_work(false), last_time(timer::get_usec()) {
         pthread_spin_init(&recv_lock, 0);
         pthread_spin_init(&rmap_lock, 0);
+        pthread_spin_init(&runqueue_lock, 0);
+        pthread_spin_init(&dormant_lock, 0);
+
+        Trace_Clock::get_clock(); // calibrate TSC (once)
+
+        uint64_t limit = MiB2B((uint64_t)global_result_pool_mb);
+        table_pool.set_limit(limit);
+        attr_pool.set_limit(limit);
+        rows_pool.set_limit(limit);
+    }
+
+    // add the counters of the engine to @m
+    void collect_metrics(Metrics &m) {
+        Access_Stat &as = graph->get_access_stat(tid);
+        struct {
+            const char *name;
+            int type;
+            uint64_t value;
+        } items[] = {
+            {"queries_total", Metrics::COUNTER, stat.nqueries},
+            {"replies_total", Metrics::COUNTER, stat.nreplies},
+            {"steps_total", Metrics::COUNTER, stat.nsteps},
+            {"rows_total", Metrics::COUNTER, stat.nrows},
+            {"steals_total", Metrics::COUNTER, stat.nsteals},
+            {"forks_total", Metrics::COUNTER, stat.nforks},
+            {"subqueries_total", Metrics::COUNTER, stat.nsubqueries},
+            {"heavy_queries_total", Metrics::COUNTER, stat.nheavies},
+            {"yields_total", Metrics::COUNTER, stat.nyields},
+            {"resumes_total", Metrics::COUNTER, stat.nresumes},
+            {"parked_steals_total", Metrics::COUNTER, stat.nparked_steals},
+            {"busy_usec_total", Metrics::COUNTER, stat.busy_usec},
+            {"dormant_usec_total", Metrics::COUNTER, stat.dormant_usec},
+            {"dormant_total", Metrics::COUNTER, stat.ndormants},
+            {"dormant_drains_total", Metrics::COUNTER, stat.ndrains},
+            {"runqueue_length", Metrics::GAUGE, stat.runqueue_len},
+            {"heavy_runqueue_length", Metrics::GAUGE, stat.heavy_runqueue_len},
+            {"fastpath_length", Metrics::GAUGE, stat.fastpath_len},
+            {"pending_msgs", Metrics::GAUGE, stat.pending_msgs},
+            {"send_msgs_total", Metrics::COUNTER, adaptor->send_msgs},
+            {"rdma_send_bytes_total", Metrics::COUNTER, adaptor->rdma_send_bytes},
+            {"tcp_send_bytes_total", Metrics::COUNTER, adaptor->tcp_send_bytes},
+            {"recv_msgs_total", Metrics::COUNTER, __atomic_load_n(&adaptor->recv_msgs, __ATOMIC_RELAXED)},
+            {"recv_bytes_total", Metrics::COUNTER, __atomic_load_n(&adaptor->recv_bytes, __ATOMIC_RELAXED)},
+            {"local_fetches_total", Metrics::COUNTER, as.local_fetches},
+            {"remote_fetches_total", Metrics::COUNTER, as.remote_fetches},
+            {"rdma_cache_hits_total", Metrics::COUNTER, as.cache_hits},
+            {"rdma_read_bytes_total", Metrics::COUNTER, as.remote_bytes},
+            {"result_pool_allocs_total", Metrics::COUNTER,
+             table_pool.stats.nallocs + attr_pool.stats.nallocs + rows_pool.stats.nallocs},
+            {"result_pool_reuses_total", Metrics::COUNTER,
+             table_pool.stats.nreuses + attr_pool.stats.nreuses + rows_pool.stats.nreuses},
+            {"result_pool_drops_total", Metrics::COUNTER,
+             table_pool.stats.ndrops + attr_pool.stats.ndrops + rows_pool.stats.ndrops},
+            {"result_pool_alloc_bytes_total", Metrics::COUNTER,
+             table_pool.stats.alloc_bytes + attr_pool.stats.alloc_bytes + rows_pool.stats.alloc_bytes},
+            {"result_pool_pooled_bytes", Metrics::GAUGE,
+             table_pool.stats.pooled_bytes + attr_pool.stats.pooled_bytes + rows_pool.stats.pooled_bytes},
+            {"mem_runqueue_bytes", Metrics::GAUGE, stat.runqueue_bytes},
+            {"mem_reply_map_bytes", Metrics::GAUGE, rmap.get_bytes()},
+            {"mem_inflight_result_bytes", Metrics::GAUGE, stat.inflight_bytes},
+            {"mem_peak_result_bytes", Metrics::GAUGE, stat.peak_bytes},
+        };
+
+        for (auto &i : items)
+            m.add(i.name, i.type, sid, tid, i.value);
     }
 
+    // TRACE: take out the events recorded since the last collection
+    // (in the wall-clock time of the server)
+    void collect_trace(vector<Trace_Event> &events) {
+        size_t n = events.size();
+        trace_buf.take(events);
+
+        Trace_Clock &clock = Trace_Clock::get_clock();
+        for (size_t i = n; i < events.size(); i++) {
+            events[i].dur = clock.cycles_to_nsec(events[i].dur);
+            events[i].ts = clock.to_nsec(events[i].ts);
+        }
+    }
+
+    // TRACE: drop the recorded events
+    void clear_trace() { trace_buf.clear(); }
+
     void run() {
         // NOTE: the 'tid' of engine is not start from 0,
         // which can not be used by engines[] directly
         int own_id = tid - global_num_proxies;
         // TODO: replace pair to ring
-        int nbr_id = (global_num_engines - 1) - own_id;
+        int nbr_id = get_engine_neighbor(own_id);
+        std::vector<Engine *> &engines = ::engines[sid];
 
         uint64_t snooze_interval = MIN_SNOOZE_TIME;
 
@@ -1699,11 +2640,48 @@ public:
         };
 
         while (true) {
+            // account the busy time of the last polling round
+            uint64_t now = timer::get_usec();
+            // NOTE: the stores are atomic as the first engine reads them to adapt elastic engines
+            if (at_work)
+                __atomic_store_n(&stat.busy_usec, stat.busy_usec + now - round_start, __ATOMIC_RELAXED);
+            round_start = now;
             at_work = false;
 
             // check and send pending messages first
             sweep_msgs();
 
+            pthread_spin_lock(&runqueue_lock);
+            __atomic_store_n(&stat.runqueue_len, runqueue.size(), __ATOMIC_RELAXED);
+            __atomic_store_n(&stat.heavy_runqueue_len, heavy_runqueue.size(), __ATOMIC_RELAXED);
+            pthread_spin_unlock(&runqueue_lock);
+            pthread_spin_lock(&recv_lock);
+            stat.fastpath_len = msg_fast_path.size();
+            pthread_spin_unlock(&recv_lock);
+            stat.pending_msgs = pending_msgs.size();
+
+            if (global_enable_load_routing)
+                publish_load();
+
+            // elastic engines: the first engine adapts #active engines of the server,
+            // and an inactive engine becomes dormant once it is idle
+            Elastic_Engines &elastic = elastic_engines[sid];
+            if (global_enable_elastic_engines && own_id == 0) {
+                uint64_t busy = 0, qlen = 0;
+                for (auto e : engines) {
+                    busy += __atomic_load_n(&e->stat.busy_usec, __ATOMIC_RELAXED);
+                    qlen += __atomic_load_n(&e->stat.runqueue_len, __ATOMIC_RELAXED)
+                            + __atomic_load_n(&e->stat.heavy_runqueue_len, __ATOMIC_RELAXED);
+                }
+                elastic.adapt(busy, qlen);
+            }
+
+            if (elastic.is_dormant(own_id) && is_idle()) {
+                go_dormant(own_id);
+                round_start = timer::get_usec();
+                continue;
+            }
+
             // fast path (priority)
             SPARQLQuery request; // FIXME: only sparql query use fast-path now
             pthread_spin_lock(&recv_lock);
@@ -1720,8 +2698,27 @@ public:
                 continue; // exhaust all queries
             }
 
+            // move the messages of dormant engines whose buddy is the engine into the runqueues
+            // before taking a new query, so they are scheduled along with its own ones
+            bool merged = false;
+            for (int i = elastic.active(); i < global_num_engines; i++)
+                if (elastic.buddy_of(i) == own_id)
+                    merged |= drain_dormant(engines[i]);
+            if (merged) {
+                reset_snooze(at_work, last_time);
+                continue;
+            }
+
             // normal path: own runqueue
             Bundle bundle;
+            if (!deferred_bundles.empty()) { // received while polling queries
+                bundle = deferred_bundles[0];
+                deferred_bundles.erase(deferred_bundles.begin());
+                reset_snooze(at_work, last_time);
+                execute(bundle, engines[own_id]);
+                continue;
+            }
+
             while (adaptor->tryrecv(bundle)) {
                 if (bundle.type == SPARQL_QUERY) {
                     // to be fair, engine will handle sub-queries priority
@@ -1733,7 +2730,8 @@ public:
                         break;
                     }
 
-                    runqueue.push_back(req);
+                    trace_send(Trace_Event::ENQUEUE, req, sid, tid);
+                    enqueue(req);
                 } else {
                     // FIXME: Jump a queue!
                     reset_snooze(at_work, last_time);
@@ -1742,24 +2740,34 @@ public:
                 }
             }
 
-            if (!at_work && runqueue.size() > 0) {
+            SPARQLQuery req;
+            if (!at_work && dequeue(req)) {
                 // get new task
-                SPARQLQuery req = runqueue[0];
-                runqueue.erase(runqueue.begin());
-
                 reset_snooze(at_work, last_time);
                 execute_sparql_query(req, engines[own_id]);
             }
 
             // normal path: neighboring runqueue
-            if (global_enable_workstealing)  { // work-oblige is enabled
+            // NOTE: the engines reserved for light queries never steal (maybe heavy) tasks
+            if (global_enable_workstealing && !is_light_engine())  { // work-oblige is enabled
                 // if neighboring engine is not self-sufficient, try to steal a task
-                // FIXME: only steal a task from normal runqueue (not incl. runqueue)
                 if (engines[nbr_id]->at_work // not snooze
-                        && ((timer::get_usec() - engines[nbr_id]->last_time) >= TIMEOUT_THRESHOLD)
-                        && engines[nbr_id]->adaptor->tryrecv(bundle)) { // FIXME: reuse bundle
-                    reset_snooze(at_work, last_time);
-                    execute(bundle, engines[nbr_id]);
+                        && ((timer::get_usec() - engines[nbr_id]->last_time) >= TIMEOUT_THRESHOLD)) {
+                    if (engines[nbr_id]->adaptor->tryrecv(bundle)) { // FIXME: reuse bundle
+                        stat.nsteals++;
+                        reset_snooze(at_work, last_time);
+                        execute(bundle, engines[nbr_id]);
+                    } else if (engines[nbr_id]->steal_query(req)) {
+                        // a parked query has no pending sub-queries (it is parked between steps),
+                        // so it is resumed as a query of this engine
+                        if (req.id != -1) {
+                            req.id = coder.get_and_inc_qid();
+                            stat.nparked_steals++;
+                        }
+                        stat.nsteals++;
+                        reset_snooze(at_work, last_time);
+                        execute_sparql_query(req, engines[own_id]);
+                    }
                 }
             }
 
@@ -1775,3 +2783,76 @@ public:
         }
     }
 };
+
+// the resident set size of the process (in bytes), 0 if unknown
+static uint64_t get_rss_bytes()
+{
+    uint64_t size = 0, resident = 0;
+    ifstream ifs("/proc/self/statm");
+    if (!(ifs >> size >> resident))
+        return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// collect the metrics of all local engines and the graph store of the server
+static void collect_server_metrics(int sid, Metrics &m)
+{
+    for (auto e : engines[sid])
+        e->collect_metrics(m);
+
+    if (!engines[sid].empty()) {
+        Engine *e = engines[sid][0];
+        uint64_t used, total;
+        e->graph->get_entry_usage(used, total);
+        m.add("gstore_entry_used_bytes", Metrics::GAUGE, sid, -1, used);
+        m.add("gstore_entry_total_bytes", Metrics::GAUGE, sid, -1, total);
+
+        // MEMORY: the registered memory (kvstore | rdma-buffer | ring-buffer)
+        Mem *mem = e->graph->get_mem();
+        m.add("mem_kvstore_bytes", Metrics::GAUGE, sid, -1, mem->kvstore_size());
+        m.add("mem_rdma_buffer_bytes", Metrics::GAUGE, sid, -1,
+              mem->memory_size() - mem->kvstore_size());
+
+        e->graph->get_indirect_usage(used, total);
+        m.add("gstore_main_header_bytes", Metrics::GAUGE, sid, -1, e->graph->get_main_header_size());
+        m.add("gstore_indirect_used_bytes", Metrics::GAUGE, sid, -1, used);
+        m.add("gstore_indirect_total_bytes", Metrics::GAUGE, sid, -1, total);
+        m.add("gstore_rdma_cache_bytes", Metrics::GAUGE, sid, -1, e->graph->get_rdma_cache_size());
+        m.add("mem_string_server_bytes", Metrics::GAUGE, sid, -1, e->str_server->memory_usage());
+    }
+    m.add("mem_partition_map_bytes", Metrics::GAUGE, sid, -1, Partitioner::get().memory_usage());
+
+    if (sid < node_replicas.size() && node_replicas[sid] != NULL)
+        m.add("mem_numa_replica_bytes", Metrics::GAUGE, sid, -1, node_replicas[sid]->memory_usage());
+
+    if (Prefix_Cache::enabled() && sid < prefix_caches.size()) {
+        Prefix_Cache &pc = prefix_caches[sid];
+        m.add("prefix_cache_lookups_total", Metrics::COUNTER, sid, -1, pc.stats.nlookups);
+        m.add("prefix_cache_hits_total", Metrics::COUNTER, sid, -1, pc.stats.nhits);
+        m.add("prefix_cache_stales_total", Metrics::COUNTER, sid, -1, pc.stats.nstales);
+        m.add("prefix_cache_evictions_total", Metrics::COUNTER, sid, -1, pc.stats.nevictions);
+        m.add("prefix_cache_entries", Metrics::GAUGE, sid, -1, pc.size());
+        m.add("mem_prefix_cache_bytes", Metrics::GAUGE, sid, -1, pc.memory_usage());
+    }
+
+    if (Hot_Vertices::enabled() && sid < hot_vertices.size()) {
+        Hot_Vertices &hv = hot_vertices[sid];
+        m.add("hot_vertex_forwards_total", Metrics::COUNTER, sid, -1, hv.stats.nforwards);
+        m.add("hot_replica_hits_total", Metrics::COUNTER, sid, -1, hv.stats.nhits);
+        m.add("hot_replica_pulls_total", Metrics::COUNTER, sid, -1, hv.stats.npulls);
+        m.add("hot_replica_stales_total", Metrics::COUNTER, sid, -1, hv.stats.nstales);
+        m.add("hot_vertices", Metrics::GAUGE, sid, -1, hv.num_hot());
+        m.add("hot_replicas", Metrics::GAUGE, sid, -1, hv.num_replicas());
+        m.add("mem_hot_replica_bytes", Metrics::GAUGE, sid, -1, hv.memory_usage());
+    }
+
+    if (sid < elastic_engines.size()) {
+        Elastic_Engines &ee = elastic_engines[sid];
+        m.add("active_engines", Metrics::GAUGE, sid, -1, ee.active());
+        m.add("engine_scale_ups_total", Metrics::COUNTER, sid, -1, ee.nscale_ups);
+        m.add("engine_scale_downs_total", Metrics::COUNTER, sid, -1, ee.nscale_downs);
+    }
+
+    // NOTE: all simulated servers share a process (see sim.hpp)
+    m.add("mem_process_rss_bytes", Metrics::GAUGE, sid, -1, get_rss_bytes());
+}
@@ -23,6 +23,7 @@
 #pragma once
 
 #include <stdint.h> // uint64_t
+#include <stdlib.h> // posix_memalign
 #include <vector>
 #include <queue>
 #include <iostream>
@@ -35,6 +36,8 @@
 #include "rdma.hpp"
 #include "data_statistic.hpp"
 #include "type.hpp"
+#include "partitioner.hpp"
+#include "hot_vertex.hpp"
 #include "buddy_malloc.hpp"
 
 #include "mymath.hpp"
@@ -44,17 +47,6 @@
 
 using namespace std;
 
-enum { NBITS_DIR = 1 };
-enum { NBITS_IDX = 17 }; // equal to the size of t/pid
-enum { NBITS_VID = (64 - NBITS_IDX - NBITS_DIR) }; // 0: index vertex, ID: normal vertex
-
-// reserve two special index IDs (predicate and type)
-enum { PREDICATE_ID = 0, TYPE_ID = 1 };
-
-static inline bool is_tpid(ssid_t id) { return (id > 1) && (id < (1 << NBITS_IDX)); }
-
-static inline bool is_vid(ssid_t id) { return id >= (1 << NBITS_IDX); }
-
 /**
  * predicate-base key/value store
  * key: vid | t/pid | direction
@@ -141,6 +133,14 @@ struct edge_t {
     }
 };
 
+// the counters of data accesses by each engine (e.g., for query profiling)
+struct Access_Stat {
+    uint64_t local_fetches = 0;   // #edge lists (or attributes) read locally
+    uint64_t remote_fetches = 0;  // #edge lists (or attributes) read remotely
+    uint64_t cache_hits = 0;      // #remote vertices found in RDMA_Cache
+    uint64_t remote_bytes = 0;    // bytes read by RDMA
+} __attribute__ ((aligned (64))); // avoid false sharing
+
 /**
  * Map the Graph model (e.g., vertex, edge, index) to KVS model (e.g., key, value)
  */
@@ -251,6 +251,8 @@ private:
     int sid;
     Mem *mem;
 
+    Access_Stat *access_stats; // per-thread
+
     vertex_t *vertices;
     uint64_t num_slots;       // 1 bucket = ASSOCIATIVITY slots
     uint64_t num_buckets;     // main-header region (static)
@@ -592,12 +594,13 @@ done:
 
         RDMA &rdma = RDMA::get_rdma();
         rdma.dev->RdmaRead(tid, dst_sid, buf, r_sz, r_off);
+        access_stats[tid].remote_bytes += r_sz;
         return (edge_t *)buf;
     }
 
     // Get remote vertex of given key. This func will fail if RDMA is disabled.
     vertex_t get_vertex_remote(int tid, ikey_t key) {
-        int dst_sid = mymath::hash_mod(key.vid, global_num_servers);
+        int dst_sid = vid2sid(key.vid);
         uint64_t bucket_id = key.hash() % num_buckets;
         vertex_t vert;
 
@@ -606,8 +609,10 @@ done:
         ASSERT(global_use_rdma);
 
         // check cache
-        if (rdma_cache.lookup(key, vert))
+        if (rdma_cache.lookup(key, vert)) {
+            access_stats[tid].cache_hits++;
             return vert;
+        }
 
         // get vertex by RDMA
         char *buf = mem->buffer(tid);
@@ -619,6 +624,7 @@ done:
 
             RDMA &rdma = RDMA::get_rdma();
             rdma.dev->RdmaRead(tid, dst_sid, buf, sz, off);
+            access_stats[tid].remote_bytes += sz;
             vertex_t *verts = (vertex_t *)buf;
             for (int i = 0; i < ASSOCIATIVITY; i++) {
                 if (i < ASSOCIATIVITY - 1) {
@@ -639,6 +645,9 @@ done:
 
     // Get local vertex of given key.
     vertex_t get_vertex_local(int tid, ikey_t key) {
+        if (key.vid != 0 && Hot_Vertices::enabled())
+            hot_vertices[sid].sample(tid, key.vid);
+
         uint64_t bucket_id = key.hash() % num_buckets;
         while (true) {
             for (int i = 0; i < ASSOCIATIVITY; i++) {
@@ -663,7 +672,7 @@ done:
     // Get remote edges according to given vid, dir, pid.
     // @sz: size of return edges
     edge_t *get_edges_remote(int tid, sid_t vid, dir_t d, sid_t pid, uint64_t *sz) {
-        int dst_sid = mymath::hash_mod(vid, global_num_servers);
+        int dst_sid = vid2sid(vid);
         ikey_t key = ikey_t(vid, pid, d);
         edge_t *edge_ptr;
         vertex_t v = get_vertex_remote(tid, key);
@@ -705,7 +714,7 @@ done:
     // get the attribute value from remote
     attr_t get_vertex_attr_remote(int tid, sid_t vid, dir_t d, sid_t pid, bool &has_value) {
         //struct the key
-        int dst_sid = mymath::hash_mod(vid, global_num_servers);
+        int dst_sid = vid2sid(vid);
         ikey_t key = ikey_t(vid, pid, d);
         edge_t *edge_ptr;
         vertex_t v;
@@ -854,6 +863,16 @@ public:
         pthread_spin_init(&entry_lock, 0);
 #endif
 
+        // NOTE: new ignores the alignment of over-aligned types before C++17
+        void *stats_buf = NULL;
+        if (posix_memalign(&stats_buf, 64, sizeof(Access_Stat) * global_num_threads) != 0) {
+            logstream(LOG_ERROR) << "Failed to allocate access stats" << LOG_endl;
+            ASSERT(false);
+        }
+        access_stats = (Access_Stat *)stats_buf;
+        for (int i = 0; i < global_num_threads; i++)
+            new (&access_stats[i]) Access_Stat();
+
         logstream(LOG_INFO) << "gstore = " << mem->kvstore_size() << " bytes " << LOG_endl;
         logstream(LOG_INFO) << "      header region: " << num_slots << " slots" << " (main = " << num_buckets << ", indirect = " << num_buckets_ext << ")" << LOG_endl;
         logstream(LOG_INFO) << "      entry region: " << num_entries << " entries" << LOG_endl;
@@ -1550,17 +1569,36 @@ public:
 
     // FIXME: refine parameters with vertex_t
     edge_t *get_edges_global(int tid, sid_t vid, dir_t d, sid_t pid, uint64_t *sz) {
-        if (mymath::hash_mod(vid, global_num_servers) == sid)
+        if (vid2sid(vid) == sid) {
+            access_stats[tid].local_fetches++;
             return get_edges_local(tid, vid, d, pid, sz);
-        else
-            return get_edges_remote(tid, vid, d, pid, sz);
+        }
+
+        // read the replica of a hot vertex (see hot_vertex.hpp)
+        Hot_Vertices &hv = hot_vertices[sid];
+        uint64_t version = get_data_version(sid);
+        edge_t *buf = (edge_t *)mem->buffer(tid);
+        int rep = hv.lookup(vid, d, pid, version, (sid_t *)buf, sz);
+        if (rep == Hot_Vertices::REPLICA_HIT) {
+            access_stats[tid].local_fetches++;
+            return buf;
+        }
+
+        access_stats[tid].remote_fetches++;
+        edge_t *edge_ptr = get_edges_remote(tid, vid, d, pid, sz);
+        if (rep == Hot_Vertices::REPLICA_MISS)
+            hv.insert(vid, d, pid, version, (sid_t *)edge_ptr, *sz);
+        return edge_ptr;
     }
 
     edge_t *get_index_edges_local(int tid, sid_t pid, dir_t d, uint64_t *sz) {
+        access_stats[tid].local_fetches++;
         // the vid of index vertex should be 0
         return get_edges_local(tid, 0, d, pid, sz);
     }
 
+    Access_Stat &get_access_stat(int tid) { return access_stats[tid]; }
+
     // insert vertex attributes
     void insert_vertex_attr(vector<triple_attr_t> &attrs, int64_t tid) {
         for (auto const &attr : attrs) {
@@ -1596,10 +1634,13 @@ public:
     // return the attr result
     // if not found has_value will be set to false
     attr_t get_vertex_attr_global(int tid, sid_t vid, dir_t d, sid_t pid, bool &has_value) {
-        if (sid == mymath::hash_mod(vid, global_num_servers))
+        if (sid == vid2sid(vid)) {
+            access_stats[tid].local_fetches++;
             return get_vertex_attr_local(tid, vid, d, pid, has_value);
-        else
+        } else {
+            access_stats[tid].remote_fetches++;
             return get_vertex_attr_remote(tid, vid, d, pid, has_value);
+        }
     }
 
     // prepare data for planner
@@ -1722,6 +1763,38 @@ public:
         logstream(LOG_INFO) << "#" << sid << ": generating stats is finished." << LOG_endl;
     }
 
+    // the used and total size (bytes) of the entry region
+    void get_entry_usage(uint64_t &used, uint64_t &total) {
+        total = num_entries * sizeof(edge_t);
+#ifdef DYNAMIC_GSTORE
+        used = edge_allocator->get_used_size();
+#else
+        used = last_entry * sizeof(edge_t);
+#endif
+    }
+
+    // the used and total data slots of the main-header region (i.e., the load factor)
+    void get_header_usage(uint64_t &used, uint64_t &total) {
+        used = 0;
+        total = num_buckets * (ASSOCIATIVITY - 1);
+        for (uint64_t x = 0; x < num_buckets; x++) {
+            uint64_t slot_id = x * ASSOCIATIVITY;
+            for (int y = 0; y < ASSOCIATIVITY - 1; y++, slot_id++)
+                if (!vertices[slot_id].key.is_empty())
+                    used++;
+        }
+    }
+
+    // the used and total bytes of the indirect-header region (w/o scanning)
+    void get_indirect_usage(uint64_t &used, uint64_t &total) {
+        used = last_ext * ASSOCIATIVITY * sizeof(vertex_t);
+        total = num_buckets_ext * ASSOCIATIVITY * sizeof(vertex_t);
+    }
+
+    // the bytes of the main-header region and the RDMA cache (fixed at startup)
+    uint64_t get_main_header_size() { return num_buckets * ASSOCIATIVITY * sizeof(vertex_t); }
+    uint64_t get_rdma_cache_size() { return sizeof(RDMA_Cache); }
+
     // analysis and debuging
     void print_mem_usage() {
         uint64_t used_slots = 0;
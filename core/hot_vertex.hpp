@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "config.hpp"
+#include "type.hpp"
+#include "timer.hpp"
+#include "unit.hpp"
+#include "result_cache.hpp"
+
+using namespace std;
+
+#define HOT_SAMPLE_RATE 16      // sample one of 16 accesses by a thread (randomly)
+#define HOT_SAMPLE_MAX 4096     // the max #vertices counted by a thread in an epoch
+#define HOT_SAMPLE_PROBES 8     // the max #slots probed to count a sampled vertex
+#define HOT_EPOCH_MSEC 100      // the interval to find out hot vertices
+#define HOT_MAX_VERTICES 64     // the max #hot vertices (or replicas) on a server
+#define HOT_REPLICA_EPOCHS 10   // a replica expires w/o queries in 10 epochs
+
+/**
+ * The detection and the replication of hot vertices on a server for skewed workloads
+ *
+ * Detection (on the owner): GStore::get_vertex_local samples the accesses of each
+ * thread and counts them by vertex. At the end of an epoch, the vertices sampled
+ * at least global_hot_vertex_threshold times become the hot vertices of the next
+ * epoch.
+ *
+ * Replication (on the other servers): the owner forwards a new query that starts
+ * from a hot vertex to a random server (see Engine::forward_hot_query), which
+ * admits the vertex as a replica. The edge lists of a replica are pulled from
+ * the owner by RDMA on demand (see GStore::get_edges_global) and never written,
+ * and then the proxies (Proxy::send_request) and the fork-join (generate_sub_query)
+ * of the server use the replica instead of the owner. A replica expires if no
+ * query comes in HOT_REPLICA_EPOCHS epochs, and its edge lists are tagged by the
+ * data version (see result_cache.hpp), so they are pulled again after a dynamic load.
+ *
+ * The replicas are read by all engines of the server, so a lookup only copies the
+ * (shared) edge list under the lock and fills the buffer of the thread out of it,
+ * and the membership of replicas (is_replica) is read w/o lock from a fixed array.
+ */
+class Hot_Vertices {
+private:
+    // a slot of samplers packs the vertex ID and its count (0: free)
+    enum { COUNT_BITS = 64 - NBITS_VID };
+    static const uint64_t COUNT_MASK = (1ULL << COUNT_BITS) - 1;
+
+    // the sampled accesses of a thread in the current epoch, counted in an open-addressing
+    // table w/o lock (only fold() may drain the slots concurrently)
+    struct Sampler {
+        unsigned int seed;  // random sampling (no aliasing with the accesses of queries)
+        vector<uint64_t> slots;
+
+        Sampler() : seed(0), slots(HOT_SAMPLE_MAX, 0) { }
+    } __attribute__ ((aligned (64))); // avoid false sharing
+
+    typedef std::shared_ptr<const vector<sid_t>> ids_t;
+
+    struct Edges {
+        uint64_t version;
+        ids_t ids;  // the old list is freed after its last reader
+    };
+
+    struct Replica {
+        int slot;         // the slot in members
+        uint64_t bytes = 0;
+        unordered_map<uint64_t, Edges> edges;  // (predicate | direction) -> edges
+    };
+
+    // the replicated vertices (0: free) and the time (usec) to drop them, read w/o lock
+    // NOTE: the expiration is written before the vertex and read after it
+    struct Member {
+        sid_t vid = 0;
+        uint64_t expire = 0;
+    };
+
+    vector<Sampler> samplers;  // per-thread
+    uint64_t next_epoch = 0;   // the time (usec) to fold the samples
+
+    pthread_spinlock_t lock;   // protects hot and replicas
+    unordered_set<sid_t> hot;
+    unordered_map<sid_t, Replica> replicas;
+    Member members[HOT_MAX_VERTICES];
+    uint64_t nreplicas = 0;    // #replicas (a hint w/o lock)
+    uint64_t bytes = 0;
+
+    static uint64_t edges_key(dir_t d, sid_t pid) { return ((uint64_t)pid << 1) | d; }
+
+    uint64_t expire_of(const Replica &r) { return members[r.slot].expire; }
+
+    void erase(unordered_map<sid_t, Replica>::iterator it) {
+        bytes -= it->second.bytes;
+        __atomic_store_n(&members[it->second.slot].vid, 0, __ATOMIC_RELEASE);
+        replicas.erase(it);
+        nreplicas = replicas.size();
+    }
+
+    // fold the samples of all threads into the hot vertices (once an epoch)
+    void fold() {
+        uint64_t now = timer::get_usec();
+        uint64_t next = next_epoch;
+        if (now < next || !__sync_bool_compare_and_swap(&next_epoch, next, now + MSEC(HOT_EPOCH_MSEC)))
+            return;
+
+        unordered_map<sid_t, uint64_t> counts;
+        for (auto &s : samplers) {
+            for (auto &slot : s.slots) {
+                if (__atomic_load_n(&slot, __ATOMIC_RELAXED) == 0) continue;
+                uint64_t v = __atomic_exchange_n(&slot, 0, __ATOMIC_RELAXED);
+                if (v != 0) counts[v >> COUNT_BITS] += v & COUNT_MASK;
+            }
+        }
+
+        vector<pair<uint64_t, sid_t>> cands;
+        for (auto const &c : counts)
+            if (c.second >= (uint64_t)global_hot_vertex_threshold)
+                cands.push_back(make_pair(c.second, c.first));
+        int n = min((int)cands.size(), HOT_MAX_VERTICES);
+        partial_sort(cands.begin(), cands.begin() + n, cands.end(),
+                     greater<pair<uint64_t, sid_t>>());
+
+        pthread_spin_lock(&lock);
+        hot.clear();
+        for (int i = 0; i < n; i++)
+            hot.insert(cands[i].second);
+        pthread_spin_unlock(&lock);
+    }
+
+public:
+    enum { NO_REPLICA = 0, REPLICA_MISS, REPLICA_HIT };
+
+    struct Stats {
+        uint64_t nforwards = 0;  // #queries forwarded by the owner
+        uint64_t nhits = 0;      // #edge lists read from replicas
+        uint64_t npulls = 0;     // #edge lists pulled from the owners
+        uint64_t nstales = 0;    // #edge lists invalidated by dynamic loads
+    } stats;
+
+    Hot_Vertices() : samplers(global_num_threads) {
+        pthread_spin_init(&lock, 0);
+        for (int tid = 0; tid < samplers.size(); tid++)
+            samplers[tid].seed = tid + 1; // threads sample independently
+    }
+
+    // replicas are pulled by RDMA, and there is no other server to spread the load
+    static bool enabled() {
+        return global_hot_vertex_threshold > 0 && global_use_rdma && global_num_servers > 1;
+    }
+
+    /// detection (on the owner)
+
+    inline void sample(int tid, sid_t vid) {
+        Sampler &s = samplers[tid];
+        if (rand_r(&s.seed) % HOT_SAMPLE_RATE != 0) return;
+
+        // the CAS only races with fold() draining the slot
+        uint64_t h = ((uint64_t)vid * 0x9E3779B97F4A7C15ULL) >> 32;
+        for (int i = 0; i < HOT_SAMPLE_PROBES; i++) {
+            uint64_t *slot = &s.slots[(h + i) % HOT_SAMPLE_MAX];
+            uint64_t old = __atomic_load_n(slot, __ATOMIC_RELAXED);
+            while (old == 0 || (old >> COUNT_BITS) == vid) {
+                uint64_t cnt = old & COUNT_MASK;
+                if (cnt == COUNT_MASK) return; // saturated
+                uint64_t val = ((uint64_t)vid << COUNT_BITS) | (cnt + 1);
+                if (__atomic_compare_exchange_n(slot, &old, val, false,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    return;
+            }
+        }
+        // drop the sample if the probed slots are taken by other vertices
+    }
+
+    bool is_hot(sid_t vid) {
+        fold();
+
+        pthread_spin_lock(&lock);
+        bool found = hot.find(vid) != hot.end();
+        pthread_spin_unlock(&lock);
+        return found;
+    }
+
+    void count_forward() { __sync_fetch_and_add(&stats.nforwards, 1); }
+
+    /// replication (on the other servers)
+
+    // admit (or renew) the replica of @vid
+    void admit(sid_t vid) {
+        uint64_t now = timer::get_usec();
+        uint64_t expire = now + MSEC(HOT_EPOCH_MSEC) * HOT_REPLICA_EPOCHS;
+
+        pthread_spin_lock(&lock);
+        auto it = replicas.find(vid);
+        if (it != replicas.end()) {
+            __atomic_store_n(&members[it->second.slot].expire, expire, __ATOMIC_RELAXED);
+            pthread_spin_unlock(&lock);
+            return;
+        }
+
+        // drop expired replicas to make room
+        if (replicas.size() >= HOT_MAX_VERTICES) {
+            for (auto r = replicas.begin(); r != replicas.end();) {
+                auto cur = r++;
+                if (expire_of(cur->second) <= now)
+                    erase(cur);
+            }
+        }
+
+        if (replicas.size() < HOT_MAX_VERTICES) {
+            int slot = 0;
+            while (members[slot].vid != 0) slot++;  // a free slot must exist
+            __atomic_store_n(&members[slot].expire, expire, __ATOMIC_RELAXED);
+            __atomic_store_n(&members[slot].vid, vid, __ATOMIC_RELEASE);
+            replicas[vid].slot = slot;
+            nreplicas = replicas.size();
+        }
+        pthread_spin_unlock(&lock);
+    }
+
+    // whether @vid is replicated on the server (w/o lock)
+    bool is_replica(sid_t vid, uint64_t now = timer::get_usec()) {
+        if (nreplicas == 0) return false;
+
+        for (int i = 0; i < HOT_MAX_VERTICES; i++)
+            if (__atomic_load_n(&members[i].vid, __ATOMIC_ACQUIRE) == vid)
+                return __atomic_load_n(&members[i].expire, __ATOMIC_RELAXED) > now;
+        return false;
+    }
+
+    // copy the edges of the replica to @buf if they are valid on the data @version
+    int lookup(sid_t vid, dir_t d, sid_t pid, uint64_t version, sid_t *buf, uint64_t *sz) {
+        if (nreplicas == 0) return NO_REPLICA;
+
+        pthread_spin_lock(&lock);
+        auto it = replicas.find(vid);
+        if (it == replicas.end()) {
+            pthread_spin_unlock(&lock);
+            return NO_REPLICA;
+        }
+
+        if (expire_of(it->second) <= timer::get_usec()) {
+            erase(it);
+            pthread_spin_unlock(&lock);
+            return NO_REPLICA;
+        }
+
+        Replica &r = it->second;
+        auto e = r.edges.find(edges_key(d, pid));
+        if (e == r.edges.end()) {
+            pthread_spin_unlock(&lock);
+            return REPLICA_MISS;
+        }
+
+        if (e->second.version != version) { // stale
+            stats.nstales++;
+            uint64_t sz = e->second.ids->size() * sizeof(sid_t);
+            r.bytes -= sz;
+            bytes -= sz;
+            r.edges.erase(e);
+            pthread_spin_unlock(&lock);
+            return REPLICA_MISS;
+        }
+
+        ids_t ids = e->second.ids;
+        pthread_spin_unlock(&lock);
+
+        // copy the edges out of the lock
+        __sync_fetch_and_add(&stats.nhits, 1);
+        *sz = ids->size();
+        memcpy(buf, ids->data(), *sz * sizeof(sid_t));
+        return REPLICA_HIT;
+    }
+
+    // fill the replica of @vid with the edges pulled from the owner on the data @version
+    void insert(sid_t vid, dir_t d, sid_t pid, uint64_t version, const sid_t *ids, uint64_t sz) {
+        uint64_t budget = MiB2B((uint64_t)global_hot_replica_mb);
+        ids_t copy = std::make_shared<const vector<sid_t>>(ids, ids + sz);
+
+        pthread_spin_lock(&lock);
+        auto it = replicas.find(vid);
+        if (it == replicas.end()
+                || bytes + sz * sizeof(sid_t) > budget) { // dropped or no room
+            pthread_spin_unlock(&lock);
+            return;
+        }
+
+        stats.npulls++;
+        Edges &e = it->second.edges[edges_key(d, pid)];
+        if (e.ids) {
+            it->second.bytes -= e.ids->size() * sizeof(sid_t);
+            bytes -= e.ids->size() * sizeof(sid_t);
+        }
+        e.version = version;
+        e.ids = copy;
+        it->second.bytes += sz * sizeof(sid_t);
+        bytes += sz * sizeof(sid_t);
+        pthread_spin_unlock(&lock);
+    }
+
+    uint64_t num_hot() { return hot.size(); }
+
+    uint64_t num_replicas() { return nreplicas; }
+
+    uint64_t memory_usage() { return bytes; }
+};
+
+// the hot vertices and the replicas of each server (indexed by server ID)
+std::vector<Hot_Vertices> hot_vertices;
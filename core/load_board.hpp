@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "config.hpp"
+#include "coder.hpp"
+#include "mem.hpp"
+#include "rdma.hpp"
+#include "timer.hpp"
+
+using namespace std;
+
+#define LOAD_PUBLISH_USEC 100   // the interval of an engine to publish its load
+#define LOAD_REFRESH_USEC 200   // the interval of a proxy to read the loads of a server
+
+// the load of an engine (a slot of the load board in Mem)
+struct engine_load_t {
+    uint64_t qlen;   // #queries waiting on the engine
+    uint64_t busy;   // the busy time in the last interval (permille)
+    uint64_t stamp;  // the (local) time of the update (usec)
+    uint64_t dormant;  // the engine is dormant (see elastic.hpp)
+};
+
+/**
+ * The view of a proxy on the loads of engines for load-aware routing
+ *
+ * Each engine publishes the length of its queues and its busy time to its slot
+ * of the load board, which is in the registered memory of its server (see Mem),
+ * every LOAD_PUBLISH_USEC (see Engine::publish_load). A proxy reads the slots of
+ * all engines of a server (one RDMA read for a remote server) at most every
+ * LOAD_REFRESH_USEC, and counts the queries it sends to an engine until the next
+ * read. An engine whose slot is not updated since the last read is running a long
+ * query, and it is taken as one more query in its queue.
+ *
+ * A query goes to the less loaded one of two random engines of the server (power
+ * of two choices), which avoids all proxies rushing to the same engine based on
+ * a stale view. A dormant engine is the most loaded one, since its queries are
+ * run by another engine. W/o RDMA, a proxy has no view of remote servers, and the
+ * queries to them go to random engines (see has_view).
+ */
+class Load_View {
+private:
+    struct board_t {
+        uint64_t last = 0;  // the time (usec) of the last read
+        vector<engine_load_t> loads;
+        vector<bool> stalls;
+    };
+
+    int sid;
+    int tid;
+    Mem *mem;
+    vector<board_t> boards;  // per server
+
+    void refresh(int dst_sid, board_t &b) {
+        uint64_t now = timer::get_usec();
+        if (now - b.last < LOAD_REFRESH_USEC) return;
+
+        uint64_t sz = mem->load_board_size() * global_num_engines;
+        char *buf;
+        if (dst_sid == sid) {
+            buf = mem->load_board(global_num_proxies);
+        } else {
+            buf = mem->load_scratch(tid); // not the rdma-buffer (a message may be in it)
+            RDMA &rdma = RDMA::get_rdma();
+            rdma.dev->RdmaRead(tid, dst_sid, buf, sz, mem->load_board_offset(global_num_proxies));
+        }
+
+        for (int i = 0; i < global_num_engines; i++) {
+            engine_load_t l = *(engine_load_t *)(buf + mem->load_board_size() * i);
+            b.stalls[i] = (b.last != 0 && l.stamp == b.loads[i].stamp);
+            b.loads[i] = l;
+        }
+        b.last = now;
+        nrefreshes++;
+    }
+
+    uint64_t score(board_t &b, int i) {
+        if (b.loads[i].dormant) return UINT64_MAX;
+        return (b.loads[i].qlen + (b.stalls[i] ? 1 : 0)) * 1000 + b.loads[i].busy;
+    }
+
+public:
+    uint64_t nrefreshes = 0;  // #reads of load boards
+
+    Load_View(int sid, int tid, Mem *mem) : sid(sid), tid(tid), mem(mem) {
+        boards.resize(global_num_servers);
+        for (auto &b : boards) {
+            b.loads.resize(global_num_engines, engine_load_t());
+            b.stalls.resize(global_num_engines, false);
+        }
+    }
+
+    // whether the loads of server @dst_sid are visible (a remote one is read by RDMA),
+    // and the queries to a server w/o view go to random engines (w/o choose and account)
+    bool has_view(int dst_sid) { return dst_sid == sid || global_use_rdma; }
+
+    // choose the engine (thread ID) in [@base, @base + @range) of server @dst_sid
+    int choose(int dst_sid, int base, int range, Coder &coder) {
+        int e1 = base + coder.get_random() % range;
+        if (range == 1) return e1;
+
+        int e2 = base + (e1 - base + 1 + coder.get_random() % (range - 1)) % range; // e2 != e1
+        board_t &b = boards[dst_sid];
+        refresh(dst_sid, b);
+        int i1 = e1 - global_num_proxies, i2 = e2 - global_num_proxies;
+        return score(b, i2) < score(b, i1) ? e2 : e1;
+    }
+
+    // a query has been sent to the engine (thread ID) @dst_tid of server @dst_sid
+    void account(int dst_sid, int dst_tid) {
+        boards[dst_sid].loads[dst_tid - global_num_proxies].qlen++;
+    }
+};
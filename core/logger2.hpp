@@ -45,10 +45,14 @@
 #pragma once
 
 #include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
 #include <cstring>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <type_traits>
 // for va_start/end
 #include <cstdarg>
 
@@ -127,17 +131,172 @@ const char *messages[] = {
 #define OUTPUTLEVEL LOG_DEBUG
 #endif
 
-// logger_impl for every single thread(get\set by the get\setSpecific function)
 namespace logger_impl {
+
+/**
+ * A single-producer single-consumer ring buffer of binary log records,
+ * which is written by a logging thread and drained by the background thread
+ * of the asynchronous mode (see file_logger::set_async)
+ */
+struct log_ring {
+    char *buf;
+    uint64_t size;            // power of two
+    volatile uint64_t head;   // written by the producer
+    volatile uint64_t tail;   // written by the consumer
+    volatile bool owned;      // used by a live thread
+
+    log_ring(uint64_t sz) : size(sz), head(0), tail(0), owned(true) {
+        buf = new char[size];
+        memset(buf, 0, size); // avoid page faults on logging
+    }
+
+    bool empty() { return __atomic_load_n(&head, __ATOMIC_ACQUIRE) == tail; }
+
+    void copy_in(uint64_t pos, const char *src, uint64_t len) {
+        uint64_t off = pos & (size - 1);
+        uint64_t n = std::min(len, size - off);
+        memcpy(buf + off, src, n);
+        memcpy(buf, src + n, len - n); // wrap around
+    }
+
+    void copy_out(uint64_t pos, char *dst, uint64_t len) {
+        uint64_t off = pos & (size - 1);
+        uint64_t n = std::min(len, size - off);
+        memcpy(dst, buf + off, n);
+        memcpy(dst + n, buf, len - n); // wrap around
+    }
+
+    // (producer) return false if there is no enough space
+    bool push(const char *rec, uint32_t len) {
+        if (head + len - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) > size)
+            return false;
+        copy_in(head, rec, len);
+        __atomic_store_n(&head, head + len, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // (consumer) copy out the record at @pos (from tail) w/o removing it
+    bool read(uint64_t pos, std::string &rec) {
+        if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == pos)
+            return false;
+        uint32_t len;
+        copy_out(pos, (char *)&len, sizeof(len));
+        rec.resize(len);
+        copy_out(pos, &rec[0], len);
+        return true;
+    }
+
+    // (consumer) remove the records before @pos
+    void release(uint64_t pos) { __atomic_store_n(&tail, pos, __ATOMIC_RELEASE); }
+};
+
+// the header of a binary log record, which is followed by tagged arguments
+struct record_header {
+    uint32_t len;          // the length of the whole record
+    int32_t level;
+    int32_t line;
+    const char *file;      // __FILE__ and __func__ (static strings)
+    const char *function;
+};
+
+enum arg_tag { ARG_INT = 'i', ARG_UINT = 'u', ARG_DOUBLE = 'd', ARG_CHAR = 'c', ARG_STR = 's' };
+
+inline void put_arg(std::string &rec, char tag, const void *v, size_t sz) {
+    rec.push_back(tag);
+    rec.append((const char *)v, sz);
+}
+
+inline void put_str(std::string &rec, const char *str, uint32_t len) {
+    rec.push_back(ARG_STR);
+    rec.append((const char *)&len, sizeof(len));
+    rec.append(str, len);
+}
+
+/*
+ * encode an argument of the stream into the record w/o formatting it,
+ * return false for other types (which are formatted by the logging thread)
+ */
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value, bool>::type
+encode_arg(std::string &rec, const T &a) {
+    if (sizeof(T) == 1 && !std::is_same<T, bool>::value) {
+        char c = a; // printed as a character
+        put_arg(rec, ARG_CHAR, &c, sizeof(c));
+    } else if (std::is_signed<T>::value) {
+        int64_t v = a;
+        put_arg(rec, ARG_INT, &v, sizeof(v));
+    } else {
+        uint64_t v = a;
+        put_arg(rec, ARG_UINT, &v, sizeof(v));
+    }
+    return true;
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+encode_arg(std::string &rec, const T &a) {
+    double v = a;
+    put_arg(rec, ARG_DOUBLE, &v, sizeof(v));
+    return true;
+}
+
+template <typename T>
+inline typename std::enable_if < !std::is_arithmetic<T>::value, bool >::type
+encode_arg(std::string &rec, const T &a) { return false; }
+
+inline bool encode_arg(std::string &rec, const char *a) {
+    put_str(rec, a, strlen(a));
+    return true;
+}
+
+inline bool encode_arg(std::string &rec, char *a) { return encode_arg(rec, (const char *)a); }
+
+inline bool encode_arg(std::string &rec, const std::string &a) {
+    put_str(rec, a.data(), a.length());
+    return true;
+}
+
+// format the encoded arguments in [@p, @end)
+inline void format_args(std::ostream &os, const char *p, const char *end) {
+    while (p < end) {
+        char tag = *p++;
+        switch (tag) {
+        case ARG_INT: { int64_t v; memcpy(&v, p, sizeof(v)); os << v; p += sizeof(v); break; }
+        case ARG_UINT: { uint64_t v; memcpy(&v, p, sizeof(v)); os << v; p += sizeof(v); break; }
+        case ARG_DOUBLE: { double v; memcpy(&v, p, sizeof(v)); os << v; p += sizeof(v); break; }
+        case ARG_CHAR: { os << *p; p++; break; }
+        case ARG_STR: {
+            uint32_t len;
+            memcpy(&len, p, sizeof(len));
+            p += sizeof(len);
+            os.write(p, len);
+            p += len;
+            break;
+        }
+        default: return; // corrupted
+        }
+    }
+}
+
+// logger_impl for every single thread(get\set by the get\setSpecific function)
 struct streambuf_entry {
     std::stringstream streambuffer;
     bool streamactive;
+
+    // the asynchronous mode
+    bool async = false;       // the current log is recorded in binary
+    bool formatted = false;   // the arguments of the current log are formatted in streambuffer
+    std::string record;       // the current log (record_header + encoded arguments)
+    log_ring *ring = NULL;
 };
+
 }  // namespace logger_impl
 
 void streambuffdestructor(void *v) {
     logger_impl::streambuf_entry *t =
         reinterpret_cast<logger_impl::streambuf_entry *>(v);
+    if (t->ring != NULL)
+        t->ring->owned = false; // reused by other threads after drained
     delete t;
 }
 
@@ -158,16 +317,193 @@ private:
     bool log_to_console;
     int log_level;
 
+    // the asynchronous mode: logging threads append binary records to their own
+    // ring buffers, and a background thread formats and writes them
+    volatile bool async;
+    uint64_t ring_size;
+    std::vector<logger_impl::log_ring *> rings;  // all rings (never freed)
+    pthread_mutex_t rings_mut;                   // protect rings
+    pthread_t writer;
+    volatile bool writer_running;
+
+    // the stream buffer entry of current thread (cached to skip pthread_getspecific)
+    logger_impl::streambuf_entry *peek_entry() {
+        static __thread logger_impl::streambuf_entry *cached = NULL;
+        if (cached == NULL)
+            cached = reinterpret_cast<logger_impl::streambuf_entry *>(
+                         pthread_getspecific(streambufkey));
+        return cached;
+    }
+
+    logger_impl::streambuf_entry *get_entry() {
+        logger_impl::streambuf_entry *streambufentry = peek_entry();
+        // create the key if it doesn't exist
+        if (streambufentry == NULL) {
+            streambufentry = new logger_impl::streambuf_entry;
+            pthread_setspecific(streambufkey, streambufentry);
+            streambufentry = peek_entry();
+        }
+        return streambufentry;
+    }
+
+    // get the ring buffer of current thread (reuse the one of an exited thread if any)
+    logger_impl::log_ring *get_ring(logger_impl::streambuf_entry *entry) {
+        if (entry->ring != NULL)
+            return entry->ring;
+
+        pthread_mutex_lock(&rings_mut);
+        for (auto r : rings) {
+            if (!r->owned && r->empty() && r->size == ring_size) {
+                r->owned = true;
+                entry->ring = r;
+                break;
+            }
+        }
+        if (entry->ring == NULL) {
+            entry->ring = new logger_impl::log_ring(ring_size);
+            rings.push_back(entry->ring);
+        }
+        pthread_mutex_unlock(&rings_mut);
+        return entry->ring;
+    }
+
+    void begin_record(logger_impl::streambuf_entry *entry, int level,
+                      const char *file, const char *function, int line) {
+        logger_impl::record_header hdr;
+        hdr.len = 0;
+        hdr.level = level;
+        hdr.line = line;
+        hdr.file = file;
+        hdr.function = function;
+        entry->record.assign((const char *)&hdr, sizeof(hdr));
+        entry->formatted = false;
+        entry->async = true;
+    }
+
+    // format the arguments encoded so far, and then format the rest on the logging thread
+    void format_record(logger_impl::streambuf_entry *entry) {
+        const char *rec = entry->record.data();
+        logger_impl::format_args(entry->streambuffer, rec + sizeof(logger_impl::record_header),
+                                 rec + entry->record.size());
+        entry->record.resize(sizeof(logger_impl::record_header));
+        entry->formatted = true;
+    }
+
+    // append the current log to the ring buffer of the thread
+    void commit_record(logger_impl::streambuf_entry *entry) {
+        if (entry->formatted) {
+            std::string str = entry->streambuffer.str();
+            logger_impl::put_str(entry->record, str.data(), str.length());
+            entry->streambuffer.str("");
+            entry->formatted = false;
+        }
+
+        std::string &rec = entry->record;
+        logger_impl::record_header *hdr = (logger_impl::record_header *)&rec[0];
+        hdr->len = rec.size();
+        int level = hdr->level;
+
+        if (!writer_running || rec.size() > ring_size / 2) {
+            // disabled or too large to be buffered, write it in order
+            flush();
+            write_record(rec);
+        } else {
+            logger_impl::log_ring *ring = get_ring(entry);
+            while (!ring->push(rec.data(), rec.size()))
+                usleep(10); // wait for the background thread
+            // make errors visible at once (e.g., before aborting)
+            if (level >= LOG_ERROR)
+                flush();
+        }
+
+        rec.clear();
+        entry->async = false;
+    }
+
+    // format a binary record into @ss
+    void format_record(const std::string &rec, std::ostream &ss) {
+        const logger_impl::record_header *hdr = (const logger_impl::record_header *)rec.data();
+#ifndef PRINTFILEINFO
+        ss << ::messages[hdr->level];
+        if (hdr->level == LOG_DEBUG && hdr->file != NULL)
+            ss << hdr->file << "(" << hdr->function << ":" << hdr->line << "):";
+#else
+        ss << ::messages[hdr->level];
+        if (hdr->file != NULL)
+            ss << hdr->file << "(" << hdr->function << ":" << hdr->line << "):";
+#endif
+        logger_impl::format_args(ss, rec.data() + sizeof(logger_impl::record_header),
+                                 rec.data() + hdr->len);
+    }
+
+    // format a binary record and write it to console and/or file
+    void write_record(const std::string &rec) {
+        std::stringstream ss;
+        format_record(rec, ss);
+        std::string str = ss.str();
+        _print2FC(((const logger_impl::record_header *)rec.data())->level,
+                  str.c_str(), (int)str.length());
+    }
+
+    // drain all ring buffers, return the number of written records
+    int drain() {
+        pthread_mutex_lock(&rings_mut);
+        std::vector<logger_impl::log_ring *> rs(rings);
+        pthread_mutex_unlock(&rings_mut);
+
+        int n = 0;
+        std::string rec;
+        std::stringstream ss;
+        for (auto r : rs) {
+            // write a batch of consecutive records at the same level at once
+            int level = -1;
+            uint64_t pos = r->tail;
+            while (true) {
+                bool more = r->read(pos, rec);
+                int lvl = more ? ((logger_impl::record_header *)&rec[0])->level : -1;
+                if ((!more || lvl != level || pos - r->tail > (1 << 16)) && pos != r->tail) {
+                    std::string str = ss.str();
+                    _print2FC(level, str.c_str(), (int)str.length());
+                    ss.str("");
+                    r->release(pos); // after written (see flush)
+                }
+                if (!more) break;
+
+                level = lvl;
+                format_record(rec, ss);
+                pos += rec.size();
+                n++;
+            }
+        }
+        return n;
+    }
+
+    static void *writer_main(void *arg) {
+        file_logger *l = (file_logger *)arg;
+        while (l->writer_running) {
+            if (l->drain() == 0)
+                usleep(100); // idle
+        }
+        l->drain();
+        return NULL;
+    }
+
 public:
     file_logger() {
         log_file = "";
         log_to_console = true;
         log_level = LOG_INFO;
+        async = false;
+        ring_size = 0;
+        writer_running = false;
         pthread_mutex_init(&mut, NULL);
+        pthread_mutex_init(&rings_mut, NULL);
         pthread_key_create(&streambufkey, streambuffdestructor);
     }
 
     ~file_logger() {
+        set_async(false); // write pending logs
+
         if (fout.good()) {
             fout.flush();
             fout.close();
@@ -208,19 +544,65 @@ public:
     // Return the current logger level
     int get_log_level() { return log_level; }
 
+    /**
+     * Enable (or disable) the asynchronous mode, where the logging threads only
+     * encode the arguments (e.g., integers and strings) into binary records in
+     * per-thread ring buffers (@buffer_sz bytes) w/o locks, and a background
+     * thread formats and writes them. The order of logs is kept per thread.
+     */
+    void set_async(bool enable, uint64_t buffer_sz = 1 << 18) {
+        if (enable == async)
+            return;
+
+        if (enable) {
+            // round up to a power of two
+            ring_size = 1;
+            while (ring_size < buffer_sz) ring_size <<= 1;
+
+            writer_running = true;
+            pthread_create(&writer, NULL, writer_main, this);
+            async = true;
+        } else {
+            async = false;
+            writer_running = false;
+            pthread_join(writer, NULL); // drain all rings before exit
+        }
+    }
+
+    bool get_async() { return async; }
+
+    // wait until all logs recorded so far are written (e.g., before printing a prompt)
+    void flush() {
+        if (!writer_running || pthread_equal(pthread_self(), writer))
+            return;
+
+        pthread_mutex_lock(&rings_mut);
+        std::vector<logger_impl::log_ring *> rs(rings);
+        pthread_mutex_unlock(&rings_mut);
+
+        for (auto r : rs) {
+            uint64_t h = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+            while (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) < h && writer_running)
+                usleep(10);
+        }
+    }
+
     // operators
     template <typename T>
     file_logger &operator<<(T a) {
         // get the stream buffer entry of specific thread first
-        logger_impl::streambuf_entry *streambufentry =
-            reinterpret_cast<logger_impl::streambuf_entry *>(
-                pthread_getspecific(streambufkey));
+        logger_impl::streambuf_entry *streambufentry = peek_entry();
 
         if (streambufentry != NULL) {
             std::stringstream &sstream = streambufentry->streambuffer;
             bool &streamactive = streambufentry->streamactive;
 
             if (streamactive) {
+                if (streambufentry->async && !streambufentry->formatted) {
+                    if (logger_impl::encode_arg(streambufentry->record, a))
+                        return *this;
+                    format_record(streambufentry); // e.g., manipulators
+                }
                 sstream << a;
             }
         }
@@ -230,9 +612,7 @@ public:
     // if input a std::endl then flush the message to console and/or fout
     file_logger &operator<<(std::ostream & (*f)(std::ostream &)) {
         // get the stream buffer entry first
-        logger_impl::streambuf_entry *streambufentry =
-            reinterpret_cast<logger_impl::streambuf_entry *>(
-                pthread_getspecific(streambufkey));
+        logger_impl::streambuf_entry *streambufentry = peek_entry();
 
         if (streambufentry != NULL) {
             std::stringstream &sstream = streambufentry->streambuffer;
@@ -242,6 +622,10 @@ public:
             typedef std::ostream &(*endltype)(std::ostream &);
             if (streamactive) {
                 if (endltype(f) == endltype(std::endl)) {
+                    if (streambufentry->async) {
+                        *this << "\n";
+                        return *this;
+                    }
                     sstream << "\n";
                     stream_flush();
                 }
@@ -286,9 +670,7 @@ public:
 
     void stream_flush() {
         // get the stream buffer entry first
-        logger_impl::streambuf_entry *streambufentry =
-            reinterpret_cast<logger_impl::streambuf_entry *>(
-                pthread_getspecific(streambufkey));
+        logger_impl::streambuf_entry *streambufentry = peek_entry();
         if (streambufentry != NULL) {
             std::stringstream &sstream = streambufentry->streambuffer;
 
@@ -302,15 +684,23 @@ public:
     // if the end is "\n" then flush the message to console and/or fout
     file_logger &operator<<(const char *a) {
         // get the stream buffer entry first
-        logger_impl::streambuf_entry *streambufentry =
-            reinterpret_cast<logger_impl::streambuf_entry *>(
-                pthread_getspecific(streambufkey));
+        logger_impl::streambuf_entry *streambufentry = peek_entry();
 
         if (streambufentry != NULL) {
             std::stringstream &sstream = streambufentry->streambuffer;
             bool &streamactive = streambufentry->streamactive;
 
             if (streamactive) {
+                if (streambufentry->async) {
+                    if (streambufentry->formatted)
+                        sstream << a;
+                    else
+                        logger_impl::encode_arg(streambufentry->record, a);
+                    if (a[strlen(a) - 1] == '\n')
+                        commit_record(streambufentry);
+                    return *this;
+                }
+
                 sstream << a;
                 if (a[strlen(a) - 1] == '\n') {
                     stream_flush();
@@ -335,14 +725,7 @@ public:
                               const char *function, int line,
                               bool do_start = true) {
         // get the pthread-specific stream buffer
-        logger_impl::streambuf_entry *streambufentry =
-            reinterpret_cast<logger_impl::streambuf_entry *>(
-                pthread_getspecific(streambufkey));
-        // create the key if it doesn't exist
-        if (streambufentry == NULL) {
-            streambufentry = new logger_impl::streambuf_entry;
-            pthread_setspecific(streambufkey, streambufentry);
-        }
+        logger_impl::streambuf_entry *streambufentry = get_entry();
 
         std::stringstream &streambuffer = streambufentry->streambuffer;
         bool &streamactive = streambufentry->streamactive;
@@ -357,14 +740,22 @@ public:
             // firstly matched _Val in _Str
             file = ((strrchr(file, '/') ? : file - 1) + 1);
 
+            // defer the header and arguments to the background thread
+            if (async && (streambufentry->async || streambuffer.tellp() == 0)) {
+                if (!streambufentry->async)
+                    begin_record(streambufentry, lineloglevel, file, function, line);
+                streamactive = true;
+                return *this;
+            }
+
             // print header to the streambuffer
             if (streambuffer.str().length() == 0) {
 #ifndef PRINTFILEINFO
-                streambuffer << messages[lineloglevel];
+                streambuffer << ::messages[lineloglevel];
                 if (lineloglevel == LOG_DEBUG)
                     streambuffer << file << "(" << function << ":" << line << "):";
 #else
-                streambuffer << messages[lineloglevel] << file << "(" << function << ":"
+                streambuffer << ::messages[lineloglevel] << file << "(" << function << ":"
                              << line << "):";
 #endif
             }
@@ -401,14 +792,14 @@ public:
 #ifndef PRINTFILEINFO
             // print loglevel
             if (loglevel == LOG_DEBUG) {
-                byteswritten = snprintf(str, 1024, "%s%s(%s:%d): ", messages[loglevel],
+                byteswritten = snprintf(str, 1024, "%s%s(%s:%d): ", ::messages[loglevel],
                                         file, function, line);
             } else {
-                byteswritten = snprintf(str, 1024, "%s", messages[loglevel]);
+                byteswritten = snprintf(str, 1024, "%s", ::messages[loglevel]);
             }
 #else
             // the actual header
-            byteswritten = snprintf(str, 1024, "%s%s(%s:%d): ", messages[loglevel],
+            byteswritten = snprintf(str, 1024, "%s%s(%s:%d): ", ::messages[loglevel],
                                     file, function, line);
 #endif
             // the actual logger
@@ -416,9 +807,23 @@ public:
                 vsnprintf(str + byteswritten, 1024 - byteswritten, fmt, arg);
 
             // the logger tail
+            // NOTE: vsnprintf returns the length w/o truncation
+            byteswritten = std::min(byteswritten, 1022);
             str[byteswritten] = '\n';
             str[byteswritten + 1] = 0;
 
+            // the header has been formatted (w/o deferring)
+            if (async) {
+                logger_impl::streambuf_entry *entry = get_entry();
+                if (!entry->async) {
+                    begin_record(entry, loglevel, NULL, NULL, line);
+                    logger_impl::put_str(entry->record, str + strlen(::messages[loglevel]),
+                                         byteswritten + 1 - strlen(::messages[loglevel]));
+                    commit_record(entry);
+                    return;
+                }
+            }
+
             if (fout.good()) {
                 pthread_mutex_lock(&mut);
                 fout << str;
@@ -514,6 +919,17 @@ struct log_stream_dispatch<false> {
     }
 };
 
+// swallow the stream of a log in a conditional expression
+struct log_voidify {
+    template <typename T>
+    inline void operator&(T &&) { }
+};
+
+// the level is checked before evaluating any argument of the log, and the logs
+// below OUTPUTLEVEL are compiled out
+#define log_enabled(lvl) \
+    ((lvl) >= OUTPUTLEVEL && (lvl) >= global_logger().get_log_level())
+
 // if set OUTPUTLEVEL == LOG_NONE, disable logging
 #if OUTPUTLEVEL == LOG_NONE
 // totally disable logging
@@ -521,12 +937,14 @@ struct log_stream_dispatch<false> {
 #define logstream(lvl) \
     if (0) null_stream()
 #else
-#define logger(lvl, fmt, ...)                                                    \
-    (log_dispatch<(lvl >= OUTPUTLEVEL)>::exec(lvl, __FILE__, __func__, __LINE__, \
-                                              fmt, ##__VA_ARGS__))
-#define logstream(lvl)                                                        \
-    (log_stream_dispatch<(lvl >= OUTPUTLEVEL)>::exec(lvl, __FILE__, __func__, \
-                                                     __LINE__))
+#define logger(lvl, fmt, ...)                                                     \
+    (!log_enabled(lvl) ? (void)0                                                  \
+     : log_dispatch<(lvl >= OUTPUTLEVEL)>::exec(lvl, __FILE__, __func__, __LINE__, \
+                                                fmt, ##__VA_ARGS__))
+#define logstream(lvl)                                                          \
+    !log_enabled(lvl) ? (void)0                                                 \
+    : log_voidify() & log_stream_dispatch<(lvl >= OUTPUTLEVEL)>::exec(lvl, __FILE__, \
+                                                                      __func__, __LINE__)
 #endif
 
 // use LOG_endl just like std::endl
@@ -32,7 +32,7 @@ private:
     int num_servers;
     int num_threads;
 
-    // The Wukong's memory layout: kvstore | rdma-buffer | ring-buffer
+    // The Wukong's memory layout: kvstore | rdma-buffer | ring-buffer | ... | load-board | load-scratch
     // The rdma-buffer and ring-buffer are only used when HAS_RDMA
     char *mem;
     uint64_t mem_sz;
@@ -62,12 +62,25 @@ private:
     char *rrbf_hd; // written by reciever (remote) and read by sender (local)
     uint64_t rrbf_hd_sz;
     uint64_t rrbf_hd_off;
+
+    // the load of each engine (#threads), written by the engine and read by
+    // proxies (see load_board.hpp)
+    char *lbd;
+    uint64_t lbd_sz;
+    uint64_t lbd_off;
+
+    // the buffer of each thread to read the load board of a remote server (#threads),
+    // apart from the rdma-buffer which may hold a message being sent by the thread
+    char *lsc;
+    uint64_t lsc_sz;
+    uint64_t lsc_off;
 public:
-    Mem(int num_servers, int num_threads)
+    // the size of kvstore is global_memstore_size_gb by default (@kvstore_sz == 0)
+    Mem(int num_servers, int num_threads, uint64_t kvstore_sz = 0)
         : num_servers(num_servers), num_threads(num_threads) {
 
         // calculate memory usage
-        kvs_sz = GiB2B(global_memstore_size_gb);
+        kvs_sz = kvstore_sz ? kvstore_sz : GiB2B(global_memstore_size_gb);
 
         if (RDMA::get_rdma().has_rdma()) {
             // only used by RDMA device
@@ -78,12 +91,16 @@ public:
         }
 
         lrbf_hd_sz = rrbf_hd_sz = sizeof(uint64_t);
+        lbd_sz = 64; // a cacheline per thread (avoid false sharing)
+        lsc_sz = lbd_sz * num_threads; // a whole load board
 
         mem_sz = kvs_sz
                  + buf_sz * num_threads
                  + rbf_sz * num_servers * num_threads
                  + lrbf_hd_sz * num_servers * num_threads
-                 + rrbf_hd_sz * num_servers * num_threads;
+                 + rrbf_hd_sz * num_servers * num_threads
+                 + lbd_sz * num_threads
+                 + lsc_sz * num_threads;
         mem = (char *)malloc(mem_sz);
         memset(mem, 0, mem_sz);
 
@@ -101,6 +118,12 @@ public:
 
         rrbf_hd_off = lrbf_hd_off + lrbf_hd_sz * num_servers * num_threads;
         rrbf_hd =  mem + rrbf_hd_off;
+
+        lbd_off = rrbf_hd_off + rrbf_hd_sz * num_servers * num_threads;
+        lbd = mem + lbd_off;
+
+        lsc_off = lbd_off + lbd_sz * num_threads;
+        lsc = mem + lsc_off;
     }
 
     ~Mem() { free(mem); }
@@ -133,6 +156,15 @@ public:
     inline uint64_t remote_ring_head_size() { return rrbf_hd_sz; }
     inline uint64_t remote_ring_head_offset(int tid, int sid) { return rrbf_hd_off + (rrbf_hd_sz * num_servers) * tid + rrbf_hd_sz * sid; }
 
+    // load-board
+    inline char *load_board(int tid) { return lbd + lbd_sz * tid; }
+    inline uint64_t load_board_size() { return lbd_sz; }
+    inline uint64_t load_board_offset(int tid) { return lbd_off + lbd_sz * tid; }
+
+    // load-scratch
+    inline char *load_scratch(int tid) { return lsc + lsc_sz * tid; }
+    inline uint64_t load_scratch_size() { return lsc_sz; }
+
 }; // end of class Mem
 
 #define ADDR_PER_SRV(_addr, _sz, _tid) ((_addr) + ((_sz) * (_tid)));
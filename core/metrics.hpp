@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/string.hpp>
+
+using namespace std;
+
+/**
+ * A snapshot of runtime metrics (counters and gauges) of engines and servers
+ *
+ * The metrics are collected from the counters of engines (see Engine::collect_metrics)
+ * on each server, merged by the master proxy, and printed as a table or
+ * dumped in the Prometheus text format.
+ */
+class Metrics {
+public:
+    enum Type { COUNTER, GAUGE };
+
+    struct Sample {
+        string name;
+        int type;
+        int sid;
+        int tid;        // -1 for server-level metrics
+        uint64_t value;
+
+        template <typename Archive>
+        void serialize(Archive &ar, const unsigned int version) {
+            ar & name;
+            ar & type;
+            ar & sid;
+            ar & tid;
+            ar & value;
+        }
+    };
+
+    vector<Sample> samples;
+
+    void add(const string &name, int type, int sid, int tid, uint64_t value) {
+        Sample s;
+        s.name = name;
+        s.type = type;
+        s.sid = sid;
+        s.tid = tid;
+        s.value = value;
+        samples.push_back(s);
+    }
+
+    void merge(Metrics &other) {
+        samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+    }
+
+    // print the per-server sum of each metric (a column per server)
+    void print() {
+        map<string, map<int, uint64_t>> table; // name -> sid -> value
+        int nservers = 0;
+        for (auto &s : samples) {
+            table[s.name][s.sid] += s.value;
+            nservers = max(nservers, s.sid + 1);
+        }
+
+        stringstream ss;
+        ss << setw(32) << left << "metric";
+        for (int i = 0; i < nservers; i++)
+            ss << setw(16) << right << ("server" + to_string(i));
+        logstream(LOG_INFO) << ss.str() << LOG_endl;
+
+        for (auto &row : table) {
+            stringstream line;
+            line << setw(32) << left << row.first;
+            for (int i = 0; i < nservers; i++)
+                line << setw(16) << right << row.second[i];
+            logstream(LOG_INFO) << line.str() << LOG_endl;
+        }
+    }
+
+    // the Prometheus text exposition format
+    string to_prometheus() {
+        map<string, vector<Sample *>> groups;
+        for (auto &s : samples)
+            groups[s.name].push_back(&s);
+
+        stringstream ss;
+        for (auto &g : groups) {
+            string name = "wukong_" + g.first;
+            ss << "# TYPE " << name << " "
+               << (g.second[0]->type == COUNTER ? "counter" : "gauge") << "\n";
+            for (auto s : g.second) {
+                ss << name << "{server=\"" << s->sid << "\"";
+                if (s->tid >= 0) ss << ",engine=\"" << s->tid << "\"";
+                ss << "} " << s->value << "\n";
+            }
+        }
+        return ss.str();
+    }
+
+    // write to a temporary file and then rename, so readers never see a partial file
+    bool dump_prometheus(const string &fname) {
+        string tmp = fname + ".tmp";
+        {
+            ofstream ofs(tmp.c_str());
+            if (!ofs.good()) return false;
+            ofs << to_prometheus();
+        }
+        return rename(tmp.c_str(), fname.c_str()) == 0;
+    }
+
+    template <typename Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+        ar & samples;
+    }
+};
@@ -23,10 +23,14 @@
 #pragma once
 
 #include <iostream>
-#include <boost/serialization/unordered_map.hpp>
+#include <unordered_map>
+#include <boost/serialization/vector.hpp>
 
+#include "config.hpp"
 #include "timer.hpp"
 #include "unit.hpp"
+#include "hdr_histogram.hpp"
+#include "query.hpp"
 
 using namespace std;
 
@@ -35,16 +39,11 @@ private:
     struct req_stats {
         int query_type;
         uint64_t start_time = 0ull;
-        uint64_t end_time = 0ull;
-
-        template <typename Archive>
-        void serialize(Archive &ar, const unsigned int version) {
-            ar & query_type;
-            ar & start_time;
-            ar & end_time;
-        }
     };
 
+    // the highest trackable latency (larger latencies are clamped)
+    static const uint64_t MAX_LATENCY = SEC(3600);
+
     uint64_t init_time = 0ull, done_time = 0ull;
 
     uint64_t last_time = 0ull, last_separator = 0ull;
@@ -57,23 +56,36 @@ private:
     float thpt = 0.0;
 
     int nquery_types = 0;
+    int nlight_types = 0;  // the types before it are light queries, and the rest are heavy
     bool is_aggregated = false;
 
-    // key: query_type, value: latency of query
-    // ordered by query_type
-    std::map<int, vector<uint64_t>> total_latency_map;
+    // the latency of each type of query (CDF)
+    // NOTE: the memory usage is fixed regardless of the number of queries
+    vector<HDR_Histogram> latency_hists;
+
+    // the latency of light and heavy queries (see SPARQLQuery::SQClass)
+    vector<HDR_Histogram> class_hists;
 
-    unordered_map<int, req_stats> stats_map; // CDF
+    // the expected interval (usec) between requests of a client to correct
+    // coordinated omission (0: disabled)
+    uint64_t expected_interval = 0ull;
+
+    unordered_map<int, req_stats> stats_map; // in-flight requests
+
+    // the result cache of the proxy (see Result_Cache)
+    uint64_t cache_lookups = 0ull, cache_hits = 0ull;
 
 public:
     void init() {
         init_time = timer::get_usec();
         last_time = last_separator = timer::get_usec();
+        cache_lookups = cache_hits = 0ull;
     }
 
-    void init(int nquery_types) {
+    void init(int nquery_types, int nlight_types) {
         is_aggregated = false;
         this->nquery_types = nquery_types;
+        this->nlight_types = nlight_types;
         done_time = 0ull;
         last_cnt = 0ull;
         thpt_time = 0ull;
@@ -82,12 +94,15 @@ public:
         init_time = timer::get_usec();
         last_time = last_separator = timer::get_usec();
         stats_map.clear();
-        total_latency_map.clear();
-        for (int i = 0; i < nquery_types; ++i) {
-            total_latency_map[i] = std::vector<uint64_t>();
-        }
+        cache_lookups = cache_hits = 0ull;
+        latency_hists.assign(nquery_types, HDR_Histogram(MAX_LATENCY, global_latency_precision));
+        class_hists.assign(2, HDR_Histogram(MAX_LATENCY, global_latency_precision));
     }
 
+    // each client is expected to send a request per @interval usec,
+    // e.g., the target rate is (#clients * 1sec / @interval)
+    void set_expected_interval(uint64_t interval) { expected_interval = interval; }
+
     void finish() {
         done_time = timer::get_usec();
     }
@@ -133,66 +148,64 @@ public:
         logstream(LOG_INFO) << "Throughput: " << thpt / 1000.0 << "K queries/sec" << LOG_endl;
     }
 
+    void record_cache(bool hit) {
+        cache_lookups++;
+        if (hit) cache_hits++;
+    }
+
+    // print the hit rate of the result cache (if used)
+    void print_cache() {
+        if (cache_lookups == 0) return;
+        logstream(LOG_INFO) << "Result cache: " << cache_hits << " hits / " << cache_lookups
+                            << " lookups (" << (100.0 * cache_hits / cache_lookups) << "%)" << LOG_endl;
+    }
+
     void start_record(int reqid, int type) {
         stats_map[reqid].query_type = type;
         stats_map[reqid].start_time = timer::get_usec() - init_time;
     }
 
-    void end_record(int reqid) {
-        stats_map[reqid].end_time = timer::get_usec() - init_time;
+    // the latency starts from @time (usec) instead of now, e.g., the intended send time
+    void start_record(int reqid, int type, uint64_t time) {
+        stats_map[reqid].query_type = type;
+        stats_map[reqid].start_time = time - init_time;
     }
 
-    // calculate each query's cdf, then sort respectively
+    // return the latency (usec) of the request
+    uint64_t end_record(int reqid) {
+        auto it = stats_map.find(reqid);
+        if (it == stats_map.end()) return 0; // unknown request
+
+        uint64_t latency = timer::get_usec() - init_time - it->second.start_time;
+        latency_hists[it->second.query_type].record_corrected(latency, expected_interval);
+        int qclass = (it->second.query_type < nlight_types) ? SPARQLQuery::SQ_LIGHT : SPARQLQuery::SQ_HEAVY;
+        class_hists[qclass].record_corrected(latency, expected_interval);
+        stats_map.erase(it);
+        return latency;
+    }
+
+    // the latencies are recorded into histograms on the fly
     void aggregate() {
-        for (auto const &s : stats_map)
-            total_latency_map[s.second.query_type].push_back(s.second.end_time - s.second.start_time);
-
-        // sort
-        for (int i = 0; i < nquery_types; ++i) {
-            vector<uint64_t> &lats = total_latency_map[i];
-            if (!lats.empty())
-                sort(lats.begin(), lats.end());
-        }
         is_aggregated = true;
     }
 
     void print_cdf() {
         ASSERT(is_aggregated);
 
-        vector<double> cdf_rates = {0.01};
+        vector<double> cdf_rates = {1};
 
         // 5% >> 95%
         for (int i = 1; i < 20; i++)
-            cdf_rates.push_back(0.05 * i);
+            cdf_rates.push_back(5 * i);
 
         // 96% >> 100%
-        for (int i = 1; i <= 5; i++)
-            cdf_rates.push_back(0.95 + i * 0.01);
+        for (int i = 1; i <= 4; i++)
+            cdf_rates.push_back(95 + i);
+        cdf_rates.push_back(99.9);
+        cdf_rates.push_back(99.99);
+        cdf_rates.push_back(100);
 
         logstream(LOG_INFO) << "Per-query CDF graph" << LOG_endl;
-        int cnt, query_type;//, query_cnt = 0;
-        map<int, vector<uint64_t>> cdf_res;
-
-        // select 25 points from total_latency_map
-        for (auto &e : total_latency_map) {
-            query_type = e.first;
-            vector<uint64_t> &lats = e.second;
-
-            if (lats.empty()) continue;
-
-            cnt = 0;
-            // result of CDF figure
-            cdf_res[query_type] = std::vector<uint64_t>();
-            // select points from lats corresponding to cdf_rates
-            for (auto const &rate : cdf_rates) {
-                int idx = lats.size() * rate;
-                if (idx >= lats.size()) idx = lats.size() - 1;
-                cdf_res[query_type].push_back(lats[idx]);
-                cnt++;
-            }
-            ASSERT(cdf_res[query_type].size() == 25);
-        }
-
         logstream(LOG_INFO) << "CDF Res: " << LOG_endl;
         logstream(LOG_INFO) << "P";
         for (int i = 1; i <= nquery_types; ++i)
@@ -200,31 +213,59 @@ public:
         logstream(LOG_INFO) << LOG_endl;
 
         // print cdf data
-        for (int row = 1; row <= 25; ++row) {
-            if (row == 1)
-                logstream(LOG_INFO) << row << "\t";
-            else if (row <= 20)
-                logstream(LOG_INFO) << 5 * (row - 1) << "\t";
-            else
-                logstream(LOG_INFO) << 95 + (row - 20) << "\t";
-
+        for (auto const &rate : cdf_rates) {
+            logstream(LOG_INFO) << rate << "\t";
             for (int i = 0; i < nquery_types; ++i)
-                logstream(LOG_INFO) << cdf_res[i][row - 1] << "\t";
+                logstream(LOG_INFO) << latency_hists[i].value_at_percentile(rate) << "\t";
+            logstream(LOG_INFO) << LOG_endl;
+        }
+
+        // print the number of queries and the average latency
+        logstream(LOG_INFO) << "#";
+        for (int i = 0; i < nquery_types; ++i)
+            logstream(LOG_INFO) << "\t" << latency_hists[i].get_total_count();
+        logstream(LOG_INFO) << LOG_endl;
+        logstream(LOG_INFO) << "AVG";
+        for (int i = 0; i < nquery_types; ++i)
+            logstream(LOG_INFO) << "\t" << (uint64_t)latency_hists[i].get_mean();
+        logstream(LOG_INFO) << LOG_endl;
+
+        // print the tail latency of light and heavy queries
+        const char *class_names[] = {"light", "heavy"};
+        logstream(LOG_INFO) << "Per-class tail latency" << LOG_endl;
+        logstream(LOG_INFO) << "class\t#\tP50\tP90\tP99\tP99.9\tMAX" << LOG_endl;
+        for (int c = 0; c < class_hists.size(); c++) {
+            HDR_Histogram &h = class_hists[c];
+            if (h.get_total_count() == 0) continue;
+            logstream(LOG_INFO) << class_names[c] << "\t" << h.get_total_count();
+            for (double rate : {50.0, 90.0, 99.0, 99.9, 100.0})
+                logstream(LOG_INFO) << "\t" << h.value_at_percentile(rate);
             logstream(LOG_INFO) << LOG_endl;
         }
     }
 
     void merge(Monitor & other) {
         if (nquery_types < other.nquery_types) nquery_types = other.nquery_types;
-        for (auto const &s : other.stats_map)
-            stats_map[s.first] = s.second;
+        if (latency_hists.size() < other.latency_hists.size())
+            latency_hists.resize(other.latency_hists.size());
+        for (int i = 0; i < other.latency_hists.size(); i++)
+            latency_hists[i].merge(other.latency_hists[i]);
+        if (class_hists.size() < other.class_hists.size())
+            class_hists.resize(other.class_hists.size());
+        for (int i = 0; i < other.class_hists.size(); i++)
+            class_hists[i].merge(other.class_hists[i]);
         thpt += other.thpt;
+        cache_lookups += other.cache_lookups;
+        cache_hits += other.cache_hits;
     }
 
     template <typename Archive>
     void serialize(Archive & ar, const unsigned int version) {
         ar & nquery_types;
-        ar & stats_map;
+        ar & latency_hists;
+        ar & class_hists;
         ar & thpt;
+        ar & cache_lookups;
+        ar & cache_hits;
     }
 };
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "config.hpp"
+#include "bind.hpp"
+#include "string_server.hpp"
+#include "data_statistic.hpp"
+#include "dgraph.hpp"
+#include "result_cache.hpp"
+
+using namespace std;
+
+/**
+ * The replicas of read-mostly structures on each NUMANODE of a server
+ *
+ * All threads of a server share the string server, the statistics and the edges
+ * of index vertices (e.g., all subjects of a type), which are read by the threads
+ * on the other nodes through the interconnect (QPI/UPI). With
+ * global_enable_numa_replicas, each node has its own copies of them (allocated by
+ * a thread on the node), and a thread uses the copies of its node (get_thread_node).
+ *
+ * The string server and the statistics are copied at startup. The strings added by
+ * dynamic loading go to all copies (see String_Server::add), and 'load-stat' reloads
+ * all copies of the statistics (see load_stat). The edges of an index vertex are copied on demand and
+ * tagged by the data version (see result_cache.hpp), so they are copied again
+ * after a dynamic load.
+ */
+class Node_Replicas {
+private:
+    typedef std::shared_ptr<vector<edge_t>> edges_t;
+
+    struct index_replica {
+        uint64_t version;
+        edges_t edges;
+    };
+
+    // the replicas of index vertices on a node
+    struct node_index {
+        pthread_spinlock_t lock;
+        unordered_map<uint64_t, index_replica> vertices;  // (vid, dir) -> edges
+        uint64_t bytes = 0;
+
+        node_index() { pthread_spin_init(&lock, 0); }
+    };
+
+    int sid;
+    vector<String_Server *> str_servers;  // per node
+    vector<data_statistic *> statistics;  // per node
+    vector<node_index> indexes;           // per node
+
+public:
+    Node_Replicas(int sid, String_Server *str_server, data_statistic *statistic)
+        : sid(sid) {
+        int nnodes = cpu_topo.size();
+        str_servers.resize(nnodes);
+        statistics.resize(nnodes);
+        indexes.resize(nnodes);
+
+        for (int nid = 0; nid < nnodes; nid++) {
+            run_on_node(nid, [&]() {
+                str_servers[nid] = new String_Server(*str_server);
+                statistics[nid] = new data_statistic(*statistic);
+            });
+        }
+
+        // keep the copies up-to-date
+        for (auto s : str_servers)
+            str_server->replicas.push_back(s);
+
+        logstream(LOG_INFO) << "#" << sid << ": replicate read-mostly structures on "
+                            << nnodes << " NUMANODEs" << LOG_endl;
+    }
+
+    String_Server *get_str_server(int tid) { return str_servers[get_thread_node(tid)]; }
+
+    data_statistic *get_statistic(int tid) { return statistics[get_thread_node(tid)]; }
+
+    // load the statistics from @fname into the copies of all nodes
+    // NOTE: it runs on the leader proxy while the other proxies wait for the next command
+    void load_stat(string fname) {
+        statistics[0]->load_stat_from_file(fname); // exchanged with the other servers once
+        for (int nid = 1; nid < statistics.size(); nid++)
+            run_on_node(nid, [&]() { *statistics[nid] = *statistics[0]; });
+    }
+
+    // the edges of index vertex @vid (see DGraph::get_index_edges_local) on the node of thread @tid
+    edges_t get_index_edges(int tid, DGraph *graph, sid_t vid, dir_t d) {
+        node_index &idx = indexes[get_thread_node(tid)];
+        uint64_t key = ((uint64_t)vid << 1) | d;
+        uint64_t version = get_data_version(sid);
+
+        pthread_spin_lock(&idx.lock);
+        auto it = idx.vertices.find(key);
+        if (it != idx.vertices.end() && it->second.version == version) {
+            edges_t edges = it->second.edges;
+            pthread_spin_unlock(&idx.lock);
+            return edges;
+        }
+        pthread_spin_unlock(&idx.lock);
+
+        // copy the edges (out of the lock) by the thread on the node
+        uint64_t sz = 0;
+        edge_t *local = graph->get_index_edges_local(tid, vid, d, &sz);
+        edges_t edges = std::make_shared<vector<edge_t>>(local, local + sz);
+
+        pthread_spin_lock(&idx.lock);
+        index_replica &r = idx.vertices[key];
+        if (r.edges) idx.bytes -= r.edges->size() * sizeof(edge_t);
+        r.version = version;
+        r.edges = edges;  // the old copy is freed after its last reader
+        idx.bytes += sz * sizeof(edge_t);
+        pthread_spin_unlock(&idx.lock);
+        return edges;
+    }
+
+    // the memory of all copies (excl. the original ones)
+    uint64_t memory_usage() {
+        uint64_t bytes = 0;
+        for (auto s : str_servers)
+            bytes += s->memory_usage();
+        for (auto s : statistics)
+            bytes += s->memory_usage();
+        for (auto &idx : indexes)
+            bytes += idx.bytes;
+        return bytes;
+    }
+};
+
+// the replicas of each server (indexed by server ID), NULL if disabled
+std::vector<Node_Replicas *> node_replicas;
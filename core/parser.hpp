@@ -202,6 +202,10 @@ private:
                 || (sp.getProjectionModifier() == SPARQLParser::ProjectionModifier::Modifier_Reduced))
             sq.distinct = true;
 
+        // count
+        if (sp.getProjectionModifier() == SPARQLParser::ProjectionModifier::Modifier_Count)
+            sq.count = true;
+
         // corun
         if (sq.corun_enabled = sp.isCorunEnabled()) {
             sq.corun_step = sp.getCorunStep();
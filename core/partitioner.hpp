@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "config.hpp"
+#include "type.hpp"
+#include "hdfs.hpp"
+#include "mymath.hpp"
+#include "timer.hpp"
+#include "assertion.hpp"
+
+using namespace std;
+
+#define PARTITION_SLACK 0.1  // the imbalance of #vertices allowed by ldg
+
+/**
+ * The partitioning of (normal) vertices over servers (global_partitioner)
+ *
+ * hash: vertex @vid is on server (vid % #servers), which needs no state, but
+ *       the neighbors are almost never co-located.
+ * ldg:  the linear deterministic greedy (LDG) streaming partitioning. Before loading,
+ *       all triples are streamed once (in the same order on all servers), and each
+ *       subject is placed on the server with the most of its placed neighbors,
+ *       weighted by the remaining capacity of the server (1 - |P_i| / C). An object
+ *       is tentatively placed with the first subject referring to it, so the leaves
+ *       (e.g., literals) follow their subjects.
+ *
+ * The mapping of ldg is a compact array (one byte per vertex) replicated on all
+ * servers, and the vertices out of the array (e.g., the index vertices or the new
+ * vertices of dynamic loading) fall back to hash.
+ */
+class Partitioner {
+private:
+    enum { UNPLACED = 0xFF, TENTATIVE = 0x80 };
+
+    bool enabled = false;  // hash if disabled
+    int num_servers = 1;
+    vector<uint8_t> parts; // vid -> server ID (maybe | TENTATIVE)
+
+    pthread_mutex_t lock;
+    bool initialized = false;
+
+    // the placement during streaming
+    vector<uint64_t> loads; // #vertices placed on each server
+    double capacity = 0;
+
+    Partitioner() { pthread_mutex_init(&lock, NULL); }
+
+    uint8_t get_part(uint64_t vid) { return vid < parts.size() ? parts[vid] : (uint8_t)UNPLACED; }
+
+    void set_part(sid_t vid, uint8_t part) {
+        if (vid >= parts.size())
+            parts.resize(max((uint64_t)vid + 1, (uint64_t)parts.size() * 2), UNPLACED);
+        parts[vid] = part;
+    }
+
+    // place subject @v with its neighbors @nbrs
+    void place(sid_t v, vector<sid_t> &nbrs) {
+        uint8_t pv = get_part(v);
+        if (pv == UNPLACED || (pv & TENTATIVE)) {
+            // count the placed neighbors on each server (incl. the one referring to @v)
+            vector<uint64_t> cnts(num_servers, 0);
+            if (pv != UNPLACED) cnts[pv & ~TENTATIVE]++;
+            for (auto o : nbrs) {
+                uint8_t po = get_part(o);
+                if (po != UNPLACED) cnts[po & ~TENTATIVE]++;
+            }
+
+            // the best server, or the least loaded one if no placed neighbor
+            int best = 0;
+            double best_score = 0;
+            for (int i = 0; i < num_servers; i++) {
+                double score = cnts[i] * max(0.0, 1.0 - loads[i] / capacity);
+                if (score > best_score) {
+                    best = i;
+                    best_score = score;
+                }
+            }
+            if (best_score == 0)
+                best = min_element(loads.begin(), loads.end()) - loads.begin();
+
+            pv = best;
+            set_part(v, pv);
+            loads[pv]++;
+        }
+
+        for (auto o : nbrs)
+            if (get_part(o) == UNPLACED)
+                set_part(o, pv | TENTATIVE);
+    }
+
+    void stream(istream &file) {
+        sid_t s, p, o, cur = BLANK_ID;
+        vector<sid_t> nbrs;
+        while (file >> s >> p >> o) {
+            if (s != cur) {
+                if (cur != BLANK_ID) place(cur, nbrs);
+                cur = s;
+                nbrs.clear();
+            }
+            if (is_vid(o)) nbrs.push_back(o); // skip types
+        }
+        if (cur != BLANK_ID) place(cur, nbrs);
+    }
+
+public:
+    static Partitioner &get() {
+        static Partitioner partitioner;
+        return partitioner;
+    }
+
+    // partition the vertices in the data files @fnames (about @nvertices), which
+    // is done once and shared by the simulated servers (see sim.hpp)
+    void init(vector<string> fnames, uint64_t nvertices) {
+        pthread_mutex_lock(&lock);
+        if (initialized || global_partitioner == "hash") {
+            initialized = true;
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+
+        uint64_t start = timer::get_usec();
+        num_servers = global_num_servers;
+        ASSERT(num_servers < TENTATIVE - 1); // server 127 | TENTATIVE would be UNPLACED
+        loads.assign(num_servers, 0);
+        capacity = max(1.0, (double)nvertices / num_servers * (1.0 + PARTITION_SLACK));
+
+        // the same order on all servers
+        sort(fnames.begin(), fnames.end());
+        for (auto const &fname : fnames) {
+            if (boost::starts_with(fname, "hdfs:")) {
+                wukong::hdfs &hdfs = wukong::hdfs::get_hdfs();
+                wukong::hdfs::fstream file(hdfs, fname);
+                stream(file);
+                file.close();
+            } else {
+                ifstream file(fname.c_str());
+                stream(file);
+                file.close();
+            }
+        }
+
+        // the objects only placed tentatively follow their subjects
+        for (auto &part : parts) {
+            if (part != UNPLACED && (part & TENTATIVE)) {
+                part &= ~TENTATIVE;
+                loads[part]++;
+            }
+        }
+
+        enabled = true;
+        initialized = true;
+        pthread_mutex_unlock(&lock);
+
+        uint64_t end = timer::get_usec();
+        logstream(LOG_INFO) << "partition vertices by " << global_partitioner << " ("
+                            << (end - start) / 1000 << " ms)" << LOG_endl;
+        for (int i = 0; i < num_servers; i++)
+            logstream(LOG_INFO) << "\tserver " << i << ": " << loads[i] << " vertices" << LOG_endl;
+    }
+
+    // the server of vertex @vid
+    inline int get_sid(uint64_t vid) {
+        if (enabled) {
+            uint8_t part = get_part(vid);
+            if (part != UNPLACED) return part;
+        }
+        return mymath::hash_mod(vid, global_num_servers);
+    }
+
+    uint64_t memory_usage() { return parts.capacity(); }
+};
+
+// the server of vertex @vid (see Partitioner)
+static inline int vid2sid(uint64_t vid)
+{
+    return Partitioner::get().get_sid(vid);
+}
@@ -105,7 +105,10 @@ class Planner {
     data_statistic *statistic ;
     vector<ssid_t> triples;
     double min_cost;
+    double min_results;       // #results of the best order
     vector<ssid_t> path;
+    vector<double> path_results;     // estimated #results after each step of path
+    vector<double> min_path_results; // estimated #results after each step of min_path
     bool is_empty;            // help identify empty queries
 
     vector<int> pred_chains ; //the pred_type chains
@@ -121,6 +124,9 @@ class Planner {
     // functions
     // dfs traverse , traverse all the valid orders
     bool com_traverse(unsigned int pt_bits, double cost, double pre_results) {
+        if (path.size() > 0)
+            path_results[path.size() / 4 - 1] = pre_results;
+
         if (pt_bits == ( 1 << _chains_size_div_4 ) - 1) {
             //cout << "estimated cost : " << cost << endl;
             bool ctn = true;
@@ -133,6 +139,9 @@ class Planner {
             if (cost < min_cost) {
                 min_cost = cost;
                 min_path = path;
+                min_results = pre_results;
+                min_path_results.assign(path_results.begin(),
+                                        path_results.begin() + path.size() / 4);
             }
             return ctn;
         }
@@ -445,6 +454,130 @@ class Planner {
         min_select_record[0] -= lastnum + 1;
     }
 
+    // find the best order of @chains by com_traverse, and return its cost
+    double traverse(vector<ssid_t> &chains) {
+        path.clear();
+        min_path.clear();
+        min_cost = std::numeric_limits<double>::max();
+        min_results = 0;
+        path_results.assign(chains.size() / 4 + 1, 0); // may start from an index
+        min_path_results.clear();
+
+        this->triples = chains;
+        this->min_select = new unordered_map<int, shared_ptr<Minimum_maintenance<select_record>>>;
+        _chains_size_div_4 = chains.size() / 4 ;
+        min_select_record = new int[1 + 6 * _chains_size_div_4];
+        min_select_record[0] = 0;
+        com_traverse(0, 0, 0);
+        delete [] min_select_record ;
+        delete this->min_select;
+        return min_cost;
+    }
+
+    // reorder a chain "C1 p1 ?a . ?a p2 ?b ... ?z pn C2" from C1 to C2,
+    // return false if @chains is not such a chain
+    bool order_chain(vector<ssid_t> &chains, vector<ssid_t> &ordered) {
+        int n = chains.size() / 4;
+        if (n < 2) return false;
+
+        // the number of occurrences of constants and variables
+        boost::unordered_map<ssid_t, int> degree;
+        for (int i = 0; i < n; i++) {
+            ssid_t s = chains[4 * i], p = chains[4 * i + 1], o = chains[4 * i + 3];
+            if (p < 0 || p == TYPE_ID || s == o) return false;
+            // constants should be normal vertices (not index vertices)
+            if ((s >= 0 && s < (1 << NBITS_IDX)) || (o >= 0 && o < (1 << NBITS_IDX)))
+                return false;
+            degree[s]++;
+            degree[o]++;
+        }
+
+        ssid_t cur = BLANK_ID;
+        int nconsts = 0;
+        for (auto const &e : degree) {
+            if (e.first >= 0) {
+                if (e.second != 1) return false;
+                if (nconsts++ == 0) cur = e.first;
+            } else if (e.second != 2) {
+                return false;
+            }
+        }
+        if (nconsts != 2) return false;
+
+        // walk from one constant to another
+        vector<bool> used(n, false);
+        ordered.clear();
+        for (int k = 0; k < n; k++) {
+            int i = 0;
+            while (i < n && (used[i] || (chains[4 * i] != cur && chains[4 * i + 3] != cur)))
+                i++;
+            if (i == n) return false; // not connected
+
+            used[i] = true;
+            ordered.insert(ordered.end(), chains.begin() + 4 * i, chains.begin() + 4 * i + 4);
+            cur = (chains[4 * i] == cur) ? chains[4 * i + 3] : chains[4 * i];
+        }
+        return true;
+    }
+
+    // cost the bidirectional (meet-in-the-middle) plans of a chain with constants at both ends
+    // against the best one-sided plan (i.e., min_cost and min_path). Each half of the chain
+    // is explored from its own constant, and the results of both halves are joined on the
+    // shared variable, which costs the sum of #results of both halves.
+    void plan_meet(vector<ssid_t> &chains, int *meet_step) {
+        vector<ssid_t> ordered;
+        if (!order_chain(chains, ordered)) return;
+
+        // the constant at the other end of the chain
+        int n = ordered.size() / 4;
+        ssid_t last = (ordered[4 * n - 4] >= 0) ? ordered[4 * n - 4] : ordered[4 * n - 1];
+
+        // the traversals of halves only estimate the sub-plans, and should not
+        // mark the whole query as empty
+        bool empty = is_empty;
+
+        double best_cost = min_cost;
+        vector<ssid_t> best_path = min_path;
+        vector<double> best_results = min_path_results;
+        int best_step = -1;
+
+        for (int k = 1; k < n; k++) {
+            vector<ssid_t> left(ordered.begin(), ordered.begin() + 4 * k);
+            // the right half starts from the other constant
+            vector<ssid_t> right;
+            for (int i = n - 1; i >= k; i--)
+                right.insert(right.end(), ordered.begin() + 4 * i, ordered.begin() + 4 * i + 4);
+
+            double cost = traverse(left) + min_results;
+            vector<ssid_t> left_path = min_path;
+            vector<double> left_results = min_path_results;
+            cost += traverse(right) + min_results;
+            is_empty = empty;
+
+            // the right half must start from the other constant (not from an index)
+            if (min_path.empty() || min_path[0] != last)
+                continue;
+
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_path = left_path;
+                best_path.insert(best_path.end(), min_path.begin(), min_path.end());
+                best_results = left_results;
+                best_results.insert(best_results.end(),
+                                    min_path_results.begin(), min_path_results.end());
+                best_step = left_path.size() / 4; // the left half may start from an index
+            }
+        }
+
+        min_cost = best_cost;
+        min_path = best_path;
+        min_path_results = best_results;
+        *meet_step = best_step;
+        if (best_step > 0)
+            logstream(LOG_DEBUG) << "use bidirectional plan (meet at step "
+                                 << best_step << ")." << LOG_endl;
+    }
+
     // remove the attr pattern query before doing the planner and transfer pattern to cmd_chains
     void transfer_to_cmd_chains(vector<SPARQLQuery::Pattern> &p, vector<ssid_t> &attr_pattern, vector<int>& attr_pred_chains, vector<ssid_t> &temp_cmd_chains) {
         for (int i = 0; i < p.size(); i++) {
@@ -467,20 +600,22 @@ class Planner {
     }
 
 public:
+    // the estimation of the plan for top-level patterns (e.g., for explain)
+    double est_cost = 0;
+    vector<double> est_results; // #results after each step
+
     Planner() { }
 
-    bool generate_for_patterns(vector<SPARQLQuery::Pattern> &patterns) {
+    // @meet_step: the step to meet for a bidirectional plan (-1 means one-sided),
+    //             NULL means the bidirectional plan is not considered
+    bool generate_for_patterns(vector<SPARQLQuery::Pattern> &patterns, int *meet_step = NULL) {
         // transfer from patterns to temp_cmd_chains, may cause performance decrease
         vector<ssid_t> temp_cmd_chains;
         vector<ssid_t> attr_pattern;
         vector<int> attr_pred_chains;
         transfer_to_cmd_chains(patterns, attr_pattern, attr_pred_chains, temp_cmd_chains);
-        min_path.clear();
-        path.clear();
         is_empty = false;
-        double cost = 0;
-        min_cost = std::numeric_limits<double>::max();
-        if (min_cost != std::numeric_limits<double>::max()) ASSERT(false);
+        if (meet_step != NULL) *meet_step = -1;
 
         uint64_t t_prepare1 = timer::get_usec();
         // prepare for heuristic
@@ -507,14 +642,10 @@ public:
         //cout << "prepare time : " << t_prepare2 - t_prepare1 << " us" << endl;
 
         uint64_t t_traverse1 = timer::get_usec();
-        this->triples = temp_cmd_chains;
-        this->min_select = new unordered_map<int, shared_ptr<Minimum_maintenance<select_record>>>;
-        _chains_size_div_4 = temp_cmd_chains.size() / 4 ;
-        min_select_record = new int[1 + 6 * _chains_size_div_4];
-        min_select_record[0] = 0;
-        com_traverse(0, cost, 0);
-        delete [] min_select_record ;
-        delete this->min_select;
+        traverse(temp_cmd_chains);
+        // small queries have no need to meet in the middle
+        if (meet_step != NULL && attr_pred_chains.size() == 0 && min_cost >= COST_THRESHOLD)
+            plan_meet(temp_cmd_chains, meet_step);
         uint64_t t_traverse2 = timer::get_usec();
         //cout << "traverse time : " << t_traverse2 - t_traverse1 << " us" << endl;
 
@@ -524,6 +655,11 @@ public:
             return false;
         }
 
+        if (meet_step != NULL) {
+            est_cost = min_cost;
+            est_results = min_path_results;
+        }
+
         logstream(LOG_DEBUG) << "Query planning for one part is finished." << LOG_endl;
         logstream(LOG_DEBUG) << "Estimated cost: " << min_cost << LOG_endl;
 
@@ -553,10 +689,10 @@ public:
         return true;
     }
 
-    bool generate_for_group(SPARQLQuery::PatternGroup &group) {
+    bool generate_for_group(SPARQLQuery::PatternGroup &group, int *meet_step = NULL) {
         bool success = true;
         if (group.patterns.size() > 0)
-            success = generate_for_patterns(group.patterns);
+            success = generate_for_patterns(group.patterns, meet_step);
         for (auto &g : group.unions)
             success = generate_for_group(g);
         return success;
@@ -564,6 +700,7 @@ public:
 
     bool generate_plan(SPARQLQuery &r, data_statistic *statistic) {
         this->statistic = statistic;
-        return generate_for_group(r.pattern_group);
+        est_cost = 0;
+        return generate_for_group(r.pattern_group, &r.meet_step);
     }
 };
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include "config.hpp"
+#include "type.hpp"
+#include "unit.hpp"
+#include "result_cache.hpp"
+
+using namespace std;
+
+/**
+ * A cache of materialized prefixes of queries on a server (shared by its engines)
+ *
+ * Many queries start from an index or a constant vertex, and then filter the
+ * start variable by constants, e.g., ?X rdf:type ub:GraduateStudent and
+ * ?X ub:takesCourse <Course1>. The key is the canonicalized patterns of such
+ * a prefix (see Engine::prefix_key), and the entry is the (sorted) IDs of the
+ * start variable on this server. The entries are tagged by the data version
+ * (see result_cache.hpp), so all of them are stale after a dynamic load.
+ * The total size of entries is bounded by global_prefix_cache_mb, and the least
+ * recently used ones are evicted first.
+ */
+class Prefix_Cache {
+private:
+    struct Entry {
+        vector<sid_t> ids;
+        uint64_t version;
+        uint64_t bytes;
+        uint64_t tick;
+    };
+
+    pthread_spinlock_t lock;
+    unordered_map<string, Entry> entries;
+    map<uint64_t, string> ticks;  // the order of eviction (LRU)
+
+    uint64_t tick = 0;
+    uint64_t bytes = 0;
+
+    void erase(unordered_map<string, Entry>::iterator it) {
+        ticks.erase(it->second.tick);
+        bytes -= it->second.bytes;
+        entries.erase(it);
+    }
+
+public:
+    struct Stats {
+        uint64_t nlookups = 0;
+        uint64_t nhits = 0;
+        uint64_t nstales = 0;     // #entries invalidated by dynamic loads
+        uint64_t nevictions = 0;  // #entries evicted due to the memory budget
+    } stats;
+
+    Prefix_Cache() { pthread_spin_init(&lock, 0); }
+
+    static bool enabled() { return global_prefix_cache_mb > 0; }
+
+    // lookup the IDs of the prefix with @key on the data @version
+    bool lookup(const string &key, uint64_t version, vector<sid_t> &ids) {
+        pthread_spin_lock(&lock);
+        stats.nlookups++;
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            pthread_spin_unlock(&lock);
+            return false;
+        }
+
+        if (it->second.version != version) { // stale
+            stats.nstales++;
+            erase(it);
+            pthread_spin_unlock(&lock);
+            return false;
+        }
+
+        stats.nhits++;
+        Entry &e = it->second;
+        ticks.erase(e.tick);
+        e.tick = ++tick;
+        ticks[e.tick] = key;
+        ids.assign(e.ids.begin(), e.ids.end());
+        pthread_spin_unlock(&lock);
+        return true;
+    }
+
+    // insert the IDs of the prefix with @key, which started on the data @version
+    void insert(const string &key, uint64_t version, const vector<sid_t> &ids) {
+        uint64_t budget = MiB2B((uint64_t)global_prefix_cache_mb);
+        uint64_t sz = key.size() + ids.size() * sizeof(sid_t) + sizeof(Entry);
+        if (sz > budget) return; // too large
+
+        // sort out of the lock (also helps the dedup of consecutive vertices)
+        vector<sid_t> sorted(ids);
+        sort(sorted.begin(), sorted.end());
+
+        pthread_spin_lock(&lock);
+        auto it = entries.find(key);
+        if (it != entries.end())
+            erase(it);
+
+        while (bytes + sz > budget && !ticks.empty()) {
+            stats.nevictions++;
+            erase(entries.find(ticks.begin()->second));
+        }
+
+        Entry &e = entries[key];
+        e.ids.swap(sorted);
+        e.version = version;
+        e.bytes = sz;
+        e.tick = ++tick;
+        ticks[e.tick] = key;
+        bytes += sz;
+        pthread_spin_unlock(&lock);
+    }
+
+    uint64_t size() { return entries.size(); }
+
+    uint64_t memory_usage() { return bytes; }
+};
+
+// the prefix cache of each server (indexed by server ID)
+std::vector<Prefix_Cache> prefix_caches;
@@ -25,6 +25,11 @@
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
 #include <unistd.h>
+#include <map>
+#include <tuple>
+#include <sstream>
+#include <iomanip>
+#include <random>
 
 #include "config.hpp"
 #include "coder.hpp"
@@ -35,16 +40,22 @@
 #include "data_statistic.hpp"
 #include "string_server.hpp"
 #include "monitor.hpp"
+#include "metrics.hpp"
+#include "result_cache.hpp"
+#include "hot_vertex.hpp"
+#include "load_board.hpp"
 
 #include "mymath.hpp"
 #include "timer.hpp"
 
 using namespace std;
 
+#define MAX_SEND_BURST 64 // max #queries sent at once by the open-loop emulator
 
-// a vector of pointers of all local proxies
+
+// vectors of pointers of all local proxies (indexed by server ID)
 class Proxy;
-std::vector<Proxy *> proxies;
+std::vector<std::vector<Proxy *>> proxies;
 
 class Proxy {
 
@@ -61,6 +72,35 @@ private:
 
     vector<Message> pending_msgs; // pending msgs to send
 
+    Result_Cache cache; // the results of queries (see global_result_cache_mb)
+
+    Load_View loads;    // the loads of engines (see global_enable_load_routing)
+
+    // the end-to-end latency of the queries answered by engines (e.g., to compare
+    // the latency with the CPU time saved by dormant engines, see elastic.hpp)
+    uint64_t nanswers = 0;
+    uint64_t latency_usec = 0;
+
+    inline void record_latency(uint64_t latency) {
+        nanswers++;
+        latency_usec += latency;
+    }
+
+    // lookup the @result of query @r on the data @version in the cache, and return the key
+    // of the query to insert its result later (empty if the query can't be cached)
+    string lookup_cache(SPARQLQuery &r, uint64_t version, bool &hit,
+                        SPARQLQuery::Result &result, Monitor &monitor) {
+        hit = false;
+        if (!Result_Cache::enabled()) return "";
+
+        string key = Result_Cache::get_key(r);
+        if (key.empty()) return "";
+
+        hit = cache.lookup(key, version, result);
+        monitor.record_cache(hit);
+        return key;
+    }
+
     // Collect candidate constants of all template types in given template query.
     // Result is in ptypes_grp of given template query.
     void fill_template(SPARQLQuery_Template &sqt) {
@@ -107,20 +147,37 @@ private:
 
     // Send given bundle to certain engine in given server(@dst_sid).
     // Return false if it fails. Bundle is pending in pending_msgs.
-    inline bool send(Bundle &bundle, int dst_sid) {
+    inline bool send(Bundle &bundle, int dst_sid, bool heavy = false) {
         // NOTE: the partitioned mapping has better tail latency in batch mode
-        int range = global_num_engines / global_num_proxies;
-        // FIXME: BUG if global_num_engines < global_num_proxies
-        ASSERT(range > 0);
-
-        int base = global_num_proxies + (range * tid);
-        // randomly choose engine without preferred one
-        int dst_eid = coder.get_random() % range;
+        //       (proxies share engines if there are more proxies than engines)
+        int range = max(1, global_num_engines / global_num_proxies);
+        int base = global_num_proxies + (range * tid) % global_num_engines;
+        // the load-aware routing chooses from all engines
+        if (global_enable_load_routing) {
+            range = global_num_engines;
+            base = global_num_proxies;
+        }
+        // heavy queries never go to the engines reserved for light queries
+        if (heavy && global_enable_query_class && global_light_engines > 0) {
+            range = global_num_engines - global_light_engines;
+            base = global_num_proxies + global_light_engines;
+        }
+        // choose the less loaded one of two random engines (see load_board.hpp),
+        // or randomly choose engine without preferred one (or the loads of the server)
+        bool routed = global_enable_load_routing && loads.has_view(dst_sid);
+        int dst_eid = routed ?
+                      loads.choose(dst_sid, base, range, coder) - base :
+                      coder.get_random() % range;
 
         // If the preferred engine is busy, try the rest engines with round robin
-        for (int i = 0; i < range; i++)
-            if (adaptor->send(dst_sid, base + (dst_eid + i) % range, bundle))
+        for (int i = 0; i < range; i++) {
+            int dst_tid = base + (dst_eid + i) % range;
+            if (adaptor->send(dst_sid, dst_tid, bundle)) {
+                if (routed)
+                    loads.account(dst_sid, dst_tid);
                 return true;
+            }
+        }
 
         pending_msgs.push_back(Message(dst_sid, (base + dst_eid), bundle));
         return false;
@@ -141,6 +198,100 @@ private:
         }
     }
 
+    string id2name(ssid_t id) {
+        if (id < 0) return "?" + to_string(-id); // variable
+        if (str_server->exist(id)) return str_server->id2str[id];
+        return to_string(id);
+    }
+
+    // EXPLAIN: print the order of patterns with estimated #results of each step
+    void print_plan(SPARQLQuery &r) {
+        vector<SPARQLQuery::Pattern> &patterns = r.pattern_group.patterns;
+        vector<double> &est = planner.est_results;
+        bool has_est = global_enable_planner && (est.size() > 0);
+
+        logstream(LOG_INFO) << "Query plan" << (has_est ? "" : " (w/o estimation)")
+                            << ":" << LOG_endl;
+        for (int i = 0; i < patterns.size(); i++) {
+            SPARQLQuery::Pattern &p = patterns[i];
+            if (i == r.meet_step)
+                logstream(LOG_INFO) << "  --- meet in the middle (from the other end) ---"
+                                    << LOG_endl;
+
+            stringstream ss;
+            ss << "  step " << i << ": " << id2name(p.subject) << " "
+               << id2name(p.predicate) << " " << ((p.direction == IN) ? "<-" : "->")
+               << " " << id2name(p.object);
+            if (p.pred_type != 0)
+                ss << " (attr)";
+            if (has_est && i < est.size())
+                ss << "  [est. #rows: " << (uint64_t)est[i] << "]";
+            if (i == r.count_step)
+                ss << "  [count-only]";
+            logstream(LOG_INFO) << ss.str() << LOG_endl;
+        }
+        if (has_est)
+            logstream(LOG_INFO) << "Estimated cost: " << planner.est_cost << LOG_endl;
+        logstream(LOG_INFO) << "Query class: "
+                            << (r.qclass == SPARQLQuery::SQ_HEAVY ? "heavy" : "light") << LOG_endl;
+        if (r.has_union() || r.has_optional() || r.has_filter())
+            logstream(LOG_INFO) << "(followed by "
+                                << r.pattern_group.unions.size() << " unions, "
+                                << r.pattern_group.optional.size() << " optionals and "
+                                << r.pattern_group.filters.size() << " filters)" << LOG_endl;
+    }
+
+    // PROFILE: aggregate the profiles of all (sub-)queries by steps
+    void print_profile(SPARQLQuery &r) {
+        struct Stat {
+            int nqueries = 0;           // #(sub-)queries running the step
+            uint64_t max_time = 0, sum_time = 0;
+            uint64_t in_rows = 0, out_rows = 0;
+            uint64_t local_fetches = 0, remote_fetches = 0, cache_hits = 0;
+            uint64_t remote_bytes = 0, shipped_bytes = 0;
+        };
+
+        // ordered by (PGType, step, kind)
+        map<tuple<int, int, int>, Stat> steps;
+        for (auto const &p : r.profiles) {
+            Stat &s = steps[make_tuple(p.pg_type, p.step, p.kind)];
+            s.nqueries++;
+            s.max_time = max(s.max_time, p.time);
+            s.sum_time += p.time;
+            s.in_rows += p.in_rows;
+            s.out_rows += p.out_rows;
+            s.local_fetches += p.local_fetches;
+            s.remote_fetches += p.remote_fetches;
+            s.cache_hits += p.cache_hits;
+            s.remote_bytes += p.remote_bytes;
+            s.shipped_bytes += p.shipped_bytes;
+        }
+
+        const char *pg_names[] = {"", "union ", "optional "};
+        stringstream ss;
+        ss << left << setw(18) << "step" << right
+           << setw(6) << "#qs" << setw(12) << "max(us)" << setw(12) << "sum(us)"
+           << setw(12) << "in_rows" << setw(12) << "out_rows"
+           << setw(10) << "local" << setw(10) << "remote" << setw(10) << "cached"
+           << setw(12) << "rdma(B)" << setw(12) << "shipped(B)";
+        logstream(LOG_INFO) << "Query profile:" << LOG_endl;
+        logstream(LOG_INFO) << ss.str() << LOG_endl;
+        for (auto const &e : steps) {
+            const Stat &s = e.second;
+            string name = string(pg_names[get<0>(e.first)])
+                          + ((get<2>(e.first) == SPARQLQuery::Profile::WAIT) ? "wait@" : "")
+                          + to_string(get<1>(e.first));
+            ss.str("");
+            ss << left << setw(18) << name << right
+               << setw(6) << s.nqueries << setw(12) << s.max_time << setw(12) << s.sum_time
+               << setw(12) << s.in_rows << setw(12) << s.out_rows
+               << setw(10) << s.local_fetches << setw(10) << s.remote_fetches
+               << setw(10) << s.cache_hits
+               << setw(12) << s.remote_bytes << setw(12) << s.shipped_bytes;
+            logstream(LOG_INFO) << ss.str() << LOG_endl;
+        }
+    }
+
 public:
     int sid;    // server id
     int tid;    // thread id
@@ -154,13 +305,26 @@ public:
     data_statistic *statistic; // for planner
 
 
-    Proxy(int sid, int tid, String_Server *str_server,
+    Proxy(int sid, int tid, Mem *mem, String_Server *str_server,
           Adaptor *adaptor, data_statistic *statistic)
-        : sid(sid), tid(tid), str_server(str_server), adaptor(adaptor),
+        : loads(sid, tid, mem), sid(sid), tid(tid), str_server(str_server), adaptor(adaptor),
           coder(sid, tid), parser(str_server), statistic(statistic) { }
 
     void setpid(SPARQLQuery &r) { r.pid = coder.get_and_inc_qid(); }
 
+    // add the counters of the proxy to @m
+    void collect_metrics(Metrics &m) {
+        m.add("result_cache_lookups_total", Metrics::COUNTER, sid, tid, cache.stats.nlookups);
+        m.add("result_cache_hits_total", Metrics::COUNTER, sid, tid, cache.stats.nhits);
+        m.add("result_cache_stales_total", Metrics::COUNTER, sid, tid, cache.stats.nstales);
+        m.add("result_cache_evictions_total", Metrics::COUNTER, sid, tid, cache.stats.nevictions);
+        m.add("result_cache_entries", Metrics::GAUGE, sid, tid, cache.size());
+        m.add("mem_result_cache_bytes", Metrics::GAUGE, sid, tid, cache.memory_usage());
+        m.add("load_board_reads_total", Metrics::COUNTER, sid, tid, loads.nrefreshes);
+        m.add("query_answers_total", Metrics::COUNTER, sid, tid, nanswers);
+        m.add("query_latency_usec_total", Metrics::COUNTER, sid, tid, latency_usec);
+    }
+
     void setpid(RDFLoad &r) { r.pid = coder.get_and_inc_qid(); }
 
     void setpid(GStoreCheck &r) { r.pid = coder.get_and_inc_qid(); }
@@ -170,9 +334,27 @@ public:
         ASSERT(r.pid != -1);
 
         // submit the request to a certain server
-        int start_sid = mymath::hash_mod(r.pattern_group.get_start(), global_num_servers);
+        ssid_t start = r.pattern_group.get_start();
+        int start_sid = vid2sid(start);
+        // the local replica of a hot vertex also serves the query (see hot_vertex.hpp)
+        if (start_sid != sid && hot_vertices[sid].is_replica(start))
+            start_sid = sid;
         Bundle bundle(r);
-        send(bundle, start_sid);
+        send(bundle, start_sid, r.qclass == SPARQLQuery::SQ_HEAVY);
+    }
+
+    // Set the class of the query for scheduling on engines. The class declared by
+    // the client (@declared >= 0) is preferred, otherwise the query is heavy if it
+    // starts from an index vertex or its estimated cost (by the planner) is high.
+    void set_query_class(SPARQLQuery &r, int declared = -1) {
+        if (declared >= 0) {
+            r.qclass = (SPARQLQuery::SQClass)declared;
+            return;
+        }
+
+        bool heavy = r.start_from_index()
+                     || (global_enable_planner && planner.est_cost >= global_heavy_query_cost);
+        r.qclass = heavy ? SPARQLQuery::SQ_HEAVY : SPARQLQuery::SQ_LIGHT;
     }
 
     // Recv reply from engines.
@@ -198,8 +380,12 @@ public:
     // Run a single query for @cnt times. Command is "-f"
     // @is: input
     // @reply: result
+    // @explain: only print the plan (w/o execution)
+    // @profile: profile the last run
+    // @qclass: the class of the query (-1 means estimated, see set_query_class)
     int run_single_query(istream &is, int mt_factor, int cnt,
-                         SPARQLQuery &reply, Monitor &monitor) {
+                         SPARQLQuery &reply, Monitor &monitor,
+                         bool explain = false, bool profile = false, int qclass = -1) {
         uint64_t start, end;
         SPARQLQuery request;
 
@@ -217,6 +403,7 @@ public:
 
         // Generate plans for the query if our SPARQL planner is enabled.
         // NOTE: it only works for standard SPARQL query.
+        planner.est_results.clear();
         if (global_enable_planner) {
             start = timer::get_usec();
             bool exec = planner.generate_plan(request, statistic);
@@ -228,6 +415,17 @@ public:
                 return 0; // skip the real execution
         }
 
+        // Plan the lifetime of variables for dead-column elimination,
+        // and the trailing patterns for count-only execution
+        request.plan_var_lifetime();
+        request.plan_count_step();
+        set_query_class(request, qclass);
+
+        if (explain || profile)
+            print_plan(request);
+        if (explain)
+            return 0; // skip the real execution
+
         // Execute the SPARQL query
         monitor.init();
         for (int i = 0; i < cnt; i++) {
@@ -244,19 +442,42 @@ public:
             }
 
             // only take back results of the last request if not silent
-            request.result.blind = i < (cnt - 1) ? true : global_silent;
+            // NOTE: COUNT query only takes back the number of results
+            request.result.blind = i < (cnt - 1) ? true : (global_silent || request.count);
+            request.profile = profile && (i == cnt - 1);
+
+            // reuse the result of the same query on the same data
+            bool hit;
+            SPARQLQuery::Result result;
+            uint64_t version = get_data_version(sid);
+            string key = lookup_cache(request, version, hit, result, monitor);
+            if (hit) {
+                reply = request;
+                reply.result = result;
+                continue;
+            }
+
+            uint64_t begin = timer::get_usec();
             send_request(request);
             reply = recv_reply();
+            record_latency(timer::get_usec() - begin);
+            if (!key.empty())
+                cache.insert(key, version, reply.result);
         }
         monitor.finish();
+
+        if (profile)
+            print_profile(reply);
         return 0; // success
     } // end of run_single_query
 
     // Run a query emulator for @d seconds. Command is "-b"
     // Warm up for @w firstly, then measure throughput.
     // Latency is evaluated for @d seconds.
-    // Proxy keeps @p queries in flight.
-    int run_query_emu(istream &is, int d, int w, int p, Monitor &monitor) {
+    // Proxy keeps @p queries in flight (closed-loop), or sends @rate queries/sec
+    // regardless of replies (open-loop) if @rate > 0.
+    int run_query_emu(istream &is, int d, int w, int p, Monitor &monitor,
+                      int rate = 0, bool poisson = true) {
         uint64_t duration = SEC(d);
         uint64_t warmup = SEC(w);
         int parallel_factor = p;
@@ -311,32 +532,84 @@ public:
                 fill_template(tpls[i]);
         }
 
-        monitor.init(ntypes);
+        monitor.init(ntypes, nlights);
 
         bool start = false; // start to measure throughput
         uint64_t send_cnt = 0, recv_cnt = 0, flying_cnt = 0;
 
-        uint64_t init = timer::get_usec();
-        // send requeries for duration seconds
-        while ((timer::get_usec() - init) < duration) {
-            // send requests
-            for (int i = 0; i < parallel_factor - flying_cnt; i++) {
-                sweep_msgs(); // sweep pending msgs first
+        // the queries to be cached when their replies arrive (pid -> (key, data version))
+        unordered_map<int, pair<string, uint64_t>> cache_keys;
+
+        // generate and send a query, whose latency starts from @intended (usec)
+        auto send_query = [&](uint64_t intended) {
+            sweep_msgs(); // sweep pending msgs first
 
-                int idx = mymath::get_distribution(coder.get_random(), loads);
-                SPARQLQuery request = idx < nlights ?
-                                      tpls[idx].instantiate(coder.get_random()) : // light query
-                                      heavy_reqs[idx - nlights]; // heavy query
+            int idx = mymath::get_distribution(coder.get_random(), loads);
+            SPARQLQuery request = idx < nlights ?
+                                  tpls[idx].instantiate(coder.get_random()) : // light query
+                                  heavy_reqs[idx - nlights]; // heavy query
 
-                if (global_enable_planner)
-                    planner.generate_plan(request, statistic);
-                setpid(request);
-                request.result.blind = true; // always not take back results for emulator
+            if (global_enable_planner)
+                planner.generate_plan(request, statistic);
+            request.plan_var_lifetime();
+            request.plan_count_step();
+            set_query_class(request, idx < nlights ? SPARQLQuery::SQ_LIGHT : SPARQLQuery::SQ_HEAVY);
+            setpid(request);
+            request.result.blind = true; // always not take back results for emulator
+
+            monitor.start_record(request.pid, idx, intended);
+
+            // the result of the same query on the same data is replied at once
+            bool hit;
+            SPARQLQuery::Result result;
+            uint64_t version = get_data_version(sid);
+            string key = lookup_cache(request, version, hit, result, monitor);
+            if (hit) {
+                recv_cnt++;
+                monitor.end_record(request.pid);
+                return;
+            }
+            if (!key.empty())
+                cache_keys[request.pid] = make_pair(key, version);
 
-                monitor.start_record(request.pid, idx);
-                send_request(request);
+            send_request(request);
+        };
+
+        // cache the result of the reply @r (if needed)
+        auto cache_reply = [&](SPARQLQuery & r) {
+            auto it = cache_keys.find(r.pid);
+            if (it == cache_keys.end()) return;
+            cache.insert(it->second.first, it->second.second, r.result);
+            cache_keys.erase(it);
+        };
+
+        // open-loop: the (intended) send time of queries follows a Poisson process
+        // or a constant interval, which is independent of replies
+        std::mt19937 rng(coder.get_random());
+        std::exponential_distribution<double> exp_dist(rate > 0 ? rate : 1);
+        auto next_interval = [&]() -> uint64_t {
+            return poisson ? (uint64_t)(exp_dist(rng) * SEC(1)) : SEC(1) / rate;
+        };
 
-                send_cnt++;
+        uint64_t init = timer::get_usec();
+        uint64_t next_send = init; // the intended time of the next query (open-loop)
+        // send requeries for duration seconds
+        while ((timer::get_usec() - init) < duration) {
+            // send requests
+            if (rate > 0) {
+                // NOTE: the queries late for their intended time are sent in a burst
+                //       (limited by MAX_SEND_BURST), and their latency includes the delay
+                uint64_t now = timer::get_usec();
+                for (int i = 0; i < MAX_SEND_BURST && next_send <= now; i++) {
+                    send_query(next_send);
+                    next_send += next_interval();
+                    send_cnt++;
+                }
+            } else {
+                for (int i = 0; i < parallel_factor - flying_cnt; i++) {
+                    send_query(timer::get_usec());
+                    send_cnt++;
+                }
             }
 
             // recieve replies (best of effort)
@@ -344,7 +617,8 @@ public:
                 SPARQLQuery r;
                 while (tryrecv_reply(r)) {
                     recv_cnt++;
-                    monitor.end_record(r.pid);
+                    record_latency(monitor.end_record(r.pid));
+                    cache_reply(r);
                 }
             }
 
@@ -368,7 +642,8 @@ public:
             SPARQLQuery r;
             while (tryrecv_reply(r)) {
                 recv_cnt ++;
-                monitor.end_record(r.pid);
+                record_latency(monitor.end_record(r.pid));
+                cache_reply(r);
             }
 
             monitor.print_timely_thpt(recv_cnt, sid, tid);
@@ -400,6 +675,20 @@ public:
                 ret = reply.load_ret;
         }
 
+        // publish the new data after all servers have loaded it, since a server
+        // may have read a remote server in loading (e.g., cached results and replicas)
+        request.publish = true;
+        setpid(request);
+        for (int i = 0; i < global_num_servers; i++) {
+            Bundle bundle(request);
+            send(bundle, i);
+        }
+
+        for (int i = 0; i < global_num_servers; i++) {
+            Bundle bundle = adaptor->recv();
+            ASSERT(bundle.type == DYNAMIC_LOAD);
+        }
+
         monitor.finish();
         return ret;
     }
@@ -431,3 +720,15 @@ public:
 
     }
 };
+
+// collect the metrics of all local proxies of the server
+static void collect_proxy_metrics(int sid, Metrics &m)
+{
+    // NOTE: all proxies of a server share the statistics of the planner
+    if (!proxies[sid].empty() && proxies[sid][0]->statistic != NULL)
+        m.add("mem_statistic_bytes", Metrics::GAUGE, sid, -1,
+              proxies[sid][0]->statistic->memory_usage());
+
+    for (auto p : proxies[sid])
+        p->collect_metrics(m);
+}
@@ -31,6 +31,8 @@
 #include <boost/serialization/split_free.hpp>
 #include <set>
 #include <vector>
+#include <climits>
+#include <boost/unordered_map.hpp>
 
 #include "type.hpp"
 
@@ -80,6 +82,13 @@ public:
      */
     enum PGType { BASIC, UNION, OPTIONAL };
 
+    /*
+     * The class of a query for scheduling on engines (see Engine::run).
+     * It is declared by the client or estimated by the proxy (see Proxy::set_query_class),
+     * and all sub-queries inherit the class of the original query.
+     */
+    enum SQClass { SQ_LIGHT = 0, SQ_HEAVY };
+
     class Pattern {
     private:
         friend class boost::serialization::access;
@@ -233,6 +242,40 @@ public:
             : id(_id), descending(_descending) { }
     };
 
+    // the cost of a pattern step (or a fork-join wait) of a (sub-)query in profile mode
+    class Profile {
+    private:
+        friend class boost::serialization::access;
+        template <typename Archive>
+        void serialize(Archive &ar, const unsigned int version) {
+            ar & qid;
+            ar & pg_type;
+            ar & kind;
+            ar & step;
+            ar & time;
+            ar & in_rows;
+            ar & out_rows;
+            ar & local_fetches;
+            ar & remote_fetches;
+            ar & cache_hits;
+            ar & remote_bytes;
+            ar & shipped_bytes;
+        }
+
+    public:
+        enum Kind { STEP, WAIT };
+
+        int qid = -1;       // the (sub-)query (encoding the server and thread, see Coder)
+        int pg_type = 0;    // PGType of the (sub-)query
+        int kind = STEP;
+        int step = 0;       // pattern step
+        uint64_t time = 0;  // usec
+        uint64_t in_rows = 0, out_rows = 0;
+        uint64_t local_fetches = 0, remote_fetches = 0, cache_hits = 0;
+        uint64_t remote_bytes = 0;  // bytes read by RDMA
+        uint64_t shipped_bytes = 0; // bytes of results shipped to other servers
+    };
+
     class Result {
     private:
         friend class boost::serialization::access;
@@ -259,7 +302,7 @@ public:
 
     public:
         int col_num = 0;
-        int row_num = 0;  // FIXME: vs. get_row_num()
+        uint64_t row_num = 0;  // FIXME: vs. get_row_num()
         int attr_col_num = 0; // FIXME: why not no attr_row_num
 
         bool blind = false;
@@ -358,6 +401,12 @@ public:
             return result_table.size() / col_num;
         }
 
+        // the memory footprint of the result tables (in bytes)
+        uint64_t get_bytes() const {
+            return result_table.size() * sizeof(sid_t)
+                   + attr_res_table.size() * sizeof(attr_t);
+        }
+
         sid_t get_row_col(int r, int c) {
             ASSERT(r >= 0 && c >= 0);
             return result_table[col_num * r + c];
@@ -420,9 +469,9 @@ public:
                 }
             }
 
-            int new_size = this->col_num * this->row_num;
+            uint64_t new_size = this->col_num * this->row_num;
             this->result_table.reserve(new_size);
-            for (int i = 0; i < result.row_num; i++) {
+            for (uint64_t i = 0; i < result.row_num; i++) {
                 for (int j = 0; j < this->col_num; j++) {
                     if (col_map[j] == -1)
                         this->result_table.push_back(BLANK_ID);
@@ -437,6 +486,62 @@ public:
                                         result.attr_res_table.end());
         }
 
+        // MEET (bidirectional exploration)
+        // join with the results of the other half of the query on the shared variables
+        void merge_join(SPARQLQuery::Result &result) {
+            ASSERT(this->attr_col_num == 0 && result.attr_col_num == 0);
+            this->v2c_map.resize(this->nvars, NO_RESULT);
+            result.v2c_map.resize(this->nvars, NO_RESULT);
+
+            vector<int> my_cols, your_cols; // the columns of shared variables
+            vector<int> new_cols;           // your columns of new variables
+            for (int i = 0; i < this->nvars; i++) {
+                ssid_t vid = -1 - i;
+                if (result.v2c_map[i] == NO_RESULT)
+                    continue;
+                if (this->v2c_map[i] != NO_RESULT) {
+                    my_cols.push_back(this->var2col(vid));
+                    your_cols.push_back(result.var2col(vid));
+                } else {
+                    this->add_var2col(vid, this->col_num + new_cols.size());
+                    new_cols.push_back(result.var2col(vid));
+                }
+            }
+
+            auto hash_row = [](SPARQLQuery::Result & r, int row, vector<int> &cols) -> size_t {
+                size_t h = 0;
+                for (auto c : cols)
+                    boost::hash_combine(h, r.get_row_col(row, c));
+                return h;
+            };
+
+            // hash join (build on your results)
+            boost::unordered_multimap<size_t, int> ht;
+            for (int j = 0; j < result.get_row_num(); j++)
+                ht.insert(make_pair(hash_row(result, j, your_cols), j));
+
+            vector<sid_t> new_table;
+            for (int i = 0; i < this->get_row_num(); i++) {
+                auto range = ht.equal_range(hash_row(*this, i, my_cols));
+                for (auto it = range.first; it != range.second; it++) {
+                    int j = it->second;
+                    bool matched = true;
+                    for (int c = 0; c < my_cols.size() && matched; c++)
+                        matched = (this->get_row_col(i, my_cols[c])
+                                   == result.get_row_col(j, your_cols[c]));
+                    if (!matched) continue;
+
+                    this->append_row_to(i, new_table);
+                    for (auto c : new_cols)
+                        new_table.push_back(result.get_row_col(j, c));
+                }
+            }
+
+            this->result_table.swap(new_table);
+            this->col_num += new_cols.size();
+            this->row_num = this->get_row_num();
+        }
+
         void append_result(SPARQLQuery::Result &result) {
             this->col_num = result.col_num;
             this->blind = result.blind;
@@ -492,6 +597,7 @@ public:
     SQState state = SQ_PATTERN;
     int mt_factor = 1;  // use a single engine (thread) by default
     int priority = 0;
+    SQClass qclass = SQ_LIGHT;
 
     // Pattern
     int pattern_step = 0;
@@ -516,6 +622,31 @@ public:
     vector<Order> orders;
     Result result;
 
+    // the last pattern step which uses the variable (index: -(vid + 1), value: step)
+    // the column of a variable can be dropped after its last step (see plan_var_lifetime)
+    vector<int> var_last_step;
+
+    // the first step of trailing patterns which can be counted rather than materialized
+    // in blind mode (see plan_count_step), -1 means none
+    int count_step = -1;
+
+    bool count = false; // only return the number of results (e.g., SELECT COUNT), proxy only
+
+    // the patterns before (after) meet_step are explored from the first (last) constant
+    // of a chain concurrently, and both halves are joined in the middle (see Planner::plan_meet),
+    // -1 means one-sided exploration
+    int meet_step = -1;
+
+    // the peak memory footprint of intermediate results (in bytes),
+    // the maximum over all steps and sub-queries
+    uint64_t peak_bytes = 0;
+
+    // PROFILE
+    bool profile = false;     // record the cost of each step
+    vector<Profile> profiles; // collected from all sub-queries
+    int step_base = 0;        // the step of my first pattern in the whole query
+                              // (e.g., the second half of a bidirectional query)
+
     SPARQLQuery() { }
 
     // build a request by existing triple patterns and variables
@@ -539,6 +670,7 @@ public:
     // shrink the query to reduce communication cost (before sending)
     void shrink_query() {
         orders.clear();
+        var_last_step.clear();
         // the first pattern indicating if this query is starting from index. It can't be removed.
         if (pattern_group.patterns.size() > 0)
             pattern_group.patterns.erase(pattern_group.patterns.begin() + 1,
@@ -552,6 +684,115 @@ public:
             result.clear(); // clear data but reserve metadata (e.g., #rows, #cols)
     }
 
+    /// Plan the lifetime of variables once per query (after reordering patterns).
+    /// A variable lives until the last (BGP) pattern using it, while the variables
+    /// required by results, orders, filters, unions and optionals live forever.
+    void plan_var_lifetime() {
+        var_last_step.assign(result.nvars, -1);
+
+        auto use_var = [&](ssid_t vid, int step) {
+            if (vid >= 0) return; // not a variable
+            int idx = - (vid + 1);
+            ASSERT(idx < result.nvars);
+            var_last_step[idx] = max(var_last_step[idx], step);
+        };
+
+        for (int i = 0; i < pattern_group.patterns.size(); i++) {
+            Pattern &p = pattern_group.patterns[i];
+            use_var(p.subject, i);
+            use_var(p.predicate, i);
+            use_var(p.object, i);
+        }
+
+        // pinned variables
+        for (auto vid : result.required_vars)
+            use_var(vid, INT_MAX);
+        for (auto const &o : orders)
+            use_var(o.id, INT_MAX);
+        pin_group_vars(pattern_group, use_var, false);
+    }
+
+    /// Find the trailing patterns which only expand the same KNOWN variable (or the constant
+    /// of the first pattern) to new variables, i.e., "?X P1 ?Y1 . ?X P2 ?Y2 ...". The number
+    /// of results is the sum over rows of the product of the sizes of ?X's neighbor lists.
+    /// NOTE: the count includes duplicate rows, so it is not used by DISTINCT queries
+    void plan_count_step() {
+        count_step = -1;
+        if (has_union() || has_optional() || has_filter() || corun_enabled || meet_step > 0
+                || distinct)
+            return;
+
+        vector<Pattern> &patterns = pattern_group.patterns;
+        int n = patterns.size();
+        if (n == 0) return;
+
+        auto is_var_in = [](ssid_t vid, const Pattern & p) -> bool {
+            return vid < 0 && (p.subject == vid || p.predicate == vid || p.object == vid);
+        };
+
+        ssid_t start = patterns[n - 1].subject;
+        int step = n;
+        while (step > 0) {
+            Pattern &p = patterns[step - 1];
+            if (p.subject != start
+                    || p.predicate < 0 || p.pred_type > 0
+                    || (p.direction != IN && p.direction != OUT)
+                    || p.object >= 0 || p.object == start)
+                break;
+
+            // the new variable should not be used by other patterns
+            bool used = false;
+            for (int i = 0; i < n; i++)
+                if (i != step - 1 && is_var_in(p.object, patterns[i]))
+                    used = true;
+            if (used) break;
+
+            step--;
+        }
+
+        if (step == n) return;
+        if (step == 0 && start < 0) return; // the start should be constant or known
+        if (step > 0 && start >= 0) return; // only the first pattern can start from constant
+        if (step == 0 && start_from_index()) return;
+
+        // the start variable should be bound before counting
+        if (start < 0) {
+            bool bound = false;
+            for (int i = 0; i < step; i++)
+                if (is_var_in(start, patterns[i]))
+                    bound = true;
+            if (!bound) return;
+        }
+
+        count_step = step;
+    }
+
+    template <typename F>
+    void pin_filter_vars(const Filter &f, F &use_var) {
+        if (f.type == Filter::Type::Variable)
+            use_var(f.valueArg, INT_MAX);
+        if (f.arg1 != NULL) pin_filter_vars(*f.arg1, use_var);
+        if (f.arg2 != NULL) pin_filter_vars(*f.arg2, use_var);
+        if (f.arg3 != NULL) pin_filter_vars(*f.arg3, use_var);
+    }
+
+    template <typename F>
+    void pin_group_vars(const PatternGroup &g, F &use_var, bool with_patterns) {
+        if (with_patterns) {
+            for (auto const &p : g.patterns) {
+                use_var(p.subject, INT_MAX);
+                use_var(p.predicate, INT_MAX);
+                use_var(p.object, INT_MAX);
+            }
+        }
+        for (auto const &f : g.filters)
+            pin_filter_vars(f, use_var);
+        for (auto const &u : g.unions)
+            pin_group_vars(u, use_var, true);
+        for (auto const &o : g.optional)
+            pin_group_vars(o, use_var, true);
+    }
+
     bool has_pattern() { return pattern_group.patterns.size() > 0; }
 
     bool has_union() { return pattern_group.unions.size() > 0; }
@@ -630,6 +871,8 @@ public:
     void inherit_union(SPARQLQuery &r, int idx) {
         pid = r.id;
         pg_type = SPARQLQuery::PGType::UNION;
+        qclass = r.qclass;
+        profile = r.profile;
         pattern_group = r.pattern_group.unions[idx];
         if (start_from_index()
                 && (global_mt_threshold * global_num_servers > 1)) {
@@ -639,6 +882,50 @@ public:
         result.blind = false;
     }
 
+    // MEET
+    void inherit_meet(SPARQLQuery &r, int half) {
+        ASSERT(r.meet_step > 0);
+        pid = r.id;
+        priority = r.priority + 1;
+        qclass = r.qclass;
+        distinct = r.distinct;
+        profile = r.profile;
+        step_base = r.step_base + (half == 0 ? 0 : r.meet_step);
+
+        vector<Pattern> &patterns = r.pattern_group.patterns;
+        if (half == 0)
+            pattern_group.patterns.assign(patterns.begin(), patterns.begin() + r.meet_step);
+        else
+            pattern_group.patterns.assign(patterns.begin() + r.meet_step, patterns.end());
+        if (start_from_index()
+                && (global_mt_threshold * global_num_servers > 1)) {
+            mt_factor = r.mt_factor;
+        }
+
+        result.nvars = r.result.nvars;
+        result.v2c_map.resize(result.nvars, NO_RESULT);
+        result.blind = false; // must take back results to join
+
+        // keep the variables shared by both halves and the pinned variables
+        vector<bool> used(result.nvars, false), shared(result.nvars, false);
+        for (int i = 0; i < patterns.size(); i++) {
+            bool mine = (half == 0) == (i < r.meet_step);
+            ssid_t vars[] = {patterns[i].subject, patterns[i].predicate, patterns[i].object};
+            for (auto vid : vars) {
+                if (vid >= 0) continue;
+                int idx = - (vid + 1);
+                if (mine) used[idx] = true;
+                else shared[idx] = true;
+            }
+        }
+        for (int idx = 0; idx < result.nvars; idx++) {
+            if (!used[idx]) continue;
+            if (shared[idx] || r.var_last_step.empty() || r.var_last_step[idx] == INT_MAX)
+                result.required_vars.push_back(- (idx + 1));
+        }
+        plan_var_lifetime();
+    }
+
     // OPTIONAL
 
     // currently only count BGPs in OPTIONAL
@@ -710,6 +997,8 @@ public:
     void inherit_optional(SPARQLQuery &r) {
         pid = r.id;
         pg_type = SPARQLQuery::PGType::OPTIONAL;
+        qclass = r.qclass;
+        profile = r.profile;
         pattern_group = r.pattern_group.optional[r.optional_step];
 
         if (start_from_index()
@@ -814,6 +1103,7 @@ private:
         ar & load_dname;
         ar & load_ret;
         ar & check_dup;
+        ar & publish;
     }
 
 public:
@@ -822,6 +1112,7 @@ public:
     string load_dname = "";   // the file name used to be inserted
     int load_ret = 0;
     bool check_dup = false;
+    bool publish = false;     // all servers have loaded the data (see Proxy::dynamic_load_data)
 
     RDFLoad() { }
 
@@ -950,6 +1241,7 @@ void save(Archive & ar, const SPARQLQuery &t, unsigned int version) {
     ar << t.local_var;
     ar << t.mt_factor;
     ar << t.priority;
+    ar << t.qclass;
     ar << t.state;
     ar << t.pattern_group;
     if (t.orders.size() > 0) {
@@ -958,6 +1250,15 @@ void save(Archive & ar, const SPARQLQuery &t, unsigned int version) {
     } else {
         ar << empty;
     }
+    ar << t.var_last_step;
+    ar << t.count_step;
+    ar << t.meet_step;
+    ar << t.peak_bytes;
+    ar << t.profile;
+    if (t.profile) {
+        ar << t.profiles;
+        ar << t.step_base;
+    }
     ar << t.result;
 }
 
@@ -979,10 +1280,20 @@ void load(Archive & ar, SPARQLQuery &t, unsigned int version) {
     ar >> t.local_var;
     ar >> t.mt_factor;
     ar >> t.priority;
+    ar >> t.qclass;
     ar >> t.state;
     ar >> t.pattern_group;
     ar >> temp;
     if (temp == occupied) ar >> t.orders;
+    ar >> t.var_last_step;
+    ar >> t.count_step;
+    ar >> t.meet_step;
+    ar >> t.peak_bytes;
+    ar >> t.profile;
+    if (t.profile) {
+        ar >> t.profiles;
+        ar >> t.step_base;
+    }
     ar >> t.result;
 }
 
@@ -1001,6 +1312,7 @@ BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Pattern, boost::serialization::object_se
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::PatternGroup, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Filter, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Order, boost::serialization::object_serializable);
+BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Profile, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Result, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(GStoreCheck, boost::serialization::object_serializable);
@@ -1014,6 +1326,7 @@ BOOST_CLASS_TRACKING(SPARQLQuery::Pattern, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery::Filter, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery::PatternGroup, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery::Order, boost::serialization::track_never);
+BOOST_CLASS_TRACKING(SPARQLQuery::Profile, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery::Result, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(GStoreCheck, boost::serialization::track_never);
@@ -31,13 +31,24 @@ using namespace std;
 #include "timer.hpp"
 #include "assertion.hpp"
 
+// the one-sided operations of an RDMA device (offsets are relative to the registered memory)
+class RDMA_Device_Interface {
+public:
+    virtual ~RDMA_Device_Interface() { }
+
+    virtual int RdmaRead(int tid, int nid, char *local, uint64_t sz, uint64_t off) = 0;
+    virtual int RdmaWrite(int tid, int nid, char *local, uint64_t sz, uint64_t off) = 0;
+    virtual int RdmaWriteNonSignal(int tid, int nid, char *local, uint64_t sz, uint64_t off) = 0;
+    virtual int RdmaWriteSelective(int tid, int nid, char *local, uint64_t sz, uint64_t off) = 0;
+};
+
 #ifdef HAS_RDMA
 
 #include "rdmaio.hpp"
 using namespace rdmaio;
 
 class RDMA {
-    class RDMA_Device {
+    class RDMA_Device : public RDMA_Device_Interface {
         static const uint64_t RDMA_CTRL_PORT = 19344;
     public:
         RdmaCtrl* ctrl = NULL;
@@ -134,7 +145,7 @@ class RDMA {
     };
 
 public:
-    RDMA_Device *dev = NULL;
+    RDMA_Device_Interface *dev = NULL;
 
     RDMA() { }
 
@@ -145,7 +156,10 @@ public:
         dev = new RDMA_Device(nnodes, nthds, nid, mem, sz, ipfn);
     }
 
-    inline static bool has_rdma() { return true; }
+    // use an emulated device (e.g., the simulated network, see sim.hpp)
+    void init_emulated_dev(RDMA_Device_Interface *edev) { dev = edev; }
+
+    inline bool has_rdma() { return true; }
 
     static RDMA &get_rdma() {
         static RDMA rdma;
@@ -168,7 +182,7 @@ void RDMA_init(int nnodes, int nthds, int nid,
 #else
 
 class RDMA {
-    class RDMA_Device {
+    class RDMA_Device : public RDMA_Device_Interface {
     public:
         RDMA_Device(int nnodes, int nthds, int nid, char *mem, uint64_t sz, string fname) {
             logstream(LOG_INFO) << "This system is compiled without RDMA support." << LOG_endl;
@@ -201,7 +215,8 @@ class RDMA {
     };
 
 public:
-    RDMA_Device *dev = NULL;
+    RDMA_Device_Interface *dev = NULL;
+    bool emulated = false;
 
     RDMA() { }
 
@@ -211,7 +226,11 @@ public:
         dev = new RDMA_Device(nnodes, nthds, nid, mem, sz, ipfn);
     }
 
-    inline static bool has_rdma() { return false; }
+    // use an emulated device (e.g., the simulated network, see sim.hpp)
+    void init_emulated_dev(RDMA_Device_Interface *edev) { dev = edev; emulated = true; }
+
+    // only an emulated device is available w/o RDMA support
+    inline bool has_rdma() { return emulated; }
 
     static RDMA &get_rdma() {
         static RDMA rdma;
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include "config.hpp"
+#include "query.hpp"
+#include "unit.hpp"
+
+using namespace std;
+
+// the version of the data on each server (indexed by server ID), which is bumped
+// before and after every dynamic load, and once all servers have loaded the data
+// (see Engine::execute_load_data)
+// NOTE: a dynamic load is sent to all servers, so the version of a server also
+//       changes with the data of the whole cluster
+std::vector<uint64_t> data_versions;
+
+static inline uint64_t get_data_version(int sid)
+{
+    return __atomic_load_n(&data_versions[sid], __ATOMIC_ACQUIRE);
+}
+
+static inline void bump_data_version(int sid)
+{
+    __atomic_add_fetch(&data_versions[sid], 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * A cache of query results on a proxy (w/o lock, only used by the proxy itself)
+ *
+ * The key is the planned query (incl. constants, orders, limit/offset and blind),
+ * and the entry records the data version when the query was sent. All entries
+ * of an older version are stale after a dynamic load.
+ * The total size of entries is bounded by global_result_cache_mb, and the entries
+ * are evicted by the least recently used (LRU) or the least frequently used (LFU)
+ * ones (global_result_cache_policy).
+ */
+class Result_Cache {
+private:
+    typedef pair<uint64_t, uint64_t> rank_t;  // (#hits for LFU or 0 for LRU, last used)
+
+    struct Entry {
+        SPARQLQuery::Result result;
+        uint64_t version;
+        uint64_t bytes;
+        uint64_t nhits;
+        rank_t rank;
+    };
+
+    unordered_map<string, Entry> entries;
+    map<rank_t, string> ranks;  // the order of eviction
+
+    uint64_t tick = 0;
+    uint64_t bytes = 0;
+
+    static uint64_t entry_bytes(const string &key, const SPARQLQuery::Result &result) {
+        return key.size() + result.get_bytes() + sizeof(Entry);
+    }
+
+    void touch(const string &key, Entry &e) {
+        ranks.erase(e.rank);
+        e.rank = rank_t(global_result_cache_policy == "lfu" ? e.nhits : 0, ++tick);
+        ranks[e.rank] = key;
+    }
+
+    void erase(unordered_map<string, Entry>::iterator it) {
+        ranks.erase(it->second.rank);
+        bytes -= it->second.bytes;
+        entries.erase(it);
+    }
+
+public:
+    struct Stats {
+        uint64_t nlookups = 0;
+        uint64_t nhits = 0;
+        uint64_t nstales = 0;     // #entries invalidated by dynamic loads
+        uint64_t nevictions = 0;  // #entries evicted due to the memory budget
+    } stats;
+
+    static bool enabled() { return global_result_cache_mb > 0; }
+
+    // the key of the query @r, or empty if the query can't be cached (e.g., profiling)
+    static string get_key(SPARQLQuery &r) {
+        if (r.profile) return "";
+
+        // the query is identified w/o its ID (see SPARQLQuery::pid)
+        int pid = r.pid;
+        r.pid = -1;
+        Bundle bundle(r);
+        r.pid = pid;
+        return bundle.data + (r.count ? "C" : "R");
+    }
+
+    // lookup the result of the query with @key on the data @version
+    bool lookup(const string &key, uint64_t version, SPARQLQuery::Result &result) {
+        stats.nlookups++;
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return false;
+
+        if (it->second.version != version) { // stale
+            stats.nstales++;
+            erase(it);
+            return false;
+        }
+
+        stats.nhits++;
+        it->second.nhits++;
+        touch(key, it->second);
+        result = it->second.result;
+        return true;
+    }
+
+    // insert the result of the query with @key, which was sent on the data @version
+    void insert(const string &key, uint64_t version, const SPARQLQuery::Result &result) {
+        uint64_t budget = MiB2B((uint64_t)global_result_cache_mb);
+        uint64_t sz = entry_bytes(key, result);
+        if (sz > budget) return; // too large
+
+        auto it = entries.find(key);
+        if (it != entries.end())
+            erase(it);
+
+        while (bytes + sz > budget && !ranks.empty()) {
+            stats.nevictions++;
+            erase(entries.find(ranks.begin()->second));
+        }
+
+        Entry &e = entries[key];
+        e.result = result;
+        e.version = version;
+        e.bytes = sz;
+        e.nhits = 0;
+        e.rank = rank_t(0, ++tick);
+        ranks[e.rank] = key;
+        bytes += sz;
+    }
+
+    void clear() {
+        entries.clear();
+        ranks.clear();
+        bytes = 0;
+    }
+
+    uint64_t size() { return entries.size(); }
+
+    uint64_t memory_usage() { return bytes; }
+};
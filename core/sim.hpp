@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <emmintrin.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <boost/mpi.hpp>
+
+#include "config.hpp"
+#include "rdma.hpp"
+#include "timer.hpp"
+#include "assertion.hpp"
+
+using namespace std;
+
+/**
+ * The simulated network of a cluster in a single process
+ *
+ * Each logical server is a group of threads with its own memory (Mem). Messages
+ * (TCP_Adaptor) are delivered through in-memory mailboxes, and one-sided RDMA
+ * operations (RDMA_Adaptor and remote graph accesses) are emulated by memcpy on
+ * the registered memory of the target server.
+ *
+ * The injected cost of a transfer is global_sim_latency_us plus its size over
+ * global_sim_bandwidth_mbps, and the transfers to or from a server are serialized
+ * at the NIC of that server. The one-sided operations wait for the cost (sync),
+ * while messages become visible to the receiver once the cost has elapsed (async).
+ */
+class Sim_Network {
+private:
+    struct msg_t {
+        uint64_t ready;  // the time (usec) when the message arrives
+        string data;
+    };
+
+    struct mailbox_t {
+        pthread_spinlock_t lock;
+        deque<msg_t> msgs;
+
+        mailbox_t() { pthread_spin_init(&lock, 0); }
+    };
+
+    // the NIC of a server
+    struct nic_t {
+        pthread_spinlock_t lock;
+        uint64_t idle;  // the time (usec) when the NIC finishes all previous transfers
+
+        nic_t() : idle(0) { pthread_spin_init(&lock, 0); }
+    };
+
+    bool enabled = false;
+    int num_servers = 0;
+
+    vector<char *> mems;  // the registered memory of each server
+    nic_t *nics = NULL;
+
+    pthread_spinlock_t mbox_lock;
+    unordered_map<uint64_t, mailbox_t *> mailboxes;  // port -> mailbox
+
+    volatile int bar_count = 0;
+    volatile int bar_gen = 0;
+
+    Sim_Network() { pthread_spin_init(&mbox_lock, 0); }
+
+    mailbox_t *mailbox(uint64_t port) {
+        pthread_spin_lock(&mbox_lock);
+        mailbox_t *&mbox = mailboxes[port];
+        if (mbox == NULL)
+            mbox = new mailbox_t();  // on-demand
+        pthread_spin_unlock(&mbox_lock);
+        return mbox;
+    }
+
+    // reserve the NIC of server @sid to transfer @sz bytes,
+    // and return the time when the transfer is done
+    uint64_t transfer(int sid, uint64_t sz) {
+        uint64_t xfer = global_sim_bandwidth_mbps ? sz / global_sim_bandwidth_mbps : 0;  // 1 MB/s == 1 B/usec
+        nic_t &nic = nics[sid];
+
+        pthread_spin_lock(&nic.lock);
+        nic.idle = max(nic.idle, timer::get_usec()) + xfer;
+        uint64_t done = nic.idle;
+        pthread_spin_unlock(&nic.lock);
+
+        return done + global_sim_latency_us;
+    }
+
+    void wait_until(uint64_t t) {
+        uint64_t now;
+        while ((now = timer::get_usec()) < t) {
+            if (t - now > 100)
+                usleep(t - now - 50);  // coarse-grained
+            else
+                _mm_pause();
+        }
+    }
+
+public:
+    static Sim_Network &get() {
+        // never destroyed, since other simulated servers may still use it
+        // when one of them calls exit() (e.g., the 'quit' command)
+        static Sim_Network *sim = new Sim_Network();
+        return *sim;
+    }
+
+    // enable the simulation of @nservers servers (before loading config)
+    void init(int nservers);
+
+    inline bool is_enabled() { return enabled; }
+
+    // register the memory of server @sid (the target of one-sided operations)
+    void register_mem(int sid, char *mem) {
+        ASSERT(sid < num_servers);
+        mems[sid] = mem;
+    }
+
+    /// one-sided operations
+
+    void read(int nid, char *local, uint64_t sz, uint64_t off) {
+        ASSERT(mems[nid] != NULL);
+        wait_until(transfer(nid, sz));
+        memcpy(local, mems[nid] + off, sz);
+    }
+
+    void write(int nid, char *local, uint64_t sz, uint64_t off) {
+        ASSERT(mems[nid] != NULL);
+        wait_until(transfer(nid, sz));
+
+        // RDMA writes the data in order, so the reader polling the last word
+        // (e.g., the footer of ring buffers) never sees a partial write
+        char *remote = mems[nid] + off;
+        if (sz > sizeof(uint64_t)) {
+            memcpy(remote, local, sz - sizeof(uint64_t));
+            __sync_synchronize();
+            memcpy(remote + sz - sizeof(uint64_t), local + sz - sizeof(uint64_t), sizeof(uint64_t));
+        } else {
+            memcpy(remote, local, sz);
+        }
+    }
+
+    /// messages
+
+    // send @str from server @src to the mailbox @port of server @dst
+    void send(int src, int dst, uint64_t port, const string &str) {
+        msg_t msg;
+        msg.ready = (src == dst) ? 0 : transfer(dst, str.length());  // loopback is free
+        msg.data = str;
+
+        mailbox_t *mbox = mailbox(port);
+        pthread_spin_lock(&mbox->lock);
+        // keep FIFO order on the mailbox
+        if (!mbox->msgs.empty())
+            msg.ready = max(msg.ready, mbox->msgs.back().ready);
+        mbox->msgs.push_back(msg);
+        pthread_spin_unlock(&mbox->lock);
+    }
+
+    bool tryrecv(uint64_t port, string &str) {
+        mailbox_t *mbox = mailbox(port);
+        bool success = false;
+        pthread_spin_lock(&mbox->lock);
+        if (!mbox->msgs.empty() && mbox->msgs.front().ready <= timer::get_usec()) {
+            str.swap(mbox->msgs.front().data);
+            mbox->msgs.pop_front();
+            success = true;
+        }
+        pthread_spin_unlock(&mbox->lock);
+        return success;
+    }
+
+    string recv(uint64_t port) {
+        string str;
+        while (!tryrecv(port, str))
+            usleep(1);
+        return str;
+    }
+
+    // the barrier of all simulated servers (one thread per server)
+    void barrier() {
+        int gen = bar_gen;
+        if (__sync_add_and_fetch(&bar_count, 1) == num_servers) {
+            bar_count = 0;
+            __sync_synchronize();
+            bar_gen++;  // release others
+        } else {
+            while (bar_gen == gen)
+                usleep(1);
+        }
+    }
+};
+
+// the emulated RDMA device over the simulated network
+class Sim_RDMA_Device : public RDMA_Device_Interface {
+public:
+    int RdmaRead(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
+        Sim_Network::get().read(nid, local, sz, off);
+        return 0;
+    }
+
+    int RdmaWrite(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
+        Sim_Network::get().write(nid, local, sz, off);
+        return 0;
+    }
+
+    int RdmaWriteNonSignal(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
+        Sim_Network::get().write(nid, local, sz, off);
+        return 0;
+    }
+
+    int RdmaWriteSelective(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
+        Sim_Network::get().write(nid, local, sz, off);
+        return 0;
+    }
+};
+
+inline void Sim_Network::init(int nservers)
+{
+    ASSERT(nservers > 0);
+    enabled = true;
+    num_servers = nservers;
+    mems.assign(nservers, NULL);
+    nics = new nic_t[nservers];
+
+    // one-sided operations go through the simulated network
+    RDMA::get_rdma().init_emulated_dev(new Sim_RDMA_Device());
+}
+
+// the barrier of all servers (MPI processes or simulated servers)
+static void server_barrier()
+{
+    if (Sim_Network::get().is_enabled())
+        Sim_Network::get().barrier();
+    else
+        MPI_Barrier(MPI_COMM_WORLD);
+}
@@ -52,6 +52,11 @@ public:
     uint64_t next_index_id;
     uint64_t next_normal_id;
 
+    uint64_t str_bytes = 0; // the heap memory of strings (two copies)
+
+    // the copies on other NUMANODEs, which also get the added mappings (see Node_Replicas)
+    vector<String_Server *> replicas;
+
     String_Server(string dname) {
         uint64_t start = timer::get_usec();
 
@@ -78,6 +83,31 @@ public:
 
     bool exist(string str) { return str2id.find(str) != str2id.end(); }
 
+    // add a mapping between @str and @id to both directions
+    void add(const string &str, sid_t id) {
+        str2id[str] = id;
+        string &copy = id2str[id] = str;
+
+        // NOTE: short strings are stored inline (SSO) w/o heap memory
+        const char *p = copy.data();
+        if (p < (const char *)&copy || p >= (const char *)(&copy + 1))
+            str_bytes += 2 * (copy.capacity() + 1);
+
+        for (auto r : replicas)
+            r->add(str, id);
+    }
+
+    // the estimated memory footprint of the mappings (in bytes)
+    uint64_t memory_usage() {
+        // a node holds the key-value pair and the links of the bucket list
+        uint64_t node = sizeof(string) + sizeof(sid_t) + 2 * sizeof(void *);
+        return (str2id.size() + id2str.size()) * node
+               + pid2type.size() * (sizeof(sid_t) + sizeof(int32_t) + 2 * sizeof(void *))
+               + (str2id.bucket_count() + id2str.bucket_count() + pid2type.bucket_count())
+               * sizeof(void *)
+               + str_bytes;
+    }
+
 private:
     /* load ID mapping files from a shared filesystem (e.g., NFS) */
     void load_from_posixfs(string dname) {
@@ -101,8 +131,7 @@ private:
                 string str;
                 sid_t id;
                 while (file >> str >> id) {
-                    str2id[str] = id;
-                    id2str[id] = str;
+                    add(str, id);
                     if (boost::ends_with(fname, "/str_index"))
                         pid2type[id] = SID_t;
                 }
@@ -124,8 +153,7 @@ private:
                 sid_t id;
                 int32_t type;
                 while (file >> str >> id >> type) {
-                    str2id[str] = id;
-                    id2str[id] = str;
+                    add(str, id);
                     pid2type[id] = type;
                     logstream(LOG_INFO) << " attribute[" << id << "] = " << type << LOG_endl;
                 }
@@ -150,8 +178,7 @@ private:
                 string str;
                 sid_t id;
                 while (file >> str >> id) {
-                    str2id[str] = id;
-                    id2str[id] = str;
+                    add(str, id);
                     if (boost::ends_with(fname, "/str_index"))
                         pid2type[id] = SID_t;
                 }
@@ -170,8 +197,7 @@ private:
                 sid_t id;
                 int32_t type;
                 while (file >> str >> id >> type) {
-                    str2id[str] = id;
-                    id2str[id] = str;
+                    add(str, id);
                     pid2type[id] = type;
                     logstream(LOG_INFO) << " attribute[" << id << "] = " << type << LOG_endl;
                 }
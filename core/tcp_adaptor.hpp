@@ -35,6 +35,8 @@
 
 #include <tbb/concurrent_unordered_map.h>
 
+#include "sim.hpp"
+
 using namespace std;
 
 class TCP_Adaptor {
@@ -42,7 +44,9 @@ private:
     typedef tbb::concurrent_unordered_map<int, zmq::socket_t *> socket_map;
     typedef vector<zmq::socket_t *> socket_vector;
 
+    int sid;
     int port_base;
+    bool sim;   // over the simulated network (see sim.hpp)
 
     // The communication over zeromq, a socket library.
     zmq::context_t context;
@@ -55,10 +59,16 @@ private:
 
     inline int port_code(int sid, int tid) { return sid * 200 + tid; }
 
+    inline uint64_t sim_port(int sid, int tid) { return port_base + port_code(sid, tid); }
+
 public:
 
     TCP_Adaptor(int sid, string fname, int num_threads, int port_base)
-        : port_base(port_base), context(1) {
+        : sid(sid), port_base(port_base),
+          sim(Sim_Network::get().is_enabled()), context(1) {
+
+        // simulated servers use in-memory mailboxes instead of sockets
+        if (sim) return;
 
         ifstream hostfile(fname);
         string ip;
@@ -93,6 +103,11 @@ public:
     string ip_of(int sid) { return ipset[sid]; }
 
     bool send(int sid, int tid, string str) {
+        if (sim) {
+            Sim_Network::get().send(this->sid, sid, sim_port(sid, tid), str);
+            return true;
+        }
+
         int pid = port_code(sid, tid);
 
         zmq::message_t msg(str.length());
@@ -116,6 +131,9 @@ public:
     }
 
     string recv(int tid) {
+        if (sim)
+            return Sim_Network::get().recv(sim_port(sid, tid));
+
         zmq::message_t msg;
         if (receivers[tid]->recv(&msg) < 0) {
             logstream(LOG_ERROR) << "Failed to recv msg ("
@@ -127,6 +145,9 @@ public:
     }
 
     bool tryrecv(int tid, string &str) {
+        if (sim)
+            return Sim_Network::get().tryrecv(sim_port(sid, tid), str);
+
         zmq::message_t msg;
         bool success = false;
         if (success = receivers[tid]->recv(&msg, ZMQ_NOBLOCK))
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <boost/serialization/vector.hpp>
+
+#include "timer.hpp"
+
+using namespace std;
+
+/**
+ * Tracing of (sub-)queries on engines
+ *
+ * Each engine records span events into its own ring buffer (single producer),
+ * which are timestamped by TSC. The events are converted to the wall-clock time
+ * of the server when collected, so that the events from different servers can be
+ * put into one timeline (as good as the clocks of servers are synchronized, e.g., by NTP).
+ */
+class Trace_Event {
+public:
+    enum Kind {
+        ENQUEUE,    // a query is put into the runqueue of an engine
+        START,      // an engine runs a query (until it finishes or waits for sub-queries)
+        STEP,       // a pattern step
+        SEND,       // a (sub-)query is sent to an engine (incl. the local fast path)
+        REPLY,      // a reply is sent to the parent
+        MERGE,      // a reply is merged into its parent
+        YIELD       // a query is parked back into the runqueue (see Engine::should_yield)
+    };
+
+    int kind;
+    int qid;
+    int pid;
+    int sid;        // the server and the thread (engine) which records the event
+    int tid;
+    int step = -1;  // pattern step (STEP)
+    int dst_sid = -1;  // destination (SEND and REPLY)
+    int dst_tid = -1;
+    uint64_t rows = 0; // #rows of the result
+    uint64_t ts = 0;   // start time (TSC, or nsec after being collected)
+    uint64_t dur = 0;  // duration (TSC, or nsec after being collected)
+
+    template <typename Archive>
+    void serialize(Archive &ar, const unsigned int version) {
+        ar & kind;
+        ar & qid;
+        ar & pid;
+        ar & sid;
+        ar & tid;
+        ar & step;
+        ar & dst_sid;
+        ar & dst_tid;
+        ar & rows;
+        ar & ts;
+        ar & dur;
+    }
+
+    static const char *kind_str(int kind) {
+        static const char *strs[] = {"enqueue", "start", "step", "send", "reply", "merge", "yield"};
+        return strs[kind];
+    }
+};
+
+/**
+ * Convert TSC to the wall-clock time (nsec) of the server
+ * The clock is calibrated once on the first use (about 10 msec).
+ */
+class Trace_Clock {
+private:
+    uint64_t base_tsc;
+    uint64_t base_nsec;
+    double nsec_per_cycle;
+
+    static uint64_t get_realtime_nsec() {
+        struct timespec tp;
+        clock_gettime(CLOCK_REALTIME, &tp);
+        return (tp.tv_sec * 1000ull * 1000 * 1000) + tp.tv_nsec;
+    }
+
+    Trace_Clock() {
+        uint64_t nsec0 = get_realtime_nsec(), tsc0 = timer::get_tsc();
+        uint64_t usec = timer::get_usec();
+        while (timer::get_usec() - usec < 10000) ; // spin 10 msec
+        uint64_t nsec1 = get_realtime_nsec(), tsc1 = timer::get_tsc();
+
+        base_tsc = tsc1;
+        base_nsec = nsec1;
+        nsec_per_cycle = (tsc1 > tsc0) ? (double)(nsec1 - nsec0) / (tsc1 - tsc0) : 1.0;
+    }
+
+public:
+    static Trace_Clock &get_clock() {
+        static Trace_Clock clock;
+        return clock;
+    }
+
+    uint64_t to_nsec(uint64_t tsc) {
+        return base_nsec + (int64_t)((double)((int64_t)(tsc - base_tsc)) * nsec_per_cycle);
+    }
+
+    uint64_t cycles_to_nsec(uint64_t cycles) { return cycles * nsec_per_cycle; }
+};
+
+/**
+ * A lock-free ring buffer of trace events
+ *
+ * Only the owner (engine) thread appends events, and the oldest events are overwritten
+ * when the buffer is full. The buffer is allocated by the owner on its first event,
+ * so engines never tracing use no memory. The reader (console) takes out the events
+ * concurrently, and drops the events which may be overwritten during the copy.
+ */
+class Trace_Buffer {
+private:
+    Trace_Event *events = NULL;  // allocated on the first event (by the owner)
+    uint64_t size;  // power of two
+    volatile uint64_t head = 0;  // #events ever recorded (written by the owner only)
+    uint64_t tail = 0;  // the events before tail are taken or cleared (written by the reader only)
+
+public:
+    Trace_Buffer(uint64_t n) {
+        size = 1;
+        while (size < n) size <<= 1;
+    }
+
+    ~Trace_Buffer() { delete [] events; }
+
+    inline void push(const Trace_Event &e) {
+        if (events == NULL)
+            __atomic_store_n(&events, new Trace_Event[size], __ATOMIC_RELEASE);
+
+        uint64_t h = head;
+        events[h & (size - 1)] = e;
+        __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+    }
+
+    // copy out the events recorded after the last take (or clear), and drop them
+    void take(vector<Trace_Event> &out) {
+        Trace_Event *events = __atomic_load_n(&this->events, __ATOMIC_ACQUIRE);
+        if (events == NULL) return; // nothing recorded
+
+        uint64_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        uint64_t from = max(tail, (h > size) ? h - size : 0);
+        size_t base = out.size();
+        for (uint64_t i = from; i < h; i++)
+            out.push_back(events[i & (size - 1)]);
+
+        // drop the events overwritten by the owner during the copy
+        // (incl. the slot being written by the next event)
+        uint64_t h2 = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        if (h2 + 1 > from + size) {
+            uint64_t n = min(h2 + 1 - size - from, h - from);
+            out.erase(out.begin() + base, out.begin() + base + n);
+        }
+        tail = h;
+    }
+
+    void clear() { tail = __atomic_load_n(&head, __ATOMIC_ACQUIRE); }
+};
+
+/**
+ * Write events in the Chrome trace format (JSON), which can be opened by
+ * chrome://tracing or Perfetto UI (https://ui.perfetto.dev).
+ * Each server is a process, and each engine is a thread.
+ */
+static void write_chrome_trace(vector<Trace_Event> &events, string fname)
+{
+    ofstream ofs(fname.c_str());
+    if (!ofs.good()) {
+        logstream(LOG_ERROR) << "Can't open file: " << fname << LOG_endl;
+        return;
+    }
+
+    // keep timestamps small by starting from the first event
+    uint64_t origin = UINT64_MAX;
+    for (auto &e : events)
+        origin = min(origin, e.ts);
+
+    ofs << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << endl;
+    bool first = true;
+    vector<pair<int, int>> threads;
+    for (auto &e : events) {
+        threads.push_back(make_pair(e.sid, e.tid));
+
+        if (!first) ofs << "," << endl;
+        first = false;
+
+        // a new (sub-)query has no ID before running, which is named by its parent
+        char qname[32], name[64];
+        if (e.qid >= 0)
+            snprintf(qname, sizeof(qname), "q%d", e.qid);
+        else
+            snprintf(qname, sizeof(qname), "q%d.sub", e.pid);
+        if (e.kind == Trace_Event::STEP)
+            snprintf(name, sizeof(name), "%s step %d", qname, e.step);
+        else
+            snprintf(name, sizeof(name), "%s %s", qname, Trace_Event::kind_str(e.kind));
+
+        char ts[64];
+        snprintf(ts, sizeof(ts), "%.3f", (e.ts - origin) / 1000.0);
+        ofs << "{\"name\":\"" << name << "\",\"cat\":\"" << Trace_Event::kind_str(e.kind) << "\"";
+        if (e.kind == Trace_Event::START || e.kind == Trace_Event::STEP
+                || e.kind == Trace_Event::MERGE) {
+            char dur[64];
+            snprintf(dur, sizeof(dur), "%.3f", e.dur / 1000.0);
+            ofs << ",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << dur;
+        } else {
+            ofs << ",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << ts;
+        }
+        ofs << ",\"pid\":" << e.sid << ",\"tid\":" << e.tid
+            << ",\"args\":{\"qid\":" << e.qid << ",\"pid\":" << e.pid;
+        if (e.step >= 0) ofs << ",\"step\":" << e.step;
+        if (e.dst_sid >= 0) ofs << ",\"dst\":\"" << e.dst_sid << "|" << e.dst_tid << "\"";
+        if (e.kind == Trace_Event::STEP || e.kind == Trace_Event::MERGE
+                || e.kind == Trace_Event::REPLY)
+            ofs << ",\"rows\":" << e.rows;
+        ofs << "}}";
+    }
+
+    // name processes (servers) and threads (engines)
+    sort(threads.begin(), threads.end());
+    threads.erase(unique(threads.begin(), threads.end()), threads.end());
+    for (int i = 0; i < threads.size(); i++) {
+        int sid = threads[i].first, tid = threads[i].second;
+        if (!first) ofs << "," << endl;
+        first = false;
+        if (i == 0 || threads[i - 1].first != sid)
+            ofs << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << sid
+                << ",\"args\":{\"name\":\"server " << sid << "\"}}," << endl;
+        ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << sid << ",\"tid\":" << tid
+            << ",\"args\":{\"name\":\"engine " << tid << "\"}}";
+    }
+    ofs << endl << "]}" << endl;
+}
@@ -39,6 +39,17 @@ typedef int32_t ssid_t;  // signed string id
 
 #endif
 
+enum { NBITS_DIR = 1 };
+enum { NBITS_IDX = 17 }; // equal to the size of t/pid
+enum { NBITS_VID = (64 - NBITS_IDX - NBITS_DIR) }; // 0: index vertex, ID: normal vertex
+
+// reserve two special index IDs (predicate and type)
+enum { PREDICATE_ID = 0, TYPE_ID = 1 };
+
+static inline bool is_tpid(ssid_t id) { return (id > 1) && (id < (1 << NBITS_IDX)); }
+
+static inline bool is_vid(ssid_t id) { return id >= (1 << NBITS_IDX); }
+
 struct triple_t {
     sid_t s; // subject
     sid_t p; // predicate
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A pool of recyclable vectors (e.g., intermediate result tables)
+ *
+ * Each engine owns its pools, so there is no lock. The buffers of swapped-out
+ * tables are put back to the pool and reused by later pattern steps and queries,
+ * instead of being freed and allocated again.
+ * The buffers are grouped into size classes by log2 of their capacity, and
+ * the total size of pooled buffers is bounded by @limit bytes.
+ */
+template <typename T>
+class Vector_Pool {
+private:
+    static const int NUM_CLASSES = 48;
+    // a buffer from the next classes may also be taken if the fitting one is empty
+    static const int MAX_CLASS_DIFF = 2;
+
+    vector<vector<T>> free_lists[NUM_CLASSES];
+    uint64_t limit;
+
+    static int floor_log2(uint64_t n) { return 63 - __builtin_clzll(n); }
+
+    static int ceil_log2(uint64_t n) { return (n <= 1) ? 0 : floor_log2(n - 1) + 1; }
+
+    static uint64_t bytes_of(const vector<T> &v) { return v.capacity() * sizeof(T); }
+
+public:
+    struct Stats {
+        uint64_t nallocs = 0;      // #buffers allocated from the heap
+        uint64_t nreuses = 0;      // #buffers reused from the pool
+        uint64_t nrecycles = 0;    // #buffers put back to the pool
+        uint64_t ndrops = 0;       // #buffers freed due to the limit of the pool
+        uint64_t alloc_bytes = 0;  // bytes allocated from the heap
+        uint64_t pooled_bytes = 0; // bytes of buffers in the pool
+    } stats;
+
+    Vector_Pool(uint64_t limit = 0): limit(limit) { }
+
+    void set_limit(uint64_t l) { limit = l; }
+
+    // return an empty vector whose capacity is at least @hint
+    vector<T> alloc(uint64_t hint) {
+        vector<T> v;
+        if (hint == 0) return v;
+
+        int c = ceil_log2(hint);
+        for (int i = c; i < NUM_CLASSES && i <= c + MAX_CLASS_DIFF; i++) {
+            if (free_lists[i].empty()) continue;
+
+            v.swap(free_lists[i].back());
+            free_lists[i].pop_back();
+            stats.pooled_bytes -= bytes_of(v);
+            stats.nreuses++;
+            v.clear(); // the capacity is at least 2^c >= @hint
+            return v;
+        }
+
+        v.reserve(hint);
+        stats.nallocs++;
+        stats.alloc_bytes += bytes_of(v);
+        return v;
+    }
+
+    // put the buffer of @v back to the pool, and @v becomes empty
+    void recycle(vector<T> &v) {
+        uint64_t sz = bytes_of(v);
+        if (sz == 0) return;
+
+        int c = floor_log2(v.capacity());
+        if (c >= NUM_CLASSES || stats.pooled_bytes + sz > limit) {
+            vector<T>().swap(v); // free
+            stats.ndrops++;
+            return;
+        }
+
+        free_lists[c].push_back(vector<T>());
+        free_lists[c].back().swap(v);
+        stats.pooled_bytes += sz;
+        stats.nrecycles++;
+    }
+};
+
+// vector<bool> packs bits, so its capacity is in bits
+template <>
+inline uint64_t Vector_Pool<bool>::bytes_of(const vector<bool> &v) { return v.capacity() / 8; }
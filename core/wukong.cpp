@@ -34,6 +34,7 @@
 #include "console.hpp"
 #include "rdma.hpp"
 #include "adaptor.hpp"
+#include "sim.hpp"
 
 #include "unit.hpp"
 
@@ -42,10 +43,13 @@
 void *engine_thread(void *arg)
 {
     Engine *engine = (Engine *)arg;
-    if (enable_binding && core_bindings.count(engine->tid) != 0)
-        bind_to_core(core_bindings[engine->tid]);
-    else
-        bind_to_core(default_bindings[engine->tid % num_cores]);
+    // NOTE: simulated servers share all cores (scheduled by OS)
+    if (!Sim_Network::get().is_enabled()) {
+        if (enable_binding && core_bindings.count(engine->tid) != 0)
+            bind_to_core(core_bindings[engine->tid]);
+        else
+            bind_to_core(default_bindings[engine->tid % num_cores]);
+    }
 
     engine->run();
 }
@@ -53,15 +57,46 @@ void *engine_thread(void *arg)
 void *proxy_thread(void *arg)
 {
     Proxy *proxy = (Proxy *)arg;
-    if (enable_binding && core_bindings.count(proxy->tid) != 0)
-        bind_to_core(core_bindings[proxy->tid]);
-    else
-        bind_to_core(default_bindings[proxy->tid % num_cores]);
+    // NOTE: simulated servers share all cores (scheduled by OS)
+    if (!Sim_Network::get().is_enabled()) {
+        if (enable_binding && core_bindings.count(proxy->tid) != 0)
+            bind_to_core(core_bindings[proxy->tid]);
+        else
+            bind_to_core(default_bindings[proxy->tid % num_cores]);
+    }
 
     // run the builtin console
     run_console(proxy);
 }
 
+// periodically dump the metrics of the server in Prometheus text format
+void *stat_thread(void *arg)
+{
+    int sid = *(int *)arg;
+    uint64_t last = timer::get_usec();
+    while (true) {
+        sleep(1);
+        if (global_stat_dump_interval <= 0
+                || timer::get_usec() - last < SEC(global_stat_dump_interval))
+            continue;
+
+        // e.g., wukong_stat.prom -> wukong_stat.0.prom
+        string fname = global_stat_dump_file;
+        size_t pos = fname.rfind(".prom");
+        if (pos != string::npos && pos + 5 == fname.length())
+            fname.insert(pos, "." + to_string(sid));
+        else
+            fname += "." + to_string(sid);
+
+        Metrics metrics;
+        collect_server_metrics(sid, metrics);
+        collect_proxy_metrics(sid, metrics);
+        if (!metrics.dump_prometheus(fname))
+            logstream(LOG_ERROR) << "Can't write metrics into " << fname << LOG_endl;
+        last = timer::get_usec();
+    }
+}
+
 static void
 usage(char *fn)
 {
@@ -69,82 +104,77 @@ usage(char *fn)
     cout << "options:" << endl;
     cout << "  -b binding : the file of core binding" << endl;
     cout << "  -c command : the one-shot command" << endl;
+    cout << "  -s num     : simulate <num> servers in a single process (w/o MPI)" << endl;
 }
 
-int
-main(int argc, char *argv[])
+// place the memory of a server on NUMANODEs: the kvstore is interleaved over all nodes
+// (probed by all engines), and the buffers of a thread are on the node of the thread
+static void place_mem(Mem *mem)
 {
-    boost::mpi::environment env(argc, argv);
-    boost::mpi::communicator world;
-    int sid = world.rank(); // server ID
-
-    if (argc < 3) {
-        usage(argv[0]);
-        exit(EXIT_FAILURE);
+    bind_mem_to_node(mem->kvstore(), mem->kvstore_size());
+    for (int tid = 0; tid < global_num_threads; tid++) {
+        int nid = get_thread_node(tid);
+        bind_mem_to_node(mem->buffer(tid), mem->buffer_size(), nid);
+        bind_mem_to_node(mem->ring(tid, 0), mem->ring_size() * global_num_servers, nid);
     }
+}
 
-    // load global configs
-    load_config(string(argv[1]), world.size());
-
-    // set the address file of host/cluster
-    string host_fname = std::string(argv[2]);
-
-    // load CPU topology by hwloc
-    load_node_topo();
-    logstream(LOG_INFO) << "#" << sid << ": has " << num_cores << " cores." << LOG_endl;
-
-    int c;
-    while ((c = getopt(argc - 2, argv + 2, "b:c:")) != -1) {
-        switch (c) {
-        case 'b':
-            enable_binding = load_core_binding(optarg);
-            break;
-        case 'c':
-            enable_oneshot = true;
-            oneshot_cmd = optarg;
-            break;
-        default:
-            usage(argv[0]);
-            exit(EXIT_FAILURE);
-        }
-    }
+// run a server, which never returns
+static void run_server(int sid, string host_fname)
+{
+    bool sim = Sim_Network::get().is_enabled();
 
     // allocate memory
     Mem *mem = new Mem(global_num_servers, global_num_threads);
     logstream(LOG_INFO)  << "#" << sid << ": allocate " << B2GiB(mem->memory_size()) << "GB memory" << LOG_endl;
 
+    // NOTE: simulated servers share all cores (scheduled by OS)
+    if (global_enable_numa_placement && !sim)
+        place_mem(mem);
+
     // init RDMA devices and connections
-    RDMA_init(global_num_servers, global_num_threads,
-              sid, mem->memory(), mem->memory_size(), host_fname);
+    if (sim) {
+        Sim_Network::get().register_mem(sid, mem->memory());
+        server_barrier(); // all memory is registered
+    } else {
+        RDMA_init(global_num_servers, global_num_threads,
+                  sid, mem->memory(), mem->memory_size(), host_fname);
+    }
 
     // init communication
     RDMA_Adaptor *rdma_adaptor = new RDMA_Adaptor(sid, mem, global_num_servers, global_num_threads);
     TCP_Adaptor *tcp_adaptor = new TCP_Adaptor(sid, host_fname, global_num_threads, global_data_port_base);
 
     // load string server (read-only, shared by all proxies and all engines)
-    String_Server str_server(global_input_folder);
+    String_Server *str_server = new String_Server(global_input_folder);
 
     // load RDF graph (shared by all engines)
-    DGraph dgraph(sid, mem, &str_server, global_input_folder);
+    DGraph *dgraph = new DGraph(sid, mem, str_server, global_input_folder);
 
     // prepare statistics for SPARQL optimizer
-    data_statistic stat(tcp_adaptor, sid);
+    data_statistic *stat = new data_statistic(tcp_adaptor, sid);
     if (global_enable_planner) {
         if (global_generate_statistics) {
-            dgraph.gstore.generate_statistic(stat);
-            stat.gather_stat();
+            dgraph->gstore.generate_statistic(*stat);
+            stat->gather_stat();
         } else {
             // use the dataset name by default
             vector<string> strs;
             boost::split(strs, global_input_folder, boost::is_any_of("/"));
             string fname = strs[strs.size() - 2] + ".statfile";
 
-            stat.load_stat_from_file(fname);
+            stat->load_stat_from_file(fname);
         }
     }
 
+    // replicate read-mostly structures on NUMANODEs
+    // NOTE: simulated servers share all cores (scheduled by OS)
+    Node_Replicas *replicas = NULL;
+    if (global_enable_numa_replicas && !sim && cpu_topo.size() > 1)
+        replicas = node_replicas[sid] = new Node_Replicas(sid, str_server, stat);
+
     // init control communicaiton
-    con_adaptor = new TCP_Adaptor(sid, host_fname, global_num_proxies, global_ctrl_port_base);
+    con_adaptors[sid] = new TCP_Adaptor(sid, host_fname, global_num_proxies, global_ctrl_port_base);
 
     // create proxies and engines
     ASSERT(global_num_threads == global_num_proxies + global_num_engines);
@@ -153,24 +183,33 @@ main(int argc, char *argv[])
 
         // TID: proxy = [0, #proxies), engine = [#proxies, #proxies + #engines)
         if (tid < global_num_proxies) {
-            Proxy *proxy = new Proxy(sid, tid, &str_server, adaptor, &stat);
-            proxies.push_back(proxy);
+            Proxy *proxy = replicas ?
+                           new Proxy(sid, tid, mem, replicas->get_str_server(tid), adaptor,
+                                     replicas->get_statistic(tid)) :
+                           new Proxy(sid, tid, mem, str_server, adaptor, stat);
+            proxies[sid].push_back(proxy);
         } else {
-            Engine *engine = new Engine(sid, tid, &str_server, &dgraph, adaptor);
-            engines.push_back(engine);
+            Engine *engine = new Engine(sid, tid, replicas ? replicas->get_str_server(tid) : str_server,
+                                        dgraph, adaptor);
+            engines[sid].push_back(engine);
         }
     }
+    if (sim) server_barrier(); // all engines are created
 
     // launch all proxies and engines
     pthread_t *threads  = new pthread_t[global_num_threads];
     for (int tid = 0; tid < global_num_threads; tid++) {
         // TID: proxy = [0, #proxies), engine = [#proxies, #proxies + #engines)
         if (tid < global_num_proxies)
-            pthread_create(&(threads[tid]), NULL, proxy_thread, (void *)proxies[tid]);
+            pthread_create(&(threads[tid]), NULL, proxy_thread, (void *)proxies[sid][tid]);
         else
-            pthread_create(&(threads[tid]), NULL, engine_thread, (void *)engines[tid - global_num_proxies]);
+            pthread_create(&(threads[tid]), NULL, engine_thread, (void *)engines[sid][tid - global_num_proxies]);
     }
 
+    // dump metrics in background
+    pthread_t dump_thread;
+    pthread_create(&dump_thread, NULL, stat_thread, (void *)&sid);
+
     // wait to all threads termination
     for (size_t t = 0; t < global_num_threads; t++) {
         if (int rc = pthread_join(threads[t], NULL)) {
@@ -178,6 +217,101 @@ main(int argc, char *argv[])
             exit(-1);
         }
     }
+}
+
+struct sim_server_arg {
+    int sid;
+    string host_fname;
+};
+
+void *sim_server_thread(void *arg)
+{
+    sim_server_arg *sarg = (sim_server_arg *)arg;
+    run_server(sarg->sid, sarg->host_fname);
+}
+
+int
+main(int argc, char *argv[])
+{
+    boost::mpi::environment env(argc, argv);
+    boost::mpi::communicator world;
+    int sid = world.rank(); // server ID
+
+    if (argc < 3) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // set the address file of host/cluster
+    string host_fname = std::string(argv[2]);
+
+    int c;
+    string binding_fname;
+    int num_sim_servers = 0;
+    while ((c = getopt(argc - 2, argv + 2, "b:c:s:")) != -1) {
+        switch (c) {
+        case 'b':
+            binding_fname = optarg;
+            break;
+        case 'c':
+            enable_oneshot = true;
+            oneshot_cmd = optarg;
+            break;
+        case 's':
+            num_sim_servers = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // simulate servers by thread groups of this process (before loading configs)
+    if (num_sim_servers > 0) {
+        ASSERT(world.size() == 1);
+        Sim_Network::get().init(num_sim_servers);
+    }
+
+    // load global configs
+    load_config(string(argv[1]), num_sim_servers > 0 ? num_sim_servers : world.size());
+
+    // load CPU topology by hwloc
+    load_node_topo();
+    logstream(LOG_INFO) << "#" << sid << ": has " << num_cores << " cores." << LOG_endl;
+
+    if (!binding_fname.empty()) {
+        enable_binding = load_core_binding(binding_fname);
+    } else if (global_enable_numa_placement) {
+        auto_core_binding();
+        enable_binding = true;
+    }
+
+    proxies.resize(global_num_servers);
+    engines.resize(global_num_servers);
+    data_versions.resize(global_num_servers, 0);
+    prefix_caches.resize(global_num_servers);
+    hot_vertices.resize(global_num_servers);
+    elastic_engines.resize(global_num_servers);
+    node_replicas.resize(global_num_servers, NULL);
+    con_adaptors.resize(global_num_servers);
+
+    if (num_sim_servers == 0) {
+        run_server(sid, host_fname);
+    } else {
+        logstream(LOG_INFO) << "simulate " << num_sim_servers << " servers (latency: "
+                            << global_sim_latency_us << "us, bandwidth: "
+                            << global_sim_bandwidth_mbps << "MB/s)" << LOG_endl;
+
+        vector<sim_server_arg> args(num_sim_servers);
+        vector<pthread_t> servers(num_sim_servers);
+        for (int i = 0; i < num_sim_servers; i++) {
+            args[i].sid = i;
+            args[i].host_fname = host_fname;
+            pthread_create(&servers[i], NULL, sim_server_thread, (void *)&args[i]);
+        }
+        for (int i = 0; i < num_sim_servers; i++)
+            pthread_join(servers[i], NULL);
+    }
 
     /// TODO: exit gracefully (properly call MPI_Init() and MPI_Finalize(), delete all objects)
     return 0;
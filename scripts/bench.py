@@ -0,0 +1,458 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2016 Shanghai Jiao Tong University.
+#     All rights reserved.
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing,
+#  software distributed under the License is distributed on an "AS
+#  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+#  express or implied.  See the License for the specific language
+#  governing permissions and limitations under the License.
+#
+# For more about this software visit:
+#
+#      http://ipads.se.sjtu.edu.cn/projects/wukong
+#
+#
+# The end-to-end benchmark driver of Wukong
+#
+#   gen     generate a LUBM dataset of a given scale (UBA -> NT -> ID format)
+#   run     load a dataset, run the standard LUBM queries (latency) and the
+#           emulator mix (throughput), and write results as JSON
+#   compare compare results with a baseline and flag regressions
+#
+# e.g.,
+#   ./bench.py gen -u 2 -d /path/to/input
+#   ./bench.py run -u 2 -d /path/to/input -o lubm_2.json          (MPI, mpd.hosts)
+#   ./bench.py run -u 2 -d /path/to/input -s 2 -o lubm_2.json     (simulated servers)
+#   ./bench.py compare baseline.json lubm_2.json -t 10
+
+import argparse
+import datetime
+import glob
+import json
+import os
+import re
+import resource
+import shutil
+import subprocess
+import sys
+import time
+
+ROOT = os.environ.get('WUKONG_ROOT', os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+SCRIPTS = os.path.join(ROOT, 'scripts')
+
+QUERIES = ['sparql_query/lubm/lubm_q%d' % i for i in range(1, 8)]
+EMU_MIX = 'sparql_query/lubm/emulator/mix_config'
+
+
+def log(msg):
+    sys.stderr.write('[bench] %s\n' % msg)
+    sys.stderr.flush()
+
+
+def dataset_dir(args):
+    return os.path.join(args.data_dir, 'id_lubm_%d' % args.univ)
+
+
+### gen
+
+def gen_dataset(args):
+    """UBA (RDF/XML) -> rdfcat (N-Triples) -> datagen/generate_data (ID format)"""
+    dst = dataset_dir(args)
+    if os.path.exists(os.path.join(dst, 'str_index')) and not args.force:
+        log('dataset exists: %s' % dst)
+        return dst
+
+    uba = args.uba or os.environ.get('UBA_HOME')
+    jena = args.jena or os.environ.get('JENA_HOME')
+    if not uba or not jena:
+        sys.exit('please set UBA_HOME and JENA_HOME (or --uba/--jena), see docs/INSTALL.md')
+
+    work = os.path.join(args.data_dir, 'raw_lubm_%d' % args.univ)
+    nt = os.path.join(args.data_dir, 'nt_lubm_%d' % args.univ)
+    for d in (work, nt):
+        shutil.rmtree(d, ignore_errors=True)
+        os.makedirs(d)
+
+    t = time.time()
+    log('generating %d universities by UBA' % args.univ)
+    subprocess.check_call(['java', '-cp', os.path.join(uba, 'classes'),
+                           'edu.lehigh.swat.bench.uba.Generator',
+                           '-univ', str(args.univ), '-seed', str(args.seed),
+                           '-onto', 'http://swat.cse.lehigh.edu/onto/univ-bench.owl'],
+                          cwd=work, stdout=subprocess.DEVNULL)
+
+    log('converting to N-Triples by rdfcat')
+    for u in range(args.univ):
+        owls = sorted(glob.glob(os.path.join(work, 'University%d_*.owl' % u)))
+        with open(os.path.join(nt, 'uni%d.nt' % u), 'w') as f:
+            for owl in owls:
+                subprocess.check_call([os.path.join(jena, 'bin', 'rdfcat'),
+                                       '-out', 'N-TRIPLE', '-x', owl], stdout=f)
+
+    log('converting to ID format by generate_data')
+    gen = os.path.join(ROOT, 'datagen', 'generate_data')
+    if not os.path.exists(gen):
+        subprocess.check_call(['g++', '-std=c++11', '-O2', gen + '.cpp', '-o', gen])
+    shutil.rmtree(dst, ignore_errors=True)
+    subprocess.check_call([gen, nt, dst], stdout=subprocess.DEVNULL)
+
+    shutil.rmtree(work, ignore_errors=True)
+    if not args.keep_nt:
+        shutil.rmtree(nt, ignore_errors=True)
+    log('dataset is ready: %s (%.1f sec)' % (dst, time.time() - t))
+    return dst
+
+
+### run
+
+def write_config(args, dname, fname):
+    """the config of benchmark = the base config + the dataset + overrides"""
+    items = []
+    with open(args.config) as f:
+        for line in f:
+            kv = line.split()
+            if len(kv) >= 2 and not kv[0].startswith('#'):
+                items.append([kv[0], kv[1]])
+    overrides = [('global_input_folder', dname + '/')]
+    overrides += [tuple(s.split('=', 1)) for s in args.set]
+    for k, v in overrides:
+        for it in items:
+            if it[0] == k:
+                it[1] = v
+                break
+        else:
+            items.append([k, v])
+    with open(fname, 'w') as f:
+        for k, v in items:
+            f.write('%-32s%s\n' % (k, v))
+    return dict(items)
+
+
+def launch(args, cfg_fname, cmds):
+    """run wukong in one-shot mode, and return the console output"""
+    wukong = os.path.join(ROOT, 'build', 'wukong')
+    cmd = [wukong, cfg_fname, args.hosts]
+    if args.sim:
+        cmd += ['-s', str(args.sim)]
+    else:
+        mpiexec = os.path.join(ROOT, 'deps', 'openmpi-1.6.5-install', 'bin', 'mpiexec')
+        if not os.path.exists(mpiexec):
+            mpiexec = 'mpiexec'
+        cmd = [mpiexec, '-x', 'CLASSPATH', '-x', 'LD_LIBRARY_PATH', '-hostfile', args.hosts,
+               '-n', str(args.servers)] + cmd
+        if os.path.exists(args.binding):
+            cmd += ['-b', args.binding]
+    cmd += ['-c', '; '.join(cmds)]
+
+    log('launch: %s' % ' '.join(cmd[:-1]))
+    t = time.time()
+    proc = subprocess.run(cmd, cwd=SCRIPTS, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                          timeout=args.timeout)
+    out = proc.stdout.decode('utf-8', 'replace')
+    if args.log:
+        with open(args.log, 'w') as f:
+            f.write(out)
+    if proc.returncode != 0:
+        sys.exit('wukong exited with %d (see the log by -l)' % proc.returncode)
+    return out, time.time() - t
+
+
+ANSI = re.compile(r'\x1b\[[0-9;]*m')
+PREFIX = re.compile(r'^(INFO|DEBUG|WARNING|ERROR|FATAL|EMPH):\s*')
+
+
+def split_output(out):
+    """split the console output into the load phase and the sections of commands"""
+    lines = [PREFIX.sub('', ANSI.sub('', l)).rstrip() for l in out.splitlines()]
+    load, sections, cur = [], [], None
+    for l in lines:
+        m = re.match(r'Run one-shot command: (.*)$', l)
+        if m:
+            cur = (m.group(1), [])
+            sections.append(cur)
+        elif cur is None:
+            load.append(l)
+        else:
+            cur[1].append(l)
+    return load, sections
+
+
+def parse_load(lines):
+    res = {'phases_ms': {}, 'allocated_gb_per_server': 0.0}
+    for l in lines:
+        # e.g., "#0: 5 ms for loading data files" (the max of all servers)
+        m = re.match(r'#\d+: (\d+) ?ms for (.+)$', l)
+        if m:
+            key = m.group(2).replace(' ', '_')
+            res['phases_ms'][key] = max(res['phases_ms'].get(key, 0), int(m.group(1)))
+        m = re.match(r'loading string server is finished \((\d+) ms\)', l)
+        if m:
+            key = 'loading_string_server'
+            res['phases_ms'][key] = max(res['phases_ms'].get(key, 0), int(m.group(1)))
+        m = re.match(r'#\d+: allocate ([\d.]+)GB memory', l)
+        if m:
+            res['allocated_gb_per_server'] = float(m.group(1))
+    return res
+
+
+def parse_sparql(lines):
+    res = {}
+    for l in lines:
+        m = re.match(r'\(average\) latency: (\d+) usec', l)
+        if m:
+            res['avg_usec'] = int(m.group(1))
+        m = re.match(r'\(last\) result size: (\d+)', l)
+        if m:
+            res['result_size'] = int(m.group(1))
+        m = re.match(r'\(last\) peak intermediate result: (\d+) bytes', l)
+        if m:
+            res['peak_bytes'] = int(m.group(1))
+    if 'avg_usec' not in res:
+        res['error'] = next((l for l in lines if 'Failed' in l or 'ERROR' in l), 'no latency')
+    return res
+
+
+def parse_emu(lines):
+    """the CDF table (P/Q1..Qn, percentiles, #, AVG), the per-class tail latency and the throughput"""
+    res = {'per_type': {}}
+    header = None
+    for i, l in enumerate(lines):
+        cols = l.split('\t')
+        cols = [c for c in cols if c != '']
+        if cols and cols[0] == 'P' and len(cols) > 1:
+            header = cols[1:]
+            for q in header:
+                res['per_type'][q] = {}
+        elif header and cols and cols[0] in ('#', 'AVG'):
+            key = 'count' if cols[0] == '#' else 'avg_usec'
+            for q, v in zip(header, cols[1:]):
+                res['per_type'][q][key] = int(v)
+        elif header and cols and cols[0] in ('50', '90', '99', '99.9'):
+            for q, v in zip(header, cols[1:]):
+                res['per_type'][q]['p' + cols[0] + '_usec'] = int(v)
+        elif header and len(cols) == 7 and cols[0] in ('light', 'heavy'):
+            keys = ('count', 'p50_usec', 'p90_usec', 'p99_usec', 'p99.9_usec', 'max_usec')
+            res.setdefault('per_class', {})[cols[0]] = dict(zip(keys, map(int, cols[1:])))
+        m = re.match(r'Throughput: ([\d.e+-]+)K queries/sec', l)
+        if m and header:  # the final throughput is printed after the CDF
+            res['kqps'] = float(m.group(1))
+    return res
+
+
+def parse_prometheus(fname):
+    """sum each metric of all servers and engines"""
+    res = {}
+    if not os.path.exists(fname):
+        return res
+    with open(fname) as f:
+        for l in f:
+            if l.startswith('#') or not l.strip():
+                continue
+            name, val = l.rsplit(' ', 1)
+            name = name.split('{')[0].replace('wukong_', '', 1)
+            res[name] = res.get(name, 0) + int(float(val))
+    return res
+
+
+def git_commit():
+    try:
+        return subprocess.check_output(['git', 'rev-parse', '--short', 'HEAD'], cwd=ROOT,
+                                       stderr=subprocess.DEVNULL).decode().strip()
+    except Exception:
+        return 'unknown'
+
+
+def run_bench(args):
+    dname = gen_dataset(args) if args.gen else dataset_dir(args)
+    if not os.path.exists(os.path.join(dname, 'str_index')):
+        sys.exit('no dataset in %s (use --gen or the gen command)' % dname)
+
+    cfg_fname = os.path.join(SCRIPTS, 'bench_config')
+    config = write_config(args, dname, cfg_fname)
+    stat_fname = os.path.join(SCRIPTS, 'bench_stat.prom')
+    if os.path.exists(stat_fname):
+        os.remove(stat_fname)
+
+    cmds = ['sparql -f %s -n %d' % (q, args.nrepeats) for q in QUERIES]
+    if args.duration > 0:
+        cmds.append('sparql-emu -f %s -d %d -w %d -p %d'
+                    % (args.mix, args.duration, args.warmup, args.pfactor))
+    cmds.append('stat -o %s' % stat_fname)
+
+    out, elapsed = launch(args, cfg_fname, cmds)
+    load, sections = split_output(out)
+
+    result = {
+        'meta': {
+            'time': datetime.datetime.now().isoformat(),
+            'commit': git_commit(),
+            'dataset': os.path.basename(dname),
+            'servers': args.sim or args.servers,
+            'simulated': bool(args.sim),
+            'proxies': int(config.get('global_num_proxies', 1)),
+            'engines': int(config.get('global_num_engines', 1)),
+            'use_rdma': int(config.get('global_use_rdma', 1)),
+            'nrepeats': args.nrepeats,
+            'overrides': args.set,
+        },
+        'load': parse_load(load),
+        'latency': {},
+        'throughput': {},
+        'memory': {},
+        'elapsed_sec': round(elapsed, 3),
+    }
+
+    for cmd, lines in sections:
+        if cmd.startswith('sparql-emu'):
+            result['throughput'] = parse_emu(lines)
+        elif cmd.startswith('sparql '):
+            q = os.path.basename(cmd.split()[2])
+            result['latency'][q] = parse_sparql(lines)
+
+    metrics = parse_prometheus(stat_fname)
+    for k in ('gstore_entry_used_bytes', 'gstore_entry_total_bytes',
+              'mem_string_server_bytes', 'mem_statistic_bytes'):
+        if k in metrics:
+            result['memory'][k] = metrics[k]
+    result['memory']['allocated_gb_per_server'] = result['load'].pop('allocated_gb_per_server')
+    # the peak RSS of local processes (e.g., all simulated servers)
+    result['memory']['max_rss_kb'] = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss
+
+    text = json.dumps(result, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text + '\n')
+        log('write results into %s' % args.output)
+    else:
+        print(text)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            return compare(json.load(f), result, args.threshold)
+    return 0
+
+
+### compare
+
+def flatten(res):
+    """(metric, value, higher-is-better, noise) of comparable results"""
+    items = []
+    for k, v in res.get('load', {}).get('phases_ms', {}).items():
+        items.append(('load.' + k + '_ms', v, False, 10))
+    for q, r in res.get('latency', {}).items():
+        if 'avg_usec' in r:
+            items.append(('latency.' + q + '.avg_usec', r['avg_usec'], False, 10))
+    thpt = res.get('throughput', {})
+    if 'kqps' in thpt:
+        items.append(('throughput.kqps', thpt['kqps'], True, 0))
+    for q, r in thpt.get('per_type', {}).items():
+        for k in ('p50_usec', 'p99_usec'):
+            if k in r:
+                items.append(('throughput.%s.%s' % (q, k), r[k], False, 10))
+    for c, r in thpt.get('per_class', {}).items():
+        items.append(('throughput.%s.p99_usec' % c, r['p99_usec'], False, 10))
+    for k in ('max_rss_kb', 'gstore_entry_used_bytes'):
+        if k in res.get('memory', {}):
+            items.append(('memory.' + k, res['memory'][k], False, 0))
+    return items
+
+
+def compare(base, cur, threshold):
+    """return the number of regressions (worse than the baseline by > threshold%)"""
+    base_items = dict((k, v) for k, v, _, _ in flatten(base))
+    nregs = 0
+    print('%-44s %14s %14s %9s' % ('metric', 'baseline', 'current', 'change'))
+    for k, v, higher, noise in flatten(cur):
+        if k not in base_items:
+            continue
+        b = base_items[k]
+        change = (v - b) * 100.0 / b if b else 0.0
+        worse = (-change if higher else change) > threshold
+        # ignore the noise of tiny values (e.g., 3 ms vs. 5 ms)
+        if abs(v - b) <= noise:
+            worse = False
+        nregs += worse
+        print('%-44s %14s %14s %+8.1f%% %s' % (k, b, v, change, 'REGRESSION' if worse else ''))
+
+    # the result sizes should never change
+    for q, r in cur.get('latency', {}).items():
+        b = base.get('latency', {}).get(q, {})
+        if 'result_size' in b and b['result_size'] != r.get('result_size'):
+            nregs += 1
+            print('%-44s %14s %14s %9s REGRESSION' % ('latency.' + q + '.result_size',
+                                                     b['result_size'], r.get('result_size'), ''))
+
+    print('%d regression(s) (threshold: %g%%)' % (nregs, threshold))
+    return 1 if nregs else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='the end-to-end benchmark driver of Wukong')
+    sub = parser.add_subparsers(dest='command')
+
+    def add_dataset_args(p):
+        p.add_argument('-u', '--univ', type=int, default=2, help='the scale of LUBM (#universities)')
+        p.add_argument('-d', '--data-dir', default=os.path.join(ROOT, 'datasets'),
+                       help='the directory of datasets (shared by all servers)')
+        p.add_argument('--uba', help='the directory of UBA (default: $UBA_HOME)')
+        p.add_argument('--jena', help='the directory of Apache Jena (default: $JENA_HOME)')
+        p.add_argument('--seed', type=int, default=0, help='the seed of UBA')
+        p.add_argument('--keep-nt', action='store_true', help='keep the dataset in NT format')
+        p.add_argument('--force', action='store_true', help='regenerate the dataset')
+
+    p = sub.add_parser('gen', help='generate a LUBM dataset')
+    add_dataset_args(p)
+
+    p = sub.add_parser('run', help='run the benchmark')
+    add_dataset_args(p)
+    p.add_argument('--gen', action='store_true', help='generate the dataset if missing')
+    p.add_argument('-c', '--config', default=os.path.join(SCRIPTS, 'config'), help='the base config')
+    p.add_argument('--set', action='append', default=[], metavar='KEY=VALUE',
+                   help='override a config item (e.g., --set global_num_engines=8)')
+    p.add_argument('-H', '--hosts', default=os.path.join(SCRIPTS, 'mpd.hosts'), help='the host file')
+    p.add_argument('-b', '--binding', default=os.path.join(SCRIPTS, 'core.bind'), help='the core binding')
+    p.add_argument('-n', '--servers', type=int, default=1, help='the number of servers (MPI)')
+    p.add_argument('-s', '--sim', type=int, default=0, help='simulate servers in a single process')
+    p.add_argument('-r', '--nrepeats', type=int, default=100, help='the repetitions of each query')
+    p.add_argument('--mix', default=EMU_MIX, help='the mix config of the emulator')
+    p.add_argument('--duration', type=int, default=30, help='the duration of the emulator (0: skip)')
+    p.add_argument('--warmup', type=int, default=5, help='the warmup of the emulator')
+    p.add_argument('--pfactor', type=int, default=4, help='the in-flight queries per proxy')
+    p.add_argument('--timeout', type=int, default=3600, help='the timeout of the run (sec)')
+    p.add_argument('-o', '--output', help='the JSON file of results (default: stdout)')
+    p.add_argument('-l', '--log', help='save the console output of wukong')
+    p.add_argument('--baseline', help='compare with a baseline after the run')
+    p.add_argument('-t', '--threshold', type=float, default=10.0, help='the threshold of regressions (%%)')
+
+    p = sub.add_parser('compare', help='compare results with a baseline')
+    p.add_argument('baseline')
+    p.add_argument('current')
+    p.add_argument('-t', '--threshold', type=float, default=10.0, help='the threshold of regressions (%%)')
+
+    args = parser.parse_args()
+    if args.command == 'gen':
+        args.data_dir = os.path.abspath(args.data_dir)
+        gen_dataset(args)
+    elif args.command == 'run':
+        args.data_dir = os.path.abspath(args.data_dir)
+        sys.exit(run_bench(args))
+    elif args.command == 'compare':
+        with open(args.baseline) as f:
+            base = json.load(f)
+        with open(args.current) as f:
+            cur = json.load(f)
+        sys.exit(compare(base, cur, args.threshold))
+    else:
+        parser.print_help()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/utility.hpp>
+
+#include "assertion.hpp"
+
+using namespace std;
+
+/**
+ * A High Dynamic Range (HDR) histogram of non-negative integer values (e.g., latency in usec)
+ *
+ * The values in [0, @highest] are recorded with @sigfigs significant decimal digits,
+ * i.e., a value is counted into a slot no wider than about 2*10^-sigfigs of the value.
+ * A percentile is reported as the top of the slot holding the value at its rank, so it
+ * may differ more from the exact one at a sparse tail (e.g., about 0.3% for p99.99 of
+ * 200K lognormal values at sigfigs = 5), where neighboring ranks are far apart.
+ * The memory usage is fixed regardless of the number of recorded values.
+ * (see also HdrHistogram, http://hdrhistogram.org)
+ *
+ * The buckets are powers of two, and each bucket is split linearly into sub-buckets.
+ * The lower half of sub-buckets of a bucket overlaps with the previous bucket and is skipped.
+ */
+class HDR_Histogram {
+private:
+    int sigfigs = 0;
+    uint64_t highest = 0;
+
+    int sub_bucket_half_count_magnitude;
+    uint64_t sub_bucket_count;
+    uint64_t sub_bucket_half_count;
+    uint64_t sub_bucket_mask;
+    int bucket_count;
+
+    vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t min_value = UINT64_MAX;
+    uint64_t max_value = 0;
+    double sum = 0.0;
+
+    void setup() {
+        // #sub-buckets to keep the precision of the largest value in a bucket
+        uint64_t largest_single_unit = 2;
+        for (int i = 0; i < sigfigs; i++)
+            largest_single_unit *= 10;
+
+        int sub_bucket_count_magnitude = 0;
+        while ((1ull << sub_bucket_count_magnitude) < largest_single_unit)
+            sub_bucket_count_magnitude++;
+        sub_bucket_half_count_magnitude = sub_bucket_count_magnitude - 1;
+        sub_bucket_count = 1ull << sub_bucket_count_magnitude;
+        sub_bucket_half_count = sub_bucket_count / 2;
+        sub_bucket_mask = sub_bucket_count - 1;
+
+        // #buckets to cover the highest value
+        uint64_t smallest_untrackable = sub_bucket_count;
+        bucket_count = 1;
+        while (smallest_untrackable <= highest) {
+            if (smallest_untrackable > (UINT64_MAX >> 1)) {
+                bucket_count++;
+                break;
+            }
+            smallest_untrackable <<= 1;
+            bucket_count++;
+        }
+
+        counts.assign((bucket_count + 1) * sub_bucket_half_count, 0);
+    }
+
+    int get_bucket_index(uint64_t v) const {
+        // the highest bit (or the mask) decides the bucket
+        int pow2ceiling = 64 - __builtin_clzll(v | sub_bucket_mask);
+        return pow2ceiling - (sub_bucket_half_count_magnitude + 1);
+    }
+
+    size_t counts_index(uint64_t v) const {
+        int bucket_index = get_bucket_index(v);
+        uint64_t sub_bucket_index = v >> bucket_index;
+        return ((size_t)(bucket_index + 1) << sub_bucket_half_count_magnitude)
+               + (sub_bucket_index - sub_bucket_half_count);
+    }
+
+    uint64_t value_at_index(size_t index) const {
+        int bucket_index = (index >> sub_bucket_half_count_magnitude) - 1;
+        uint64_t sub_bucket_index = (index & (sub_bucket_half_count - 1)) + sub_bucket_half_count;
+        if (bucket_index < 0) {
+            sub_bucket_index -= sub_bucket_half_count;
+            bucket_index = 0;
+        }
+        return sub_bucket_index << bucket_index;
+    }
+
+    // the largest value which is counted into the same slot with @v
+    uint64_t highest_equivalent_value(uint64_t v) const {
+        int bucket_index = get_bucket_index(v);
+        uint64_t sub_bucket_index = v >> bucket_index;
+        uint64_t lowest = sub_bucket_index << bucket_index;
+        // the sub-buckets of the top half of a bucket are a unit larger
+        int adjusted = (sub_bucket_index >= sub_bucket_count) ? bucket_index + 1 : bucket_index;
+        return lowest + (1ull << adjusted) - 1;
+    }
+
+    friend class boost::serialization::access;
+
+    // only non-zero slots are serialized
+    template <typename Archive>
+    void save(Archive &ar, const unsigned int version) const {
+        ar << sigfigs;
+        ar << highest;
+        ar << total;
+        ar << min_value;
+        ar << max_value;
+        ar << sum;
+        vector<pair<uint64_t, uint64_t>> slots;
+        for (size_t i = 0; i < counts.size(); i++)
+            if (counts[i] > 0)
+                slots.push_back(make_pair((uint64_t)i, counts[i]));
+        ar << slots;
+    }
+
+    template <typename Archive>
+    void load(Archive &ar, const unsigned int version) {
+        ar >> sigfigs;
+        ar >> highest;
+        ar >> total;
+        ar >> min_value;
+        ar >> max_value;
+        ar >> sum;
+        vector<pair<uint64_t, uint64_t>> slots;
+        ar >> slots;
+        if (sigfigs > 0) setup();
+        for (auto &s : slots)
+            counts[s.first] = s.second;
+    }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+public:
+    HDR_Histogram() { }
+
+    // record values in [0, @highest] with @sigfigs (1 to 5) significant digits
+    HDR_Histogram(uint64_t highest, int sigfigs)
+        : sigfigs(sigfigs), highest(highest) {
+        ASSERT(sigfigs >= 1 && sigfigs <= 5);
+        ASSERT(highest >= 2);
+        setup();
+    }
+
+    // the values larger than the highest trackable value are clamped
+    void record(uint64_t v, uint64_t n = 1) {
+        if (v > highest) v = highest;
+        counts[counts_index(v)] += n;
+        total += n;
+        sum += (double)v * n;
+        if (v < min_value) min_value = v;
+        if (v > max_value) max_value = v;
+    }
+
+    /**
+     * Correct the coordinated omission of a closed-loop client, which is expected to
+     * issue a request per @interval. A long request (@v) delays the following requests,
+     * so the requests that should have been issued during the delay are also recorded
+     * with their (linearly decreasing) latencies.
+     */
+    void record_corrected(uint64_t v, uint64_t interval) {
+        record(v);
+        if (interval == 0 || v <= interval) return;
+
+        for (uint64_t missing = v - interval; missing >= interval; missing -= interval)
+            record(missing);
+    }
+
+    // NOTE: the histograms must have the same precision and range
+    void merge(const HDR_Histogram &other) {
+        if (other.total == 0) return;
+        if (sigfigs == 0) { // empty
+            *this = other;
+            return;
+        }
+
+        ASSERT(sigfigs == other.sigfigs && highest == other.highest);
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        if (other.min_value < min_value) min_value = other.min_value;
+        if (other.max_value > max_value) max_value = other.max_value;
+    }
+
+    void reset() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = 0;
+        sum = 0.0;
+        min_value = UINT64_MAX;
+        max_value = 0;
+    }
+
+    uint64_t get_total_count() const { return total; }
+
+    uint64_t get_min() const { return total ? min_value : 0; }
+
+    uint64_t get_max() const { return max_value; }
+
+    double get_mean() const { return total ? sum / total : 0.0; }
+
+    // the value at @percentile (0.0 to 100.0), with the error bounded by the precision
+    uint64_t value_at_percentile(double percentile) const {
+        if (total == 0) return 0;
+        if (percentile >= 100.0) return max_value;
+
+        uint64_t target = (uint64_t)(percentile / 100.0 * total + 0.5);
+        if (target < 1) target = 1;
+
+        uint64_t acc = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            acc += counts[i];
+            if (acc >= target) {
+                uint64_t v = highest_equivalent_value(value_at_index(i));
+                return (v < max_value) ? v : max_value;
+            }
+        }
+        return max_value;
+    }
+
+    // the memory usage of counters (bytes)
+    uint64_t memory_size() const { return counts.size() * sizeof(uint64_t); }
+};
@@ -23,6 +23,7 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <assert.h>
 
 /* NOTE: math will conflict with other lib; so it's named mymath */
@@ -189,4 +190,46 @@ public:
     void static qsort_tuple(int N, std::vector<sid_t>& vec) {
         qsort_tuple_recursive(N, vec, 0, vec.size() / N);
     }
+
+    // sort tuples by std::sort on their indexes, which avoids the worst case of qsort_tuple
+    void static sort_tuple(int N, std::vector<sid_t>& vec) {
+        std::vector<int> idxs(vec.size() / N);
+        for (int i = 0; i < idxs.size(); i++)
+            idxs[i] = i;
+
+        std::sort(idxs.begin(), idxs.end(), [&](int i, int j) {
+            return compare_tuple(N, vec, i, vec, j) < 0;
+        });
+
+        // permute tuples in place by following the cycles of idxs
+        // (idxs[i]: the old position of the tuple at position i)
+        std::vector<sid_t> tmp(N);
+        for (int i = 0; i < idxs.size(); i++) {
+            if (idxs[i] == i) continue;
+
+            std::copy(vec.begin() + i * N, vec.begin() + (i + 1) * N, tmp.begin());
+            int cur = i;
+            while (idxs[cur] != i) {
+                int src = idxs[cur];
+                std::copy(vec.begin() + src * N, vec.begin() + (src + 1) * N, vec.begin() + cur * N);
+                idxs[cur] = cur; // done
+                cur = src;
+            }
+            std::copy(tmp.begin(), tmp.end(), vec.begin() + cur * N);
+            idxs[cur] = cur;
+        }
+    }
+
+    // remove consecutive duplicate tuples (i.e., use sort_tuple first)
+    void static unique_tuple(int N, std::vector<sid_t>& vec) {
+        int n = vec.size() / N, k = 0;
+        for (int i = 0; i < n; i++) {
+            if (k > 0 && compare_tuple(N, vec, i, vec, k - 1) == 0)
+                continue;
+            if (i != k)
+                std::copy(vec.begin() + i * N, vec.begin() + (i + 1) * N, vec.begin() + k * N);
+            k++;
+        }
+        vec.resize(k * N);
+    }
 };
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define WK_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Set kernels on ID lists (e.g., the neighbors or the predicates of a vertex)
+ *
+ * contains(): membership test of a value in an (unsorted) list
+ * intersect(): intersection of two strictly increasing lists
+ *
+ * The SSE4/AVX2 kernels are compiled with target attributes, so the binary
+ * can be built w/o -mavx2 and still runs on old CPUs. The best kernel
+ * supported by the running CPU is chosen once at runtime.
+ */
+class simd_set {
+public:
+    enum level_t { SCALAR = 0, SSE4 = 1, AVX2 = 2 };
+
+    // use galloping search if the long list is at least GALLOP_RATIO times longer
+    static const uint64_t GALLOP_RATIO = 32;
+
+    // use scalar membership test if the list is shorter than SHORT_LIST
+    static const uint64_t SHORT_LIST = 8;
+
+    static level_t detect_level() {
+#ifdef WK_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return AVX2;
+        if (__builtin_cpu_supports("sse4.1")) return SSE4;
+#endif
+        return SCALAR;
+    }
+
+    // the level used by contains() and intersect()
+    static level_t &level() {
+        static level_t l = detect_level();
+        return l;
+    }
+
+    static const char *level_str(level_t l) {
+        switch (l) {
+        case AVX2: return "AVX2";
+        case SSE4: return "SSE4";
+        default:   return "scalar";
+        }
+    }
+
+    /* Check whether @key is in the list @a (size @n) */
+    template <typename T>
+    static bool contains(const T *a, uint64_t n, T key) {
+        return contains(level(), a, n, key);
+    }
+
+    template <typename T>
+    static bool contains(level_t l, const T *a, uint64_t n, T key) {
+        if (n < SHORT_LIST) return contains_scalar(a, n, key);
+
+#ifdef WK_SIMD_X86
+        if (l == AVX2) return contains_avx2(a, n, key);
+        if (l == SSE4) return contains_sse4(a, n, key);
+#endif
+        return contains_scalar(a, n, key);
+    }
+
+    /* Intersect two strictly increasing lists @a and @b into @out.
+     * @out should have room for min(@na, @nb) elements, and it may alias @a.
+     * Return the size of the intersection.
+     */
+    template <typename T>
+    static uint64_t intersect(const T *a, uint64_t na, const T *b, uint64_t nb, T *out) {
+        return intersect(level(), a, na, b, nb, out);
+    }
+
+    template <typename T>
+    static uint64_t intersect(level_t l, const T *a, uint64_t na,
+                              const T *b, uint64_t nb, T *out) {
+        // always let @a be the shorter one
+        if (na > nb) { std::swap(a, b); std::swap(na, nb); }
+        if (na == 0) return 0;
+
+        // skewed sizes: search each element of the short list in the long list
+        if (nb / na >= GALLOP_RATIO)
+            return intersect_gallop(a, na, b, nb, out);
+
+#ifdef WK_SIMD_X86
+        if (l == AVX2) return intersect_avx2(a, na, b, nb, out);
+        if (l == SSE4) return intersect_sse4(a, na, b, nb, out);
+#endif
+        return intersect_scalar(a, na, b, nb, out);
+    }
+
+    /* Sort the list (in place) and remove the duplicates.
+     * Return the new size of the list.
+     */
+    template <typename T>
+    static uint64_t make_set(T *a, uint64_t n) {
+        if (!std::is_sorted(a, a + n))
+            std::sort(a, a + n);
+        return std::unique(a, a + n) - a;
+    }
+
+    /// scalar kernels
+
+    template <typename T>
+    static bool contains_scalar(const T *a, uint64_t n, T key) {
+        for (uint64_t i = 0; i < n; i++)
+            if (a[i] == key) return true;
+        return false;
+    }
+
+    template <typename T>
+    static uint64_t intersect_scalar(const T *a, uint64_t na,
+                                     const T *b, uint64_t nb, T *out,
+                                     uint64_t i = 0, uint64_t j = 0, uint64_t k = 0) {
+        while (i < na && j < nb) {
+            if (a[i] < b[j]) {
+                i++;
+            } else if (b[j] < a[i]) {
+                j++;
+            } else {
+                out[k++] = a[i];
+                i++; j++;
+            }
+        }
+        return k;
+    }
+
+    template <typename T>
+    static uint64_t intersect_gallop(const T *a, uint64_t na,
+                                     const T *b, uint64_t nb, T *out) {
+        uint64_t k = 0, lo = 0;
+        for (uint64_t i = 0; i < na && lo < nb; i++) {
+            // exponential search for the upper bound, then binary search
+            uint64_t step = 1, hi = lo;
+            while (hi < nb && b[hi] < a[i]) {
+                lo = hi + 1;
+                hi += step;
+                step <<= 1;
+            }
+            if (hi > nb) hi = nb;
+            lo = std::lower_bound(b + lo, b + hi, a[i]) - b;
+            if (lo < nb && b[lo] == a[i])
+                out[k++] = a[i];
+        }
+        return k;
+    }
+
+#ifdef WK_SIMD_X86
+    /// SIMD kernels
+    ///
+    /// NOTE: IDs are unsigned, but only the equality comparison is vectorized,
+    ///       so the signed compare instructions are safe.
+
+    __attribute__((target("sse4.1")))
+    static bool contains_sse4(const uint32_t *a, uint64_t n, uint32_t key) {
+        __m128i k = _mm_set1_epi32(key);
+        uint64_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m128i m = _mm_or_si128(
+                            _mm_cmpeq_epi32(k, _mm_loadu_si128((const __m128i *)(a + i))),
+                            _mm_cmpeq_epi32(k, _mm_loadu_si128((const __m128i *)(a + i + 4))));
+            if (!_mm_testz_si128(m, m)) return true;
+        }
+        return contains_scalar(a + i, n - i, key);
+    }
+
+    __attribute__((target("sse4.1")))
+    static bool contains_sse4(const uint64_t *a, uint64_t n, uint64_t key) {
+        __m128i k = _mm_set1_epi64x(key);
+        uint64_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128i m = _mm_or_si128(
+                            _mm_cmpeq_epi64(k, _mm_loadu_si128((const __m128i *)(a + i))),
+                            _mm_cmpeq_epi64(k, _mm_loadu_si128((const __m128i *)(a + i + 2))));
+            if (!_mm_testz_si128(m, m)) return true;
+        }
+        return contains_scalar(a + i, n - i, key);
+    }
+
+    __attribute__((target("avx2")))
+    static bool contains_avx2(const uint32_t *a, uint64_t n, uint32_t key) {
+        __m256i k = _mm256_set1_epi32(key);
+        uint64_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m256i m = _mm256_or_si256(
+                            _mm256_cmpeq_epi32(k, _mm256_loadu_si256((const __m256i *)(a + i))),
+                            _mm256_cmpeq_epi32(k, _mm256_loadu_si256((const __m256i *)(a + i + 8))));
+            if (!_mm256_testz_si256(m, m)) return true;
+        }
+        return contains_scalar(a + i, n - i, key);
+    }
+
+    __attribute__((target("avx2")))
+    static bool contains_avx2(const uint64_t *a, uint64_t n, uint64_t key) {
+        __m256i k = _mm256_set1_epi64x(key);
+        uint64_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i m = _mm256_or_si256(
+                            _mm256_cmpeq_epi64(k, _mm256_loadu_si256((const __m256i *)(a + i))),
+                            _mm256_cmpeq_epi64(k, _mm256_loadu_si256((const __m256i *)(a + i + 4))));
+            if (!_mm256_testz_si256(m, m)) return true;
+        }
+        return contains_scalar(a + i, n - i, key);
+    }
+
+    /* Block-wise merge: compare a block of @a with all rotations of a block of @b,
+     * emit the matched elements of @a, then advance the block(s) with the smaller tail.
+     */
+#define WK_SIMD_EMIT(mask, W)                          \
+    for (int lane = 0; lane < (W); lane++)             \
+        if ((mask) & (1 << lane)) out[k++] = a[i + lane];
+
+#define WK_SIMD_ADVANCE(W)                             \
+    do {                                               \
+        auto amax = a[i + (W) - 1], bmax = b[j + (W) - 1]; \
+        if (amax <= bmax) i += (W);                    \
+        if (bmax <= amax) j += (W);                    \
+    } while (0)
+
+    __attribute__((target("sse4.1")))
+    static uint64_t intersect_sse4(const uint32_t *a, uint64_t na,
+                                   const uint32_t *b, uint64_t nb, uint32_t *out) {
+        uint64_t i = 0, j = 0, k = 0;
+        while (i + 4 <= na && j + 4 <= nb) {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+            __m128i m = _mm_cmpeq_epi32(va, vb);
+            vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+            m = _mm_or_si128(m, _mm_cmpeq_epi32(va, vb));
+            vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+            m = _mm_or_si128(m, _mm_cmpeq_epi32(va, vb));
+            vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+            m = _mm_or_si128(m, _mm_cmpeq_epi32(va, vb));
+
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+            WK_SIMD_EMIT(mask, 4);
+            WK_SIMD_ADVANCE(4);
+        }
+        return intersect_scalar(a, na, b, nb, out, i, j, k);
+    }
+
+    __attribute__((target("sse4.1")))
+    static uint64_t intersect_sse4(const uint64_t *a, uint64_t na,
+                                   const uint64_t *b, uint64_t nb, uint64_t *out) {
+        uint64_t i = 0, j = 0, k = 0;
+        while (i + 2 <= na && j + 2 <= nb) {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+            __m128i m = _mm_cmpeq_epi64(va, vb);
+            vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2));
+            m = _mm_or_si128(m, _mm_cmpeq_epi64(va, vb));
+
+            int mask = _mm_movemask_pd(_mm_castsi128_pd(m));
+            WK_SIMD_EMIT(mask, 2);
+            WK_SIMD_ADVANCE(2);
+        }
+        return intersect_scalar(a, na, b, nb, out, i, j, k);
+    }
+
+    __attribute__((target("avx2")))
+    static uint64_t intersect_avx2(const uint32_t *a, uint64_t na,
+                                   const uint32_t *b, uint64_t nb, uint32_t *out) {
+        const __m256i rot = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+        uint64_t i = 0, j = 0, k = 0;
+        while (i + 8 <= na && j + 8 <= nb) {
+            __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+            __m256i vb = _mm256_loadu_si256((const __m256i *)(b + j));
+            __m256i m = _mm256_cmpeq_epi32(va, vb);
+            for (int r = 1; r < 8; r++) {
+                vb = _mm256_permutevar8x32_epi32(vb, rot);
+                m = _mm256_or_si256(m, _mm256_cmpeq_epi32(va, vb));
+            }
+
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+            WK_SIMD_EMIT(mask, 8);
+            WK_SIMD_ADVANCE(8);
+        }
+        return intersect_scalar(a, na, b, nb, out, i, j, k);
+    }
+
+    __attribute__((target("avx2")))
+    static uint64_t intersect_avx2(const uint64_t *a, uint64_t na,
+                                   const uint64_t *b, uint64_t nb, uint64_t *out) {
+        uint64_t i = 0, j = 0, k = 0;
+        while (i + 4 <= na && j + 4 <= nb) {
+            __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+            __m256i vb = _mm256_loadu_si256((const __m256i *)(b + j));
+            __m256i m = _mm256_cmpeq_epi64(va, vb);
+            for (int r = 1; r < 4; r++) {
+                vb = _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1));
+                m = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, vb));
+            }
+
+            int mask = _mm256_movemask_pd(_mm256_castsi256_pd(m));
+            WK_SIMD_EMIT(mask, 4);
+            WK_SIMD_ADVANCE(4);
+        }
+        return intersect_scalar(a, na, b, nb, out, i, j, k);
+    }
+
+#undef WK_SIMD_EMIT
+#undef WK_SIMD_ADVANCE
+#endif // WK_SIMD_X86
+};
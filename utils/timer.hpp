@@ -26,6 +26,8 @@
 #include <unistd.h>
 #include <stdint.h>
 
+#include "logger2.hpp"
+
 class timer {
 public:
     static uint64_t get_usec() {
@@ -38,6 +40,21 @@ public:
         return ((tp.tv_sec * 1000 * 1000) + (tp.tv_nsec / 1000));
     }
 
+    /* read the time-stamp counter (TSC), which is much cheaper than clock_gettime()
+       NOTE: the counter is not serialized and only meaningful within a machine
+       (assume an invariant and synchronized TSC across cores) */
+    static inline uint64_t get_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+        uint32_t lo, hi;
+        __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+        return ((uint64_t)hi << 32) | lo;
+#else
+        struct timespec tp;
+        clock_gettime(CLOCK_MONOTONIC, &tp);
+        return ((tp.tv_sec * 1000 * 1000 * 1000) + tp.tv_nsec);
+#endif
+    }
+
     /* use select to delay the thread
        beacause sleep or usleep is no accurate */
     static void cpu_relax(const long usec, const long sec = 0) {